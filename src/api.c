@@ -18,6 +18,16 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <limits.h>
+#include <errno.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
 
 #include "api.h"
 
@@ -31,20 +41,40 @@
 #include "utils.h"
 #include "types.h"
 
-static int add_network_list(const struct network_config_list *list, const struct runtime_conf *rc,
-                            const char * const *paths, size_t paths_len, struct result **pret, char **err);
-
-static int del_network_list(const struct network_config_list *list, const struct runtime_conf *rc,
-                            const char * const *paths, size_t paths_len, char **err);
-
-static int add_network(const struct network_config *net, const struct runtime_conf *rc, const char * const *paths,
-                       size_t paths_len, struct result **add_result, char **err);
-
-static int del_network(const struct network_config *net, const struct runtime_conf *rc, const char * const *paths,
-                       size_t paths_len, char **err);
+struct plugin_conf_template {
+    /* generated config with name and cniVersion of list, without injected runtimeConfig and prevResult */
+    char *plain;
+    /* generated with empty runtimeConfig, which is rt_len bytes at rt_pos */
+    char *with_rt;
+    size_t rt_pos;
+    size_t rt_len;
+};
+
+struct cni_network_list_handle {
+    struct network_config_list *list;
+    char **paths;
+    size_t paths_len;
+    /* plugins resolved in paths by index of list, NULL entry is searched when it runs */
+    char **plugin_paths;
+    /* pre-generated configs by index of list, entry without plain is built by generator */
+    struct plugin_conf_template *templates;
+};
+
+static int add_network_list(struct cni_network_list_handle *handle, const struct runtime_conf *rc,
+                            const struct cni_exec_opts *opts, struct result **pret, char **err);
+
+static int del_network_list(struct cni_network_list_handle *handle, const struct runtime_conf *rc,
+                            const struct cni_exec_opts *opts, char **err);
+
+static int add_network(const struct network_config *net, const struct runtime_conf *rc,
+                       const struct cni_exec_opts *opts, const char * const *paths, size_t paths_len,
+                       struct result **add_result, char **err);
+
+static int del_network(const struct network_config *net, const struct runtime_conf *rc,
+                       const struct cni_exec_opts *opts, const char * const *paths, size_t paths_len, char **err);
 
 static int args(const char *action, const struct runtime_conf *rc, const char * const *paths, size_t paths_len,
-                struct cni_args **cargs, char **err);
+                struct clibcni_util_arena *arena, struct cni_args **cargs, char **err);
 
 static int copy_cni_port_mapping(cni_inner_port_mapping *dst, const struct cni_port_mapping *src)
 {
@@ -106,7 +136,7 @@ static int inject_cni_port_mapping(const struct runtime_conf *rt, cni_net_conf_r
     return 0;
 }
 
-static int inject_runtime_config_items(const struct network_config *orig, const struct runtime_conf *rt,
+static int inject_runtime_config_items(const cni_net_conf *network, const struct runtime_conf *rt,
                                        cni_net_conf_runtime_config **rt_config, bool *inserted, char **err)
 {
     char *work = NULL;
@@ -114,7 +144,7 @@ static int inject_runtime_config_items(const struct network_config *orig, const
     int ret = -1;
     size_t i = 0;
 
-    if (orig->network->capabilities == NULL) {
+    if (network->capabilities == NULL) {
         return 0;
     }
 
@@ -124,9 +154,9 @@ static int inject_runtime_config_items(const struct network_config *orig, const
         ERROR("Out of memory");
         goto free_out;
     }
-    for (i = 0; i < orig->network->capabilities->len; i++) {
-        work = orig->network->capabilities->keys[i];
-        value = orig->network->capabilities->values[i];
+    for (i = 0; i < network->capabilities->len; i++) {
+        work = network->capabilities->keys[i];
+        value = network->capabilities->values[i];
         if (!value || work == NULL) {
             continue;
         }
@@ -144,14 +174,14 @@ free_out:
     return ret;
 }
 
-static int do_generate_cni_net_conf_json(const struct network_config *orig, char **result, char **err)
+static int do_generate_cni_net_conf_json(const cni_net_conf *network, char **result, char **err)
 {
     struct parser_context ctx = { OPT_PARSE_FULLKEY | OPT_GEN_SIMPLIFY, 0 };
     parser_error jerr = NULL;
     int ret = 0;
 
     /* generate new json str for injected config */
-    *result = cni_net_conf_generate_json(orig->network, &ctx, &jerr);
+    *result = cni_net_conf_generate_json(network, &ctx, &jerr);
     if (*result == NULL) {
         if (asprintf(err, "generate json failed: %s", jerr) < 0) {
             *err = clibcni_util_strdup_s("Out of memory");
@@ -179,7 +209,7 @@ static int inject_runtime_config(const struct network_config *orig, const struct
     bool insert_rt_config = false;
     int ret = -1;
     cni_net_conf_runtime_config *rt_config = NULL;
-    cni_net_conf_runtime_config *save_conf = NULL;
+    cni_net_conf work = { 0 };
 
     if (check_inject_runtime_config_args(orig, rt, result, err)) {
         ERROR("Invalid arguments");
@@ -191,25 +221,20 @@ static int inject_runtime_config(const struct network_config *orig, const struct
         return -1;
     }
 
-    save_conf = orig->network->runtime_config;
-
-    ret = inject_runtime_config_items(orig, rt, &rt_config, &insert_rt_config, err);
+    ret = inject_runtime_config_items(orig->network, rt, &rt_config, &insert_rt_config, err);
     if (ret != 0) {
         ERROR("inject runtime config failed: %s", *err != NULL ? *err : "");
         goto free_out;
     }
 
-    if (!insert_rt_config) {
-        goto generate_result;
+    /* parsed config may be shared by other threads, generate from a shallow copy */
+    work = *orig->network;
+    if (insert_rt_config) {
+        work.runtime_config = rt_config;
     }
-
-    orig->network->runtime_config = rt_config;
-
-generate_result:
-    ret = do_generate_cni_net_conf_json(orig, result, err);
+    ret = do_generate_cni_net_conf_json(&work, result, err);
 
 free_out:
-    orig->network->runtime_config = save_conf;
     free_cni_net_conf_runtime_config(rt_config);
     if (ret != 0) {
         free(*result);
@@ -218,50 +243,315 @@ free_out:
     return ret;
 }
 
-static int do_inject_prev_result(const struct result *prev_result, cni_net_conf *work, char **err)
+#define PREV_RESULT_KEY "\"prevResult\":"
+
+static bool size_add_overflow(size_t *total, size_t len)
 {
-    if (prev_result == NULL) {
-        return 0;
+    if (len > SIZE_MAX - *total) {
+        return true;
+    }
+    *total += len;
+    return false;
+}
+
+/*
+ * assemble config into one buffer from arena: tmpl with bytes [slot_pos, slot_pos + slot_len) replaced by member,
+ * and raw json of previous result added as last member of the object if it is not NULL
+ * */
+static int assemble_plugin_conf(const char *tmpl, size_t slot_pos, size_t slot_len, const char *member,
+                                const char *prev_result, struct clibcni_util_arena *arena, char **conf, char **err)
+{
+    const char *end = NULL;
+    const char *pos = NULL;
+    char *buf = NULL;
+    size_t tmpl_len = strlen(tmpl);
+    size_t member_len = member != NULL ? strlen(member) : 0;
+    size_t end_pos = tmpl_len;
+    size_t prev_len = 0;
+    size_t total = 1;
+    size_t off = 0;
+    bool empty_object = false;
+
+    if (prev_result != NULL) {
+        end = strrchr(tmpl, '}');
+        if (end == NULL || (size_t)(end - tmpl) < slot_pos + slot_len) {
+            *err = clibcni_util_strdup_s("Invalid network config json");
+            ERROR("Invalid network config json: %s", tmpl);
+            return -1;
+        }
+        end_pos = (size_t)(end - tmpl);
+        for (pos = end; pos > tmpl && isspace((unsigned char)pos[-1]); pos--) {
+        }
+        empty_object = (pos > tmpl && pos[-1] == '{' && member_len == 0);
+        prev_len = strlen(prev_result);
     }
 
-    free_cni_result_curr(work->prev_result);
-    work->prev_result = cni_result_curr_to_json_result(prev_result, err);
-    if (work->prev_result == NULL) {
+    if (size_add_overflow(&total, tmpl_len - slot_len) || size_add_overflow(&total, member_len) ||
+        (prev_result != NULL && (size_add_overflow(&total, sizeof(PREV_RESULT_KEY)) ||
+                                 size_add_overflow(&total, prev_len)))) {
+        *err = clibcni_util_strdup_s("Network config too large");
+        ERROR("Network config too large");
+        return -1;
+    }
+    buf = clibcni_util_arena_alloc(arena, total);
+    if (buf == NULL) {
+        *err = clibcni_util_strdup_s("Out of memory");
+        ERROR("Out of memory");
         return -1;
     }
+
+    (void)memcpy(buf, tmpl, slot_pos);
+    off = slot_pos;
+    if (member_len > 0) {
+        (void)memcpy(buf + off, member, member_len);
+        off += member_len;
+    }
+    (void)memcpy(buf + off, tmpl + slot_pos + slot_len, end_pos - slot_pos - slot_len);
+    off += end_pos - slot_pos - slot_len;
+    if (prev_result != NULL) {
+        if (!empty_object) {
+            buf[off++] = ',';
+        }
+        (void)memcpy(buf + off, PREV_RESULT_KEY, sizeof(PREV_RESULT_KEY) - 1);
+        off += sizeof(PREV_RESULT_KEY) - 1;
+        (void)memcpy(buf + off, prev_result, prev_len);
+        off += prev_len;
+    }
+    (void)memcpy(buf + off, tmpl + end_pos, tmpl_len - end_pos + 1);
+
+    *conf = buf;
     return 0;
 }
 
+/*
+ * move generated config into arena, with raw json of previous result as last member of the object
+ * if it is not NULL; generated config is freed in any case
+ * */
+static int move_conf_to_arena(const char *prev_result, struct clibcni_util_arena *arena, char **conf, char **err)
+{
+    char *moved = NULL;
+    int ret = 0;
+
+    if (prev_result != NULL) {
+        ret = assemble_plugin_conf(*conf, 0, 0, NULL, prev_result, arena, &moved, err);
+    } else {
+        moved = clibcni_util_arena_strdup(arena, *conf);
+        if (moved == NULL) {
+            *err = clibcni_util_strdup_s("Out of memory");
+            ERROR("Out of memory");
+            ret = -1;
+        }
+    }
+    free(*conf);
+    *conf = moved;
+    return ret;
+}
+
+#define RUNTIME_CONFIG_KEY "\"runtimeConfig\":"
+#define EMPTY_RUNTIME_CONFIG RUNTIME_CONFIG_KEY "{}"
+
+static char *generate_net_conf_json(const cni_net_conf *network)
+{
+    struct parser_context ctx = { OPT_PARSE_FULLKEY | OPT_GEN_SIMPLIFY, 0 };
+    parser_error jerr = NULL;
+    char *json = NULL;
+
+    json = cni_net_conf_generate_json(network, &ctx, &jerr);
+    if (json == NULL) {
+        ERROR("Generate json: %s", jerr);
+    }
+    free(jerr);
+    return json;
+}
+
+static bool has_port_mappings_capability(const cni_net_conf *network)
+{
+    size_t i = 0;
+
+    if (network->capabilities == NULL) {
+        return false;
+    }
+    for (i = 0; i < network->capabilities->len; i++) {
+        if (network->capabilities->values[i] && network->capabilities->keys[i] != NULL &&
+            strcmp(network->capabilities->keys[i], "portMappings") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* empty runtimeConfig is inserted where plain and with_rt start to differ */
+static bool locate_runtime_config_slot(const char *plain, struct plugin_conf_template *tmpl)
+{
+    size_t same = 0;
+    size_t start = 0;
+    const char *found = NULL;
+    const size_t slot_len = strlen(EMPTY_RUNTIME_CONFIG);
+
+    while (plain[same] != '\0' && plain[same] == tmpl->with_rt[same]) {
+        same++;
+    }
+    start = same > slot_len ? same - slot_len : 0;
+    found = strstr(tmpl->with_rt + start, EMPTY_RUNTIME_CONFIG);
+    /* slot and its comma are the only difference, comma is before slot if it is the last member */
+    if (found == NULL || (size_t)(found - tmpl->with_rt) > same + 1 ||
+        strlen(tmpl->with_rt) != strlen(plain) + slot_len + 1) {
+        return false;
+    }
+    tmpl->rt_pos = (size_t)(found - tmpl->with_rt);
+    tmpl->rt_len = slot_len;
+    return true;
+}
+
+/* templates are built once per handle, plugins with their own prevResult use the generator */
+static void build_plugin_conf_template(const struct network_config_list *list, const cni_net_conf *network,
+                                       struct plugin_conf_template *tmpl)
+{
+    cni_net_conf_runtime_config empty_rt = { 0 };
+    cni_net_conf work = { 0 };
+
+    if (network == NULL || network->prev_result != NULL) {
+        return;
+    }
+    /* same copy as build_one_config makes for every run */
+    work = *network;
+    work.name = list->list->name;
+    work.cni_version = list->list->cni_version;
+
+    tmpl->plain = generate_net_conf_json(&work);
+    if (tmpl->plain == NULL || !has_port_mappings_capability(network)) {
+        return;
+    }
+
+    work.runtime_config = &empty_rt;
+    tmpl->with_rt = generate_net_conf_json(&work);
+    if (tmpl->with_rt != NULL && !locate_runtime_config_slot(tmpl->plain, tmpl)) {
+        DEBUG("No runtime config slot found in config of %s", network->type);
+        free(tmpl->with_rt);
+        tmpl->with_rt = NULL;
+    }
+}
+
+static void free_plugin_conf_templates(struct plugin_conf_template *templates, size_t len)
+{
+    size_t i = 0;
+
+    if (templates == NULL) {
+        return;
+    }
+    for (i = 0; i < len; i++) {
+        free(templates[i].plain);
+        free(templates[i].with_rt);
+    }
+    free(templates);
+}
+
+static struct plugin_conf_template *build_plugin_conf_templates(const struct network_config_list *list)
+{
+    struct plugin_conf_template *templates = NULL;
+    size_t i = 0;
+
+    templates = clibcni_util_smart_calloc_s(list->list->plugins_len + 1, sizeof(struct plugin_conf_template));
+    if (templates == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < list->list->plugins_len; i++) {
+        build_plugin_conf_template(list, list->list->plugins[i], &templates[i]);
+    }
+    return templates;
+}
+
+/*
+ * build config of one run from template, same bytes as build_one_config,
+ * return 1 if the template can not be used for this run
+ * */
+static int build_config_from_template(const struct plugin_conf_template *tmpl, const struct network_config *orig,
+                                      const char *prev_result, const struct runtime_conf *rt,
+                                      struct clibcni_util_arena *arena, char **result, char **err)
+{
+    int ret = -1;
+    bool inserted = false;
+    cni_net_conf_runtime_config *rt_config = NULL;
+    cni_net_conf rt_only = { 0 };
+    char *member = NULL;
+    size_t member_len = 0;
+
+    if (inject_runtime_config_items(orig->network, rt, &rt_config, &inserted, err) != 0) {
+        ERROR("inject runtime config failed: %s", *err != NULL ? *err : "");
+        goto out;
+    }
+    if (!inserted) {
+        ret = assemble_plugin_conf(tmpl->plain, 0, 0, NULL, prev_result, arena, result, err);
+        goto out;
+    }
+    if (tmpl->with_rt == NULL) {
+        ret = 1;
+        goto out;
+    }
+
+    /* runtimeConfig is generated alone, as the only member of an object */
+    rt_only.runtime_config = rt_config;
+    member = generate_net_conf_json(&rt_only);
+    if (member == NULL) {
+        *err = clibcni_util_strdup_s("Generate runtime config json failed");
+        goto out;
+    }
+    member_len = strlen(member);
+    if (strncmp(member, "{" RUNTIME_CONFIG_KEY, strlen("{" RUNTIME_CONFIG_KEY)) != 0 || member[member_len - 1] != '}') {
+        ret = 1;
+        goto out;
+    }
+    member[member_len - 1] = '\0';
+    ret = assemble_plugin_conf(tmpl->with_rt, tmpl->rt_pos, tmpl->rt_len, member + 1, prev_result, arena, result,
+                               err);
+
+out:
+    free(member);
+    free_cni_net_conf_runtime_config(rt_config);
+    return ret;
+}
+
 static inline bool check_build_one_config(const struct network_config_list *list, const struct network_config *orig,
                                           const struct runtime_conf *rt, char * const *result, char * const *err)
 {
     return (list == NULL || orig == NULL || rt == NULL || result == NULL || err == NULL);
 }
 
-static int build_one_config(const struct network_config_list *list, struct network_config *orig,
-                            const struct result *prev_result, const struct runtime_conf *rt, char **result, char **err)
+/*
+ * prev_result is raw json of the result of previous plugin in the chain,
+ * orig is not modified, so a parsed list can be used by many threads at once;
+ * result is allocated from arena
+ * */
+static int build_one_config(const struct network_config_list *list, const struct network_config *orig,
+                            const char *prev_result, const struct runtime_conf *rt,
+                            struct clibcni_util_arena *arena, char **result, char **err)
 {
     int ret = -1;
-    cni_net_conf *work = NULL;
+    cni_net_conf work = { 0 };
+    struct network_config view = { 0 };
 
-    if (check_build_one_config(list, orig, rt, result, err)) {
+    if (check_build_one_config(list, orig, rt, result, err) || orig->network == NULL) {
         ERROR("Invalid arguments");
         return ret;
     }
 
-    work = orig->network;
-    free(work->name);
-    work->name = clibcni_util_strdup_s(list->list->name);
-    free(work->cni_version);
-    work->cni_version = clibcni_util_strdup_s(list->list->cni_version);
+    /* shallow copy, only members replaced here point elsewhere */
+    work = *orig->network;
+    work.name = list->list->name;
+    work.cni_version = list->list->cni_version;
+    /* prevResult of this chain replaces the one in config, it is spliced in after generating */
+    if (prev_result != NULL) {
+        work.prev_result = NULL;
+    }
+    view.network = &work;
 
-    if (do_inject_prev_result(prev_result, work, err) != 0) {
-        ERROR("Inject pre result failed: %s", *err != NULL ? *err : "");
+    if (inject_runtime_config(&view, rt, result, err) != 0) {
+        ERROR("Inject runtime config failed: %s", *err != NULL ? *err : "");
         goto free_out;
     }
 
-    if (inject_runtime_config(orig, rt, result, err) != 0) {
-        ERROR("Inject runtime config failed: %s", *err != NULL ? *err : "");
+    if (move_conf_to_arena(prev_result, arena, result, err) != 0) {
+        ERROR("Inject pre result failed: %s", *err != NULL ? *err : "");
         goto free_out;
     }
 
@@ -273,52 +563,164 @@ free_out:
     return ret;
 }
 
-static int do_check_generate_cni_net_conf_json(char **full_conf_bytes, struct network_config *pnet, char **err)
+/* member of opts is only read when size of caller's struct covers it */
+#define EXEC_OPTS_HAS(opts, member) \
+    ((opts) != NULL && (opts)->size >= offsetof(struct cni_exec_opts, member) + sizeof((opts)->member))
+
+static int64_t get_deadline(const struct cni_exec_opts *opts)
+{
+    if (!EXEC_OPTS_HAS(opts, timeout_ms) || opts->timeout_ms <= 0) {
+        return 0;
+    }
+    return clibcni_util_monotonic_ms() + opts->timeout_ms;
+}
+
+/* plugin not found is left NULL, and reported when the chain reaches it */
+static char **resolve_plugin_paths(const struct network_config_list *list, const char * const *paths,
+                                   size_t paths_len)
 {
-    struct parser_context ctx = { OPT_PARSE_FULLKEY | OPT_GEN_SIMPLIFY, 0 };
-    parser_error serr = NULL;
-    int ret = 0;
+    char **plugin_paths = NULL;
+    size_t i = 0;
+    int save_errno = 0;
 
-    if (*full_conf_bytes != NULL) {
-        pnet->bytes = *full_conf_bytes;
-        *full_conf_bytes = NULL;
-    } else {
-        pnet->bytes = cni_net_conf_generate_json(pnet->network, &ctx, &serr);
-        if (pnet->bytes == NULL) {
-            if (asprintf(err, "Generate json failed: %s", serr) < 0) {
-                *err = clibcni_util_strdup_s("Out of memory");
-            }
-            ERROR("Generate json: %s", serr);
-            ret = -1;
-            goto out;
+    plugin_paths = clibcni_util_smart_calloc_s(list->list->plugins_len + 1, sizeof(char *));
+    if (plugin_paths == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < list->list->plugins_len; i++) {
+        if (list->list->plugins[i] == NULL) {
+            continue;
+        }
+        if (find_in_path(list->list->plugins[i]->type, paths, paths_len, &plugin_paths[i], &save_errno) != 0) {
+            DEBUG("find plugin: \"%s\" failed: %s", list->list->plugins[i]->type, get_invoke_err_msg(save_errno));
         }
     }
+    return plugin_paths;
+}
 
-out:
-    free(serr);
-    return ret;
+static void free_plugin_paths(char **plugin_paths, size_t len)
+{
+    size_t i = 0;
+
+    if (plugin_paths == NULL) {
+        return;
+    }
+    for (i = 0; i < len; i++) {
+        free(plugin_paths[i]);
+    }
+    free(plugin_paths);
+}
+
+/* handle borrows paths and does not resolve plugins, used by calls parsing the list themselves */
+static void init_network_list_handle(struct cni_network_list_handle *handle, struct network_config_list *list,
+                                     char **paths)
+{
+    handle->list = list;
+    handle->paths = paths;
+    handle->paths_len = clibcni_util_array_len((const char * const *)paths);
+    handle->plugin_paths = NULL;
+    handle->templates = NULL;
+}
+
+static void fini_network_list_handle(struct cni_network_list_handle *handle)
+{
+    free_network_config_list(handle->list);
+    handle->list = NULL;
+}
+
+/* take over list, copy paths and resolve all plugins of list */
+static int new_network_list_handle(struct network_config_list *list, char **paths,
+                                   struct cni_network_list_handle **handle, char **err)
+{
+    struct cni_network_list_handle *tmp = NULL;
+    size_t paths_len = 0;
+    size_t i = 0;
+
+    tmp = clibcni_util_common_calloc_s(sizeof(struct cni_network_list_handle));
+    if (tmp == NULL) {
+        goto err_out;
+    }
+    paths_len = clibcni_util_array_len((const char * const *)paths);
+    tmp->paths = clibcni_util_smart_calloc_s(paths_len + 1, sizeof(char *));
+    if (tmp->paths == NULL) {
+        goto err_out;
+    }
+    for (i = 0; i < paths_len; i++) {
+        tmp->paths[i] = clibcni_util_strdup_s(paths[i]);
+    }
+    tmp->paths_len = paths_len;
+    tmp->plugin_paths = resolve_plugin_paths(list, (const char * const *)tmp->paths, tmp->paths_len);
+    if (tmp->plugin_paths == NULL) {
+        goto err_out;
+    }
+    /* without templates every run generates configs, still works */
+    tmp->templates = build_plugin_conf_templates(list);
+    tmp->list = list;
+    *handle = tmp;
+    return 0;
+
+err_out:
+    *err = clibcni_util_strdup_s("Out of memory");
+    ERROR("Out of memory");
+    if (tmp != NULL) {
+        clibcni_util_free_array(tmp->paths);
+        free(tmp);
+    }
+    free_network_config_list(list);
+    return -1;
+}
+
+void cni_network_list_handle_free(struct cni_network_list_handle *handle)
+{
+    if (handle == NULL) {
+        return;
+    }
+    free_plugin_paths(handle->plugin_paths, handle->list->list->plugins_len);
+    free_plugin_conf_templates(handle->templates, handle->list->list->plugins_len);
+    clibcni_util_free_array(handle->paths);
+    fini_network_list_handle(handle);
+    free(handle);
 }
 
-static int run_cni_plugin(const struct network_config_list *list, size_t i, const char *operator,
-                          const struct runtime_conf *rc, const char * const *paths, size_t paths_len,
-                          struct result **pret, char **err)
+/*
+ * find plugin and build its config, shared by sync and async operations;
+ * plugin_path is borrowed from handle or allocated from arena, net_bytes is allocated from scratch,
+ * which is reset by caller once the plugin has been started
+ * */
+static int prepare_cni_plugin(struct cni_network_list_handle *handle, size_t i, const struct runtime_conf *rc,
+                              const char *prev_result, struct clibcni_util_arena *arena,
+                              struct clibcni_util_arena *scratch, const char **plugin_path, char **net_bytes,
+                              char **err)
 {
     int ret = -1;
     struct network_config net = { 0 };
-    char *plugin_path = NULL;
-    struct cni_args *cargs = NULL;
-    char *full_conf_bytes = NULL;
-    struct result *tmp_result = NULL;
+    char *found_path = NULL;
     int save_errno = 0;
 
-    net.network = list->list->plugins[i];
+    net.network = handle->list->list->plugins[i];
     if (net.network == NULL) {
         *err = clibcni_util_strdup_s("Empty network");
         ERROR("Empty network");
         goto free_out;
     }
 
-    ret = find_in_path(net.network->type, paths, paths_len, &plugin_path, &save_errno);
+    if (handle->plugin_paths != NULL && handle->plugin_paths[i] != NULL) {
+        *plugin_path = handle->plugin_paths[i];
+        ret = 0;
+    } else {
+        ret = find_in_path(net.network->type, (const char * const *)handle->paths, handle->paths_len, &found_path,
+                           &save_errno);
+        if (ret == 0) {
+            *plugin_path = clibcni_util_arena_strdup(arena, found_path);
+            free(found_path);
+            if (*plugin_path == NULL) {
+                *err = clibcni_util_strdup_s("Out of memory");
+                ERROR("Out of memory");
+                ret = -1;
+                goto free_out;
+            }
+        }
+    }
     if (ret != 0) {
         if (asprintf(err, "find plugin: \"%s\" failed: %s", net.network->type, get_invoke_err_msg(save_errno)) < 0) {
             *err = clibcni_util_strdup_s("Out of memory");
@@ -327,96 +729,148 @@ static int run_cni_plugin(const struct network_config_list *list, size_t i, cons
         goto free_out;
     }
 
-    tmp_result = pret != NULL ? *pret : NULL;
-    ret = build_one_config(list, &net, tmp_result, rc, &full_conf_bytes, err);
+    if (handle->templates != NULL && handle->templates[i].plain != NULL) {
+        ret = build_config_from_template(&handle->templates[i], &net, prev_result, rc, scratch, &net.bytes, err);
+        if (ret < 0) {
+            ERROR("build config from template failed: %s", *err != NULL ? *err : "");
+            goto free_out;
+        }
+        if (ret == 0) {
+            goto config_out;
+        }
+    }
+
+    ret = build_one_config(handle->list, &net, prev_result, rc, scratch, &net.bytes, err);
     if (ret != 0) {
         ERROR("build config failed: %s", *err != NULL ? *err : "");
         goto free_out;
     }
 
-    ret = do_check_generate_cni_net_conf_json(&full_conf_bytes, &net, err);
+config_out:
+    *net_bytes = net.bytes;
+free_out:
     if (ret != 0) {
-        ERROR("check gengerate net config failed: %s", *err != NULL ? *err : "");
-        goto free_out;
+        *plugin_path = NULL;
     }
+    return ret;
+}
+
+/*
+ * result of plugin is kept as raw json in praw for next plugin, and decoded in presult, which is
+ * the result of chain after the last plugin; config of plugin is built in scratch, it is reset when the plugin is done
+ * */
+static int run_cni_plugin(struct cni_network_list_handle *handle, size_t i, const struct runtime_conf *rc,
+                          const struct cni_args *cargs, struct clibcni_util_arena *arena,
+                          struct clibcni_util_arena *scratch, int64_t deadline, char **praw, struct result **presult,
+                          char **err)
+{
+    int ret = -1;
+    const char *plugin_path = NULL;
+    char *net_bytes = NULL;
 
-    ret = args(operator, rc, paths, paths_len, &cargs, err);
+    ret = prepare_cni_plugin(handle, i, rc, praw != NULL ? *praw : NULL, arena, scratch, &plugin_path, &net_bytes,
+                             err);
     if (ret != 0) {
-        ERROR("get plugin arguments failed: %s", *err != NULL ? *err : "");
         goto free_out;
     }
 
-    if (pret == NULL) {
-        ret = exec_plugin_without_result(plugin_path, net.bytes, cargs, err);
+    if (praw == NULL) {
+        ret = exec_plugin_without_result(plugin_path, net_bytes, cargs, deadline, err);
     } else {
-        free_result(*pret);
-        *pret = NULL;
-        ret = exec_plugin_with_result(plugin_path, net.bytes, cargs, pret, err);
+        free(*praw);
+        *praw = NULL;
+        free_result(*presult);
+        *presult = NULL;
+        ret = exec_plugin_with_raw_result(plugin_path, net_bytes, cargs, deadline, praw, presult, err);
     }
     if (ret != 0) {
-        ERROR("pod %s CNI op failed with %s", rc->container_id, net.bytes);
+        ERROR("pod %s CNI op failed with %s", rc->container_id, net_bytes);
     }
 free_out:
-    free_cni_args(cargs);
-    free(plugin_path);
-    free(net.bytes);
+    clibcni_util_arena_reset(scratch);
     return ret;
 }
 
-static inline bool check_add_network_list_args(const struct network_config_list *list, const struct runtime_conf *rc,
-                                               struct result * const *pret, char * const *err)
+static inline bool check_add_network_list_args(const struct cni_network_list_handle *handle,
+                                               const struct runtime_conf *rc, struct result * const *pret,
+                                               char * const *err)
 {
-    return (list == NULL || list->list == NULL || rc == NULL || pret == NULL || err == NULL);
+    return (handle == NULL || handle->list == NULL || handle->list->list == NULL || rc == NULL || pret == NULL ||
+            err == NULL);
 }
 
-static int add_network_list(const struct network_config_list *list, const struct runtime_conf *rc,
-                            const char * const *paths, size_t paths_len, struct result **pret, char **err)
+static int add_network_list(struct cni_network_list_handle *handle, const struct runtime_conf *rc,
+                            const struct cni_exec_opts *opts, struct result **pret, char **err)
 {
     int ret = -1;
     size_t i = 0;
-    struct result *prev_result = NULL;
+    char *prev_result = NULL;
+    struct result *last_result = NULL;
+    struct clibcni_util_arena arena = { 0 };
+    struct clibcni_util_arena scratch = { 0 };
+    struct cni_args *cargs = NULL;
+    int64_t deadline = 0;
 
-    if (check_add_network_list_args(list, rc, pret, err)) {
+    if (check_add_network_list_args(handle, rc, pret, err)) {
         ERROR("Empty arguments");
         return -1;
     }
 
-    for (i = 0; i < list->list->plugins_len; i++) {
-        ret = run_cni_plugin(list, i, "ADD", rc, paths, paths_len, &prev_result, err);
+    deadline = get_deadline(opts);
+    /* arguments are the same for all plugins of chain */
+    ret = args("ADD", rc, (const char * const *)handle->paths, handle->paths_len, &arena, &cargs, err);
+    if (ret != 0) {
+        ERROR("Get ADD cni arguments: %s", *err != NULL ? *err : "");
+        goto free_out;
+    }
+    for (i = 0; i < handle->list->list->plugins_len; i++) {
+        ret = run_cni_plugin(handle, i, rc, cargs, &arena, &scratch, deadline, &prev_result, &last_result, err);
         if (ret != 0) {
             ERROR("Run ADD cni failed: %s", *err != NULL ? *err : "");
             goto free_out;
         }
     }
 
-    *pret = prev_result;
-    ret = 0;
+    *pret = last_result;
+    last_result = NULL;
 free_out:
-    if (ret != 0) {
-        free_result(prev_result);
-    }
+    free(prev_result);
+    free_result(last_result);
+    clibcni_util_arena_free(&scratch);
+    clibcni_util_arena_free(&arena);
     return ret;
 }
 
-static inline bool check_del_network_list_args(const struct network_config_list *list, const struct runtime_conf *rc,
-                                               char * const *err)
+static inline bool check_del_network_list_args(const struct cni_network_list_handle *handle,
+                                               const struct runtime_conf *rc, char * const *err)
 {
-    return (list == NULL || list->list == NULL || rc == NULL || err == NULL);
+    return (handle == NULL || handle->list == NULL || handle->list->list == NULL || rc == NULL || err == NULL);
 }
 
-static int del_network_list(const struct network_config_list *list, const struct runtime_conf *rc,
-                            const char * const *paths, size_t paths_len, char **err)
+static int del_network_list(struct cni_network_list_handle *handle, const struct runtime_conf *rc,
+                            const struct cni_exec_opts *opts, char **err)
 {
     size_t i = 0;
     int ret = 0;
+    struct clibcni_util_arena arena = { 0 };
+    struct clibcni_util_arena scratch = { 0 };
+    struct cni_args *cargs = NULL;
+    int64_t deadline = 0;
 
-    if (check_del_network_list_args(list, rc, err)) {
+    if (check_del_network_list_args(handle, rc, err)) {
         ERROR("Empty arguments");
         return -1;
     }
 
-    for (i = list->list->plugins_len; i > 0; i--) {
-        ret = run_cni_plugin(list, (i - 1), "DEL", rc, paths, paths_len, NULL, err);
+    deadline = get_deadline(opts);
+    /* arguments are the same for all plugins of chain */
+    ret = args("DEL", rc, (const char * const *)handle->paths, handle->paths_len, &arena, &cargs, err);
+    if (ret != 0) {
+        ERROR("Get DEL cni arguments: %s", *err != NULL ? *err : "");
+        goto free_out;
+    }
+    for (i = handle->list->list->plugins_len; i > 0; i--) {
+        ret = run_cni_plugin(handle, (i - 1), rc, cargs, &arena, &scratch, deadline, NULL, NULL, err);
         if (ret != 0) {
             ERROR("Run DEL cni failed: %s", *err != NULL ? *err : "");
             goto free_out;
@@ -424,6 +878,8 @@ static int del_network_list(const struct network_config_list *list, const struct
     }
 
 free_out:
+    clibcni_util_arena_free(&scratch);
+    clibcni_util_arena_free(&arena);
     return ret;
 }
 
@@ -433,12 +889,14 @@ static inline bool check_add_network_args(const struct network_config *net, cons
     return (net == NULL || rc == NULL || err == NULL);
 }
 
-static int add_network(const struct network_config *net, const struct runtime_conf *rc, const char * const *paths,
-                       size_t paths_len, struct result **add_result, char **err)
+static int add_network(const struct network_config *net, const struct runtime_conf *rc,
+                       const struct cni_exec_opts *opts, const char * const *paths, size_t paths_len,
+                       struct result **add_result, char **err)
 {
     int ret = 0;
     char *plugin_path = NULL;
     char *net_bytes = NULL;
+    struct clibcni_util_arena arena = { 0 };
     struct cni_args *cargs = NULL;
     int save_errno = 0;
 
@@ -461,17 +919,17 @@ static int add_network(const struct network_config *net, const struct runtime_co
         goto free_out;
     }
 
-    ret = args("ADD", rc, paths, paths_len, &cargs, err);
+    ret = args("ADD", rc, paths, paths_len, &arena, &cargs, err);
     if (ret != 0) {
         ERROR("Get ADD cni arguments: %s", *err != NULL ? *err : "");
         goto free_out;
     }
 
-    ret = exec_plugin_with_result(plugin_path, net_bytes, cargs, add_result, err);
+    ret = exec_plugin_with_result(plugin_path, net_bytes, cargs, get_deadline(opts), add_result, err);
 free_out:
     free(plugin_path);
     free(net_bytes);
-    free_cni_args(cargs);
+    clibcni_util_arena_free(&arena);
     return ret;
 }
 
@@ -481,12 +939,13 @@ static inline bool check_del_network_args(const struct network_config *net, cons
     return (net == NULL || net->network == NULL || rc == NULL || err == NULL);
 }
 
-static int del_network(const struct network_config *net, const struct runtime_conf *rc, const char * const *paths,
-                       size_t paths_len, char **err)
+static int del_network(const struct network_config *net, const struct runtime_conf *rc,
+                       const struct cni_exec_opts *opts, const char * const *paths, size_t paths_len, char **err)
 {
     int ret = 0;
     char *plugin_path = NULL;
     char *net_bytes = NULL;
+    struct clibcni_util_arena arena = { 0 };
     struct cni_args *cargs = NULL;
     int save_errno = 0;
 
@@ -509,21 +968,22 @@ static int del_network(const struct network_config *net, const struct runtime_co
         goto free_out;
     }
 
-    ret = args("DEL", rc, paths, paths_len, &cargs, err);
+    ret = args("DEL", rc, paths, paths_len, &arena, &cargs, err);
     if (ret != 0) {
         ERROR("Get DEL cni arguments: %s", *err != NULL ? *err : "");
         goto free_out;
     }
 
-    ret = exec_plugin_without_result(plugin_path, net_bytes, cargs, err);
+    ret = exec_plugin_without_result(plugin_path, net_bytes, cargs, get_deadline(opts), err);
 free_out:
     free(plugin_path);
     free(net_bytes);
-    free_cni_args(cargs);
+    clibcni_util_arena_free(&arena);
     return ret;
 }
 
-static int do_copy_plugin_args(const struct runtime_conf *rc, struct cni_args **cargs)
+static int do_copy_plugin_args(const struct runtime_conf *rc, struct clibcni_util_arena *arena,
+                               struct cni_args *cargs)
 {
     size_t i = 0;
 
@@ -535,49 +995,50 @@ static int do_copy_plugin_args(const struct runtime_conf *rc, struct cni_args **
         ERROR("Large arguments");
         return -1;
     }
-    (*cargs)->plugin_args = clibcni_util_common_calloc_s((rc->args_len) * sizeof(char *) * 2);
-    if ((*cargs)->plugin_args == NULL) {
+    cargs->plugin_args = clibcni_util_arena_alloc(arena, (rc->args_len) * sizeof(char *) * 2);
+    if (cargs->plugin_args == NULL) {
         ERROR("Out of memory");
         return -1;
     }
     for (i = 0; i < rc->args_len; i++) {
-        (*cargs)->plugin_args[i][0] = clibcni_util_strdup_s(rc->args[i][0]);
-        (*cargs)->plugin_args[i][1] = clibcni_util_strdup_s(rc->args[i][1]);
-        (*cargs)->plugin_args_len = (i + 1);
+        cargs->plugin_args[i][0] = clibcni_util_arena_strdup(arena, rc->args[i][0]);
+        cargs->plugin_args[i][1] = clibcni_util_arena_strdup(arena, rc->args[i][1]);
+        if ((rc->args[i][0] != NULL && cargs->plugin_args[i][0] == NULL) ||
+            (rc->args[i][1] != NULL && cargs->plugin_args[i][1] == NULL)) {
+            ERROR("Out of memory");
+            return -1;
+        }
+        cargs->plugin_args_len = (i + 1);
     }
 
     return 0;
 }
 
-static int copy_args(const struct runtime_conf *rc, struct cni_args **cargs)
+static int copy_args(const struct runtime_conf *rc, struct clibcni_util_arena *arena, struct cni_args *cargs)
 {
-    if (rc->container_id != NULL) {
-        (*cargs)->container_id = clibcni_util_strdup_s(rc->container_id);
-    }
-    if (rc->netns != NULL) {
-        (*cargs)->netns = clibcni_util_strdup_s(rc->netns);
-    }
-    if (rc->ifname != NULL) {
-        (*cargs)->ifname = clibcni_util_strdup_s(rc->ifname);
+    cargs->container_id = clibcni_util_arena_strdup(arena, rc->container_id);
+    cargs->netns = clibcni_util_arena_strdup(arena, rc->netns);
+    cargs->ifname = clibcni_util_arena_strdup(arena, rc->ifname);
+    if ((rc->container_id != NULL && cargs->container_id == NULL) || (rc->netns != NULL && cargs->netns == NULL) ||
+        (rc->ifname != NULL && cargs->ifname == NULL)) {
+        ERROR("Out of memory");
+        return -1;
     }
 
-    return do_copy_plugin_args(rc, cargs);
+    return do_copy_plugin_args(rc, arena, cargs);
 }
 
-static int do_copy_args_paths(const char * const *paths, size_t paths_len, struct cni_args **cargs)
+static int do_copy_args_paths(const char * const *paths, size_t paths_len, struct clibcni_util_arena *arena,
+                              struct cni_args *cargs)
 {
     if (paths == NULL) {
         return 0;
     }
 
-    if (paths_len == 0) {
-        (*cargs)->path = clibcni_util_strdup_s("");
-    } else {
-        (*cargs)->path = clibcni_util_string_join(":", paths, paths_len);
-        if ((*cargs)->path == NULL) {
-            ERROR("Out of memory");
-            return -1;
-        }
+    cargs->path = clibcni_util_arena_join(arena, ":", paths, paths_len);
+    if (cargs->path == NULL) {
+        ERROR("Out of memory");
+        return -1;
     }
     return 0;
 }
@@ -587,8 +1048,9 @@ static inline bool check_args_args(const struct runtime_conf *rc, struct cni_arg
     return (rc == NULL || cargs == NULL || err == NULL);
 }
 
+/* arguments live in arena, they are released with it */
 static int args(const char *action, const struct runtime_conf *rc, const char * const *paths, size_t paths_len,
-                struct cni_args **cargs, char **err)
+                struct clibcni_util_arena *arena, struct cni_args **cargs, char **err)
 {
     int ret = -1;
 
@@ -596,23 +1058,23 @@ static int args(const char *action, const struct runtime_conf *rc, const char *
         ERROR("Empty arguments");
         return ret;
     }
-    *cargs = clibcni_util_common_calloc_s(sizeof(struct cni_args));
+    *cargs = clibcni_util_arena_alloc(arena, sizeof(struct cni_args));
     if (*cargs == NULL) {
-        *err = clibcni_util_strdup_s("Out of memory");
         ERROR("Out of memory");
         goto free_out;
     }
-    if (action != NULL) {
-        (*cargs)->command = clibcni_util_strdup_s(action);
+    (*cargs)->command = clibcni_util_arena_strdup(arena, action);
+    if (action != NULL && (*cargs)->command == NULL) {
+        ERROR("Out of memory");
+        goto free_out;
     }
-    if (do_copy_args_paths(paths, paths_len, cargs) != 0) {
+    if (do_copy_args_paths(paths, paths_len, arena, *cargs) != 0) {
         goto free_out;
     }
-    ret = copy_args(rc, cargs);
+    ret = copy_args(rc, arena, *cargs);
 
 free_out:
     if (ret != 0) {
-        free_cni_args(*cargs);
         *cargs = NULL;
         if (*err == NULL) {
             *err = clibcni_util_strdup_s("Out of memory");
@@ -681,20 +1143,46 @@ void free_runtime_conf(struct runtime_conf *rc)
     free(rc);
 }
 
-int cni_add_network_list(const char *net_list_conf_str, const struct runtime_conf *rc, char **paths,
-                         struct result **pret, char **err)
+static int check_network_list_plugins(const struct network_config_list *list, char **err)
+{
+    size_t i = 0;
+
+    for (i = 0; i < list->list->plugins_len; i++) {
+        if (list->list->plugins[i] == NULL || list->list->plugins[i]->type == NULL ||
+            strlen(list->list->plugins[i]->type) == 0) {
+            if (asprintf(err, "Invalid plugin %zu of network list: no type", i) < 0) {
+                *err = clibcni_util_strdup_s("Out of memory");
+            }
+            ERROR("Invalid plugin %zu of network list: no type", i);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int network_list_handle_from_list(struct network_config_list *list, char **paths,
+                                         struct cni_network_list_handle **handle, char **err)
+{
+    if (check_network_list_plugins(list, err) != 0) {
+        free_network_config_list(list);
+        return -1;
+    }
+    return new_network_list_handle(list, paths, handle, err);
+}
+
+int cni_network_list_handle_from_bytes(const char *net_list_conf_str, char **paths,
+                                       struct cni_network_list_handle **handle, char **err)
 {
     struct network_config_list *list = NULL;
     int ret = 0;
-    size_t len = 0;
 
     if (err == NULL) {
-        ERROR("Empty arguments");
+        ERROR("Empty err");
         return -1;
     }
-    if (net_list_conf_str == NULL) {
-        *err = clibcni_util_strdup_s("Empty net list conf argument");
-        ERROR("Empty net list conf argument");
+    if (net_list_conf_str == NULL || handle == NULL) {
+        *err = clibcni_util_strdup_s("Empty net list conf or handle argument");
+        ERROR("Empty net list conf or handle argument");
         return -1;
     }
 
@@ -704,49 +1192,158 @@ int cni_add_network_list(const char *net_list_conf_str, const struct runtime_con
         return ret;
     }
 
-    len = clibcni_util_array_len((const char * const *)paths);
-    ret = add_network_list(list, rc, (const char * const *)paths, len, pret, err);
-
-    DEBUG("Add network list return with: %d", ret);
-    free_network_config_list(list);
-    return ret;
+    return network_list_handle_from_list(list, paths, handle, err);
 }
 
-int cni_add_network(const char *cni_net_conf_str, const struct runtime_conf *rc, char **paths,
-                    struct result **add_result,
-                    char **err)
+int cni_network_list_handle_from_file(const char *filename, char **paths, struct cni_network_list_handle **handle,
+                                      char **err)
 {
-    struct network_config *net = NULL;
+    struct network_config_list *list = NULL;
     int ret = 0;
-    size_t len = 0;
 
     if (err == NULL) {
         ERROR("Empty err");
         return -1;
     }
-    if (cni_net_conf_str == NULL) {
-        *err = clibcni_util_strdup_s("Empty net conf argument");
-        ERROR("Empty net conf argument");
+    if (filename == NULL || handle == NULL) {
+        *err = clibcni_util_strdup_s("Empty filename or handle argument");
+        ERROR("Empty filename or handle argument");
         return -1;
     }
 
-    ret = conf_from_bytes(cni_net_conf_str, &net, err);
+    ret = conflist_from_file(filename, &list, err);
+    if (ret != 0) {
+        ERROR("Parse conf list file %s failed: %s", filename, *err != NULL ? *err : "");
+        return ret;
+    }
+
+    return network_list_handle_from_list(list, paths, handle, err);
+}
+
+int cni_add_network_list_by_handle(struct cni_network_list_handle *handle, const struct runtime_conf *rc,
+                                   const struct cni_exec_opts *opts, struct result **pret, char **err)
+{
+    int ret = 0;
+
+    if (err == NULL) {
+        ERROR("Empty err");
+        return -1;
+    }
+    if (handle == NULL) {
+        *err = clibcni_util_strdup_s("Empty network list handle argument");
+        ERROR("Empty network list handle argument");
+        return -1;
+    }
+
+    ret = add_network_list(handle, rc, opts, pret, err);
+    DEBUG("Add network list by handle return with: %d", ret);
+    return ret;
+}
+
+int cni_del_network_list_by_handle(struct cni_network_list_handle *handle, const struct runtime_conf *rc,
+                                   const struct cni_exec_opts *opts, char **err)
+{
+    int ret = 0;
+
+    if (err == NULL) {
+        ERROR("Empty err");
+        return -1;
+    }
+    if (handle == NULL) {
+        *err = clibcni_util_strdup_s("Empty network list handle argument");
+        ERROR("Empty network list handle argument");
+        return -1;
+    }
+
+    ret = del_network_list(handle, rc, opts, err);
+    DEBUG("Delete network list by handle return with: %d", ret);
+    return ret;
+}
+
+int cni_add_network_list(const char *net_list_conf_str, const struct runtime_conf *rc, char **paths,
+                         struct result **pret, char **err)
+{
+    return cni_add_network_list_with_opts(net_list_conf_str, rc, NULL, paths, pret, err);
+}
+
+int cni_add_network_list_with_opts(const char *net_list_conf_str, const struct runtime_conf *rc,
+                                   const struct cni_exec_opts *opts, char **paths, struct result **pret, char **err)
+{
+    struct network_config_list *list = NULL;
+    struct cni_network_list_handle handle = { 0 };
+    int ret = 0;
+
+    if (err == NULL) {
+        ERROR("Empty arguments");
+        return -1;
+    }
+    if (net_list_conf_str == NULL) {
+        *err = clibcni_util_strdup_s("Empty net list conf argument");
+        ERROR("Empty net list conf argument");
+        return -1;
+    }
+
+    ret = conflist_from_bytes(net_list_conf_str, &list, err);
+    if (ret != 0) {
+        ERROR("Parse conf list failed: %s", *err != NULL ? *err : "");
+        return ret;
+    }
+
+    init_network_list_handle(&handle, list, paths);
+    ret = add_network_list(&handle, rc, opts, pret, err);
+
+    DEBUG("Add network list return with: %d", ret);
+    fini_network_list_handle(&handle);
+    return ret;
+}
+
+int cni_add_network(const char *cni_net_conf_str, const struct runtime_conf *rc, char **paths,
+                    struct result **add_result,
+                    char **err)
+{
+    return cni_add_network_with_opts(cni_net_conf_str, rc, NULL, paths, add_result, err);
+}
+
+int cni_add_network_with_opts(const char *cni_net_conf_str, const struct runtime_conf *rc,
+                              const struct cni_exec_opts *opts, char **paths, struct result **add_result, char **err)
+{
+    struct network_config *net = NULL;
+    int ret = 0;
+    size_t len = 0;
+
+    if (err == NULL) {
+        ERROR("Empty err");
+        return -1;
+    }
+    if (cni_net_conf_str == NULL) {
+        *err = clibcni_util_strdup_s("Empty net conf argument");
+        ERROR("Empty net conf argument");
+        return -1;
+    }
+
+    ret = conf_from_bytes(cni_net_conf_str, &net, err);
     if (ret != 0) {
         ERROR("Parse conf failed: %s", *err != NULL ? *err : "");
         return ret;
     }
 
     len = clibcni_util_array_len((const char * const *)paths);
-    ret = add_network(net, rc, (const char * const *)paths, len, add_result, err);
+    ret = add_network(net, rc, opts, (const char * const *)paths, len, add_result, err);
     free_network_config(net);
     return ret;
 }
 
 int cni_del_network_list(const char *net_list_conf_str, const struct runtime_conf *rc, char **paths, char **err)
+{
+    return cni_del_network_list_with_opts(net_list_conf_str, rc, NULL, paths, err);
+}
+
+int cni_del_network_list_with_opts(const char *net_list_conf_str, const struct runtime_conf *rc,
+                                   const struct cni_exec_opts *opts, char **paths, char **err)
 {
     struct network_config_list *list = NULL;
+    struct cni_network_list_handle handle = { 0 };
     int ret = 0;
-    size_t len = 0;
 
     if (err == NULL) {
         ERROR("Empty err");
@@ -764,15 +1361,21 @@ int cni_del_network_list(const char *net_list_conf_str, const struct runtime_con
         return ret;
     }
 
-    len = clibcni_util_array_len((const char * const *)paths);
-    ret = del_network_list(list, rc, (const char * const *)paths, len, err);
+    init_network_list_handle(&handle, list, paths);
+    ret = del_network_list(&handle, rc, opts, err);
 
     DEBUG("Delete network list return with: %d", ret);
-    free_network_config_list(list);
+    fini_network_list_handle(&handle);
     return ret;
 }
 
 int cni_del_network(const char *cni_net_conf_str, const struct runtime_conf *rc, char **paths, char **err)
+{
+    return cni_del_network_with_opts(cni_net_conf_str, rc, NULL, paths, err);
+}
+
+int cni_del_network_with_opts(const char *cni_net_conf_str, const struct runtime_conf *rc,
+                              const struct cni_exec_opts *opts, char **paths, char **err)
 {
     struct network_config *net = NULL;
     int ret = 0;
@@ -795,7 +1398,7 @@ int cni_del_network(const char *cni_net_conf_str, const struct runtime_conf *rc,
     }
 
     len = clibcni_util_array_len((const char * const *)paths);
-    ret = del_network(net, rc, (const char * const *)paths, len, err);
+    ret = del_network(net, rc, opts, (const char * const *)paths, len, err);
     free_network_config(net);
     return ret;
 }
@@ -835,6 +1438,16 @@ int cni_conf_files(const char *dir, const char **extensions, size_t ext_len, cha
     return conf_files(dir, extensions, ext_len, result, err);
 }
 
+int cni_conf_files_with_limit(const char *dir, const char **extensions, size_t ext_len, size_t max_files,
+                              char ***result, char **err)
+{
+    if (err == NULL) {
+        ERROR("Empty err");
+        return -1;
+    }
+    return conf_files_with_limit(dir, extensions, ext_len, max_files, result, err);
+}
+
 int cni_conf_from_file(const char *filename, struct cni_network_conf **config, char **err)
 {
     int ret = 0;
@@ -874,6 +1487,41 @@ free_out:
     return ret;
 }
 
+int cni_conf_from_dir(const char *dir, const char *name, struct cni_network_conf **config, char **err)
+{
+    int ret = 0;
+    char *type = NULL;
+    char *bytes = NULL;
+
+    if (config == NULL || err == NULL) {
+        ERROR("Empty arguments");
+        return -1;
+    }
+    ret = load_conf_from_dir_index(dir, name, &type, &bytes, err);
+    if (ret != 0) {
+        ERROR("Load conf %s from dir: %s failed: %s", name, dir, *err != NULL ? *err : "");
+        return ret;
+    }
+
+    *config = clibcni_util_common_calloc_s(sizeof(struct cni_network_conf));
+    if (*config == NULL) {
+        *err = clibcni_util_strdup_s("Out of memory");
+        ERROR("Out of memory");
+        free(type);
+        free(bytes);
+        return -1;
+    }
+    (*config)->name = clibcni_util_strdup_s(name);
+    (*config)->type = type;
+    (*config)->bytes = bytes;
+    return 0;
+}
+
+void cni_flush_conf_dir_cache(void)
+{
+    flush_conf_dir_cache();
+}
+
 static void json_obj_to_cni_list_conf(struct network_config_list *src, struct cni_network_list_conf *list)
 {
     if (src == NULL) {
@@ -1028,3 +1676,836 @@ void cni_free_log_prefix()
     isula_libutils_free_log_prefix();
 }
 
+int cni_exec_helper_init(void)
+{
+    return start_exec_helper();
+}
+
+int cni_set_exec_backend(enum cni_exec_backend backend)
+{
+    return set_exec_backend(backend);
+}
+
+void cni_set_plugin_output_limit(size_t limit)
+{
+    set_plugin_output_limit(limit);
+}
+
+void cni_flush_plugin_path_cache(void)
+{
+    flush_plugin_path_cache();
+}
+
+void cni_refresh_plugin_env(void)
+{
+    refresh_env_template();
+}
+
+struct cni_op {
+    bool is_add;
+    /* handle and rc belong to a batch, not freed with operation */
+    bool borrowed;
+    struct cni_network_list_handle *handle;
+    struct runtime_conf *rc;
+    /* arguments of plugins and other data living as long as the operation */
+    struct clibcni_util_arena arena;
+    /* config of plugin being started, reset for every plugin */
+    struct clibcni_util_arena scratch;
+    struct cni_args *cargs;
+    int64_t deadline;
+    /* count of plugins finished successfully */
+    size_t done_plugins;
+    bool running;
+    struct plugin_exec exec;
+    /* raw json result of last finished plugin for next plugin, and its decoded result */
+    char *raw_result;
+    struct result *result;
+    /* epoll set of running plugin and timer, returned by cni_op_get_fd */
+    int epfd;
+    int timerfd;
+    bool finished;
+    /* callback is called once, by the first cni_op_process seeing the finish */
+    bool notified;
+    int ret;
+    char *err;
+    cni_op_callback cb;
+    void *cb_data;
+};
+
+static struct runtime_conf *dup_runtime_conf(const struct runtime_conf *rc)
+{
+    struct runtime_conf *dup = NULL;
+    size_t i = 0;
+
+    dup = clibcni_util_common_calloc_s(sizeof(struct runtime_conf));
+    if (dup == NULL) {
+        return NULL;
+    }
+    dup->container_id = clibcni_util_strdup_s(rc->container_id);
+    dup->netns = clibcni_util_strdup_s(rc->netns);
+    dup->ifname = clibcni_util_strdup_s(rc->ifname);
+
+    if (rc->args_len > 0) {
+        dup->args = clibcni_util_smart_calloc_s(rc->args_len, sizeof(*dup->args));
+        if (dup->args == NULL) {
+            goto err_out;
+        }
+        dup->args_len = rc->args_len;
+        for (i = 0; i < rc->args_len; i++) {
+            dup->args[i][0] = clibcni_util_strdup_s(rc->args[i][0]);
+            dup->args[i][1] = clibcni_util_strdup_s(rc->args[i][1]);
+        }
+    }
+
+    if (rc->p_mapping_len > 0) {
+        dup->p_mapping = clibcni_util_smart_calloc_s(rc->p_mapping_len, sizeof(struct cni_port_mapping *));
+        if (dup->p_mapping == NULL) {
+            goto err_out;
+        }
+        dup->p_mapping_len = rc->p_mapping_len;
+        for (i = 0; i < rc->p_mapping_len; i++) {
+            if (rc->p_mapping[i] == NULL) {
+                continue;
+            }
+            dup->p_mapping[i] = clibcni_util_common_calloc_s(sizeof(struct cni_port_mapping));
+            if (dup->p_mapping[i] == NULL) {
+                goto err_out;
+            }
+            dup->p_mapping[i]->host_port = rc->p_mapping[i]->host_port;
+            dup->p_mapping[i]->container_port = rc->p_mapping[i]->container_port;
+            dup->p_mapping[i]->protocol = clibcni_util_strdup_s(rc->p_mapping[i]->protocol);
+            dup->p_mapping[i]->host_ip = clibcni_util_strdup_s(rc->p_mapping[i]->host_ip);
+        }
+    }
+
+    return dup;
+err_out:
+    free_runtime_conf(dup);
+    return NULL;
+}
+
+static int op_add_timer(struct cni_op *op)
+{
+    struct epoll_event ev = { 0 };
+
+    op->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (op->timerfd < 0) {
+        ERROR("Create timerfd failed: %s", strerror(errno));
+        return -1;
+    }
+    ev.events = EPOLLIN;
+    ev.data.fd = op->timerfd;
+    if (epoll_ctl(op->epfd, EPOLL_CTL_ADD, op->timerfd, &ev) != 0) {
+        ERROR("Add timerfd to epoll failed: %s", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static int op_arm_timer(struct cni_op *op)
+{
+    struct itimerspec its = { 0 };
+
+    if (op_add_timer(op) != 0) {
+        return -1;
+    }
+    its.it_value.tv_sec = op->deadline / 1000;
+    its.it_value.tv_nsec = (op->deadline % 1000) * 1000000;
+    if (timerfd_settime(op->timerfd, TFD_TIMER_ABSTIME, &its, NULL) != 0) {
+        ERROR("Set timerfd failed: %s", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/* make fd of operation readable at once, so that next cni_op_process reports the finish */
+static int op_wake(struct cni_op *op)
+{
+    struct itimerspec its = { 0 };
+
+    if (op->timerfd < 0 && op_add_timer(op) != 0) {
+        return -1;
+    }
+    its.it_value.tv_nsec = 1;
+    if (timerfd_settime(op->timerfd, 0, &its, NULL) != 0) {
+        ERROR("Set timerfd failed: %s", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static void op_clear_timer(const struct cni_op *op)
+{
+    uint64_t expirations = 0;
+
+    if (op->timerfd >= 0) {
+        (void)clibcni_util_read_nointr(op->timerfd, &expirations, sizeof(expirations));
+    }
+}
+
+static int op_start_plugin(struct cni_op *op)
+{
+    int ret = 0;
+    size_t i = 0;
+    const char *plugin_path = NULL;
+    char *net_bytes = NULL;
+
+    /* ADD runs plugins in order, DEL in reverse order */
+    i = op->is_add ? op->done_plugins : (op->handle->list->list->plugins_len - 1 - op->done_plugins);
+    ret = prepare_cni_plugin(op->handle, i, op->rc, op->raw_result, &op->arena, &op->scratch, &plugin_path,
+                             &net_bytes, &op->err);
+    if (ret != 0) {
+        goto out;
+    }
+
+    free(op->raw_result);
+    op->raw_result = NULL;
+    ret = plugin_exec_start(&op->exec, plugin_path, net_bytes, op->cargs, op->deadline, op->is_add, op->epfd,
+                            &op->err);
+    if (ret != 0) {
+        ERROR("Start plugin %s failed: %s", plugin_path, op->err != NULL ? op->err : "");
+        goto out;
+    }
+    op->running = true;
+
+out:
+    clibcni_util_arena_reset(&op->scratch);
+    return ret;
+}
+
+static int op_finish_plugin(struct cni_op *op)
+{
+    int ret = 0;
+
+    op->running = false;
+    free_result(op->result);
+    op->result = NULL;
+    ret = plugin_exec_finish(&op->exec, op->is_add ? &op->raw_result : NULL, op->is_add ? &op->result : NULL,
+                             &op->err);
+    if (ret != 0) {
+        ERROR("Run %s cni failed: %s", op->is_add ? "ADD" : "DEL", op->err != NULL ? op->err : "");
+        return ret;
+    }
+    op->done_plugins++;
+    return 0;
+}
+
+static void op_complete(struct cni_op *op, int ret)
+{
+    /* result of the last plugin is the result of chain */
+    if (ret != 0) {
+        free_result(op->result);
+        op->result = NULL;
+    }
+    free(op->raw_result);
+    op->raw_result = NULL;
+    op->finished = true;
+    op->ret = ret;
+    DEBUG("%s network list async return with: %d", op->is_add ? "Add" : "Delete", ret);
+}
+
+/* run plugins of operation as far as they go without waiting, return true when operation finished */
+static bool op_advance(struct cni_op *op)
+{
+    int ret = 0;
+
+    while (!op->finished) {
+        if (!op->running) {
+            if (op->done_plugins == op->handle->list->list->plugins_len) {
+                op_complete(op, 0);
+                break;
+            }
+            ret = op_start_plugin(op);
+            if (ret != 0) {
+                op_complete(op, ret);
+                break;
+            }
+        }
+        if (!plugin_exec_progress(&op->exec)) {
+            return false;
+        }
+        ret = op_finish_plugin(op);
+        if (ret != 0) {
+            op_complete(op, ret);
+        }
+    }
+
+    return true;
+}
+
+int cni_op_process(struct cni_op *op)
+{
+    if (op == NULL) {
+        ERROR("Empty operation");
+        return -1;
+    }
+
+    op_clear_timer(op);
+    if (!op_advance(op)) {
+        return 0;
+    }
+    if (op->cb != NULL && !op->notified) {
+        op->notified = true;
+        /* callback may free the operation, so it is not touched after the call */
+        op->cb(op, op->cb_data);
+    }
+
+    return 1;
+}
+
+static struct cni_op *new_op(bool is_add, cni_op_callback cb, void *cb_data)
+{
+    struct cni_op *op = NULL;
+
+    op = clibcni_util_common_calloc_s(sizeof(struct cni_op));
+    if (op == NULL) {
+        ERROR("Out of memory");
+        return NULL;
+    }
+    op->is_add = is_add;
+    op->epfd = -1;
+    op->timerfd = -1;
+    op->cb = cb;
+    op->cb_data = cb_data;
+    return op;
+}
+
+/*
+ * create fds of operation and start first plugin, so that fd of operation has something to wait;
+ * callback is never called here, an operation finished already wakes its fd for cni_op_process
+ * */
+static int op_launch(struct cni_op *op, const struct cni_exec_opts *opts, char **err)
+{
+    if (args(op->is_add ? "ADD" : "DEL", op->rc, (const char * const *)op->handle->paths, op->handle->paths_len,
+             &op->arena, &op->cargs, err) != 0) {
+        ERROR("Get cni arguments: %s", *err != NULL ? *err : "");
+        return -1;
+    }
+
+    op->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (op->epfd < 0) {
+        *err = clibcni_util_strdup_s("Create epoll failed");
+        ERROR("Create epoll failed: %s", strerror(errno));
+        return -1;
+    }
+    op->deadline = get_deadline(opts);
+    if (op->deadline > 0 && op_arm_timer(op) != 0) {
+        *err = clibcni_util_strdup_s("Create timer failed");
+        return -1;
+    }
+
+    if (op_advance(op) && op_wake(op) != 0) {
+        *err = clibcni_util_strdup_s("Create timer failed");
+        return -1;
+    }
+    return 0;
+}
+
+static int new_network_list_op(bool is_add, const char *net_list_conf_str, const struct runtime_conf *rc,
+                               const struct cni_exec_opts *opts, char **paths, cni_op_callback cb, void *cb_data,
+                               struct cni_op **op, char **err)
+{
+    struct cni_op *tmp = NULL;
+    struct network_config_list *list = NULL;
+    int ret = 0;
+
+    if (err == NULL) {
+        ERROR("Empty arguments");
+        return -1;
+    }
+    if (net_list_conf_str == NULL || rc == NULL || op == NULL) {
+        *err = clibcni_util_strdup_s("Empty net list conf, runtime conf or operation argument");
+        ERROR("Empty net list conf, runtime conf or operation argument");
+        return -1;
+    }
+
+    tmp = new_op(is_add, cb, cb_data);
+    if (tmp == NULL) {
+        *err = clibcni_util_strdup_s("Out of memory");
+        return -1;
+    }
+
+    ret = conflist_from_bytes(net_list_conf_str, &list, err);
+    if (ret != 0) {
+        ERROR("Parse conf list failed: %s", *err != NULL ? *err : "");
+        goto err_out;
+    }
+    ret = new_network_list_handle(list, paths, &tmp->handle, err);
+    if (ret != 0) {
+        goto err_out;
+    }
+
+    tmp->rc = dup_runtime_conf(rc);
+    if (tmp->rc == NULL) {
+        *err = clibcni_util_strdup_s("Out of memory");
+        ERROR("Out of memory");
+        ret = -1;
+        goto err_out;
+    }
+
+    ret = op_launch(tmp, opts, err);
+    if (ret != 0) {
+        goto err_out;
+    }
+    *op = tmp;
+    return 0;
+
+err_out:
+    cni_op_free(tmp);
+    return ret;
+}
+
+int cni_add_network_list_async(const char *net_list_conf_str, const struct runtime_conf *rc,
+                               const struct cni_exec_opts *opts, char **paths, cni_op_callback cb, void *cb_data,
+                               struct cni_op **op, char **err)
+{
+    return new_network_list_op(true, net_list_conf_str, rc, opts, paths, cb, cb_data, op, err);
+}
+
+int cni_del_network_list_async(const char *net_list_conf_str, const struct runtime_conf *rc,
+                               const struct cni_exec_opts *opts, char **paths, cni_op_callback cb, void *cb_data,
+                               struct cni_op **op, char **err)
+{
+    return new_network_list_op(false, net_list_conf_str, rc, opts, paths, cb, cb_data, op, err);
+}
+
+int cni_op_get_fd(const struct cni_op *op)
+{
+    if (op == NULL) {
+        return -1;
+    }
+    return op->epfd;
+}
+
+int cni_op_wait(struct cni_op *op, int timeout_ms)
+{
+    struct pollfd pfd = { 0 };
+    int64_t deadline = 0;
+    int64_t remain = -1;
+    int nret = 0;
+
+    if (op == NULL) {
+        ERROR("Empty operation");
+        return -1;
+    }
+    if (timeout_ms >= 0) {
+        deadline = clibcni_util_monotonic_ms() + timeout_ms;
+    }
+
+    while (cni_op_process(op) == 0) {
+        if (timeout_ms >= 0) {
+            remain = deadline - clibcni_util_monotonic_ms();
+            if (remain <= 0) {
+                errno = ETIMEDOUT;
+                return -1;
+            }
+        }
+        pfd.fd = op->epfd;
+        pfd.events = POLLIN;
+        nret = poll(&pfd, 1, (int)remain);
+        if (nret < 0 && errno != EINTR) {
+            ERROR("Poll operation failed: %s", strerror(errno));
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int cni_op_result(struct cni_op *op, struct result **pret, char **err)
+{
+    if (op == NULL || err == NULL) {
+        ERROR("Empty arguments");
+        return -1;
+    }
+    if (!op->finished) {
+        *err = clibcni_util_strdup_s("Operation is not finished");
+        return -1;
+    }
+
+    if (pret != NULL) {
+        *pret = op->result;
+        op->result = NULL;
+    }
+    *err = op->err;
+    op->err = NULL;
+    return op->ret;
+}
+
+void cni_op_free(struct cni_op *op)
+{
+    if (op == NULL) {
+        return;
+    }
+    if (op->running) {
+        /* kill and reap the plugin still running */
+        plugin_exec_release(&op->exec);
+        op->running = false;
+    }
+    if (op->timerfd >= 0) {
+        (void)close(op->timerfd);
+    }
+    if (op->epfd >= 0) {
+        (void)close(op->epfd);
+    }
+    if (!op->borrowed) {
+        cni_network_list_handle_free(op->handle);
+        free_runtime_conf(op->rc);
+    }
+    clibcni_util_arena_free(&op->scratch);
+    clibcni_util_arena_free(&op->arena);
+    free(op->raw_result);
+    free_result(op->result);
+    free(op->err);
+    free(op);
+}
+
+#define BATCH_MAX_EVENTS 64
+
+struct network_list_batch {
+    bool is_add;
+    struct cni_network_list_handle *handle;
+    struct cni_batch_item *items;
+    struct cni_op **ops;
+    size_t running;
+    int epfd;
+};
+
+static void batch_collect_item(struct network_list_batch *batch, size_t idx)
+{
+    struct cni_batch_item *item = &batch->items[idx];
+    struct cni_op *op = batch->ops[idx];
+
+    item->ret = cni_op_result(op, batch->is_add ? &item->result : NULL, &item->err);
+    if (op->epfd >= 0) {
+        (void)epoll_ctl(batch->epfd, EPOLL_CTL_DEL, op->epfd, NULL);
+    }
+    cni_op_free(op);
+    batch->ops[idx] = NULL;
+    batch->running--;
+}
+
+static void batch_start_item(struct network_list_batch *batch, size_t idx)
+{
+    struct cni_batch_item *item = &batch->items[idx];
+    struct cni_op *op = NULL;
+    struct epoll_event ev = { 0 };
+
+    item->ret = -1;
+    if (item->rc == NULL) {
+        item->err = clibcni_util_strdup_s("Empty runtime conf");
+        ERROR("Empty runtime conf of batch item %zu", idx);
+        return;
+    }
+
+    op = new_op(batch->is_add, NULL, NULL);
+    if (op == NULL) {
+        item->err = clibcni_util_strdup_s("Out of memory");
+        return;
+    }
+    op->borrowed = true;
+    op->handle = batch->handle;
+    op->rc = (struct runtime_conf *)item->rc;
+    if (op_launch(op, item->opts, &item->err) != 0) {
+        cni_op_free(op);
+        return;
+    }
+    batch->ops[idx] = op;
+    batch->running++;
+    if (op->finished) {
+        batch_collect_item(batch, idx);
+        return;
+    }
+
+    ev.events = EPOLLIN;
+    ev.data.u64 = idx;
+    if (epoll_ctl(batch->epfd, EPOLL_CTL_ADD, op->epfd, &ev) != 0) {
+        ERROR("Add operation to epoll failed: %s", strerror(errno));
+        free(item->err);
+        item->err = clibcni_util_strdup_s("Add operation to epoll failed");
+        cni_op_free(op);
+        batch->ops[idx] = NULL;
+        batch->running--;
+    }
+}
+
+static int batch_wait_items(struct network_list_batch *batch, char **err)
+{
+    struct epoll_event events[BATCH_MAX_EVENTS];
+    size_t idx = 0;
+    int nret = 0;
+    int i = 0;
+
+    nret = epoll_wait(batch->epfd, events, BATCH_MAX_EVENTS, -1);
+    if (nret < 0) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        *err = clibcni_util_strdup_s("Wait batch operations failed");
+        ERROR("Wait batch operations failed: %s", strerror(errno));
+        return -1;
+    }
+    for (i = 0; i < nret; i++) {
+        idx = (size_t)events[i].data.u64;
+        if (batch->ops[idx] != NULL && cni_op_process(batch->ops[idx]) == 1) {
+            batch_collect_item(batch, idx);
+        }
+    }
+    return 0;
+}
+
+static inline bool check_network_list_batch_args(const char *net_list_conf_str,
+                                                 const struct cni_batch_item *items, size_t items_len)
+{
+    return (net_list_conf_str == NULL || (items == NULL && items_len > 0));
+}
+
+static int network_list_batch(bool is_add, const char *net_list_conf_str, char **paths,
+                              struct cni_batch_item *items, size_t items_len, size_t max_parallel, char **err)
+{
+    struct network_list_batch batch = { 0 };
+    struct network_config_list *list = NULL;
+    size_t next = 0;
+    size_t failed = 0;
+    size_t i = 0;
+    int ret = 0;
+
+    if (err == NULL) {
+        ERROR("Empty arguments");
+        return -1;
+    }
+    if (check_network_list_batch_args(net_list_conf_str, items, items_len)) {
+        *err = clibcni_util_strdup_s("Empty net list conf or batch items");
+        ERROR("Empty net list conf or batch items");
+        return -1;
+    }
+
+    for (i = 0; i < items_len; i++) {
+        items[i].ret = -1;
+        items[i].result = NULL;
+        items[i].err = NULL;
+    }
+    if (max_parallel == 0 || max_parallel > items_len) {
+        max_parallel = items_len;
+    }
+    batch.is_add = is_add;
+    batch.items = items;
+    batch.epfd = -1;
+
+    /* parsed config and resolved plugins are shared by all items of batch */
+    ret = conflist_from_bytes(net_list_conf_str, &list, err);
+    if (ret != 0) {
+        ERROR("Parse conf list failed: %s", *err != NULL ? *err : "");
+        goto free_out;
+    }
+    ret = new_network_list_handle(list, paths, &batch.handle, err);
+    if (ret != 0) {
+        goto free_out;
+    }
+    batch.ops = clibcni_util_smart_calloc_s(items_len + 1, sizeof(struct cni_op *));
+    if (batch.ops == NULL) {
+        *err = clibcni_util_strdup_s("Out of memory");
+        ERROR("Out of memory");
+        ret = -1;
+        goto free_out;
+    }
+    batch.epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (batch.epfd < 0) {
+        *err = clibcni_util_strdup_s("Create epoll failed");
+        ERROR("Create epoll failed: %s", strerror(errno));
+        ret = -1;
+        goto free_out;
+    }
+
+    while (next < items_len || batch.running > 0) {
+        while (next < items_len && batch.running < max_parallel) {
+            batch_start_item(&batch, next);
+            next++;
+        }
+        if (batch.running == 0) {
+            continue;
+        }
+        ret = batch_wait_items(&batch, err);
+        if (ret != 0) {
+            goto free_out;
+        }
+    }
+
+    for (i = 0; i < items_len; i++) {
+        if (items[i].ret != 0) {
+            failed++;
+        }
+    }
+    if (failed > 0) {
+        if (asprintf(err, "%zu of %zu networks failed", failed, items_len) < 0) {
+            *err = clibcni_util_strdup_s("Out of memory");
+        }
+        ret = -1;
+    }
+
+free_out:
+    for (i = 0; batch.ops != NULL && i < items_len; i++) {
+        if (batch.ops[i] == NULL) {
+            continue;
+        }
+        /* kill plugins still running when batch failed */
+        cni_op_free(batch.ops[i]);
+        if (items[i].err == NULL) {
+            items[i].err = clibcni_util_strdup_s("Batch aborted");
+        }
+    }
+    if (batch.epfd >= 0) {
+        (void)close(batch.epfd);
+    }
+    free(batch.ops);
+    cni_network_list_handle_free(batch.handle);
+    return ret;
+}
+
+int cni_add_network_list_batch(const char *net_list_conf_str, char **paths, struct cni_batch_item *items,
+                               size_t items_len, size_t max_parallel, char **err)
+{
+    return network_list_batch(true, net_list_conf_str, paths, items, items_len, max_parallel, err);
+}
+
+int cni_del_network_list_batch(const char *net_list_conf_str, char **paths, struct cni_batch_item *items,
+                               size_t items_len, size_t max_parallel, char **err)
+{
+    return network_list_batch(false, net_list_conf_str, paths, items, items_len, max_parallel, err);
+}
+
+#define CONF_DIR_MAX_WORKERS 8
+
+struct conf_dir_loader {
+    struct cni_conf_dir_item *items;
+    size_t items_len;
+    /* index of next item to load, taken by workers */
+    size_t next;
+};
+
+static int cmp_conf_dir_item(const void *a, const void *b)
+{
+    return strcmp(((const struct cni_conf_dir_item *)a)->file, ((const struct cni_conf_dir_item *)b)->file);
+}
+
+static void *load_conf_dir_worker(void *arg)
+{
+    struct conf_dir_loader *loader = (struct conf_dir_loader *)arg;
+    struct cni_conf_dir_item *item = NULL;
+    size_t i = 0;
+
+    for (;;) {
+        i = __atomic_fetch_add(&loader->next, 1, __ATOMIC_RELAXED);
+        if (i >= loader->items_len) {
+            break;
+        }
+        item = &loader->items[i];
+        item->ret = cni_conflist_from_file(item->file, &item->list, &item->err);
+    }
+    return NULL;
+}
+
+static size_t conf_dir_workers(size_t max_workers, size_t items_len)
+{
+    long cpus = 0;
+    size_t workers = max_workers;
+
+    if (workers == 0) {
+        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cpus > 0 ? (size_t)cpus : 1;
+        if (workers > CONF_DIR_MAX_WORKERS) {
+            workers = CONF_DIR_MAX_WORKERS;
+        }
+    }
+    return workers < items_len ? workers : items_len;
+}
+
+/* files are loaded by caller and workers, a worker failed to start only leaves more to others */
+static void run_conf_dir_loader(struct conf_dir_loader *loader, size_t workers)
+{
+    pthread_t *tids = NULL;
+    size_t started = 0;
+    size_t i = 0;
+    int ret = 0;
+
+    if (workers > 1) {
+        tids = clibcni_util_smart_calloc_s(workers - 1, sizeof(pthread_t));
+    }
+    for (i = 0; tids != NULL && i < workers - 1; i++) {
+        ret = pthread_create(&tids[i], NULL, load_conf_dir_worker, loader);
+        if (ret != 0) {
+            WARN("Start config loader failed: %s", strerror(ret));
+            break;
+        }
+        started++;
+    }
+    (void)load_conf_dir_worker(loader);
+    for (i = 0; i < started; i++) {
+        (void)pthread_join(tids[i], NULL);
+    }
+    free(tids);
+}
+
+int cni_load_conf_dir(const char *dir, const char **extensions, size_t ext_len, size_t max_workers,
+                      struct cni_conf_dir_item **items, size_t *items_len, char **err)
+{
+    struct conf_dir_loader loader = { 0 };
+    char **files = NULL;
+    size_t len = 0;
+    size_t i = 0;
+    int ret = 0;
+
+    if (items == NULL || items_len == NULL || err == NULL) {
+        ERROR("Empty arguments");
+        return -1;
+    }
+    *items = NULL;
+    *items_len = 0;
+
+    ret = conf_files(dir, extensions, ext_len, &files, err);
+    if (ret != 0) {
+        ERROR("List config files of %s failed: %s", dir, *err != NULL ? *err : "");
+        return ret;
+    }
+    len = clibcni_util_array_len((const char * const *)files);
+    if (len == 0) {
+        free(files);
+        return 0;
+    }
+
+    loader.items = clibcni_util_smart_calloc_s(len, sizeof(struct cni_conf_dir_item));
+    if (loader.items == NULL) {
+        *err = clibcni_util_strdup_s("Out of memory");
+        ERROR("Out of memory");
+        clibcni_util_free_array(files);
+        return -1;
+    }
+    for (i = 0; i < len; i++) {
+        loader.items[i].file = files[i];
+    }
+    free(files);
+    loader.items_len = len;
+    /* same order as sorted sequential loading */
+    qsort(loader.items, len, sizeof(struct cni_conf_dir_item), cmp_conf_dir_item);
+
+    run_conf_dir_loader(&loader, conf_dir_workers(max_workers, len));
+
+    *items = loader.items;
+    *items_len = len;
+    return 0;
+}
+
+void free_cni_conf_dir_items(struct cni_conf_dir_item *items, size_t items_len)
+{
+    size_t i = 0;
+
+    if (items == NULL) {
+        return;
+    }
+    for (i = 0; i < items_len; i++) {
+        free(items[i].file);
+        free_cni_network_list_conf(items[i].list);
+        free(items[i].err);
+    }
+    free(items);
+}
@@ -41,12 +41,36 @@ struct runtime_conf {
     size_t p_mapping_len;
 };
 
+/*
+ * options of add/del, passed by *_with_opts beside runtime_conf, whose layout is kept for old callers;
+ * size is sizeof(struct cni_exec_opts) of caller, members appended later take defaults beyond it
+ * */
+struct cni_exec_opts {
+    size_t size;
+
+    /* timeout of whole plugin chain in milliseconds, <= 0 means no timeout */
+    int64_t timeout_ms;
+};
+
+/* returned by add/del functions when timeout of cni_exec_opts is reached */
+#define CNI_ERR_TIMEOUT (-5)
+
 struct cni_network_conf {
     char *name;
     char *type;
     char *bytes;
 };
 
+/* how to start plugin processes */
+enum cni_exec_backend {
+    /* posix_spawn (clone with CLONE_VM | CLONE_VFORK), default */
+    CNI_EXEC_BACKEND_SPAWN = 0,
+    /* fork + exec */
+    CNI_EXEC_BACKEND_FORK,
+    /* small helper process forked by cni_exec_helper_init, plugins are started by it */
+    CNI_EXEC_BACKEND_HELPER,
+};
+
 struct cni_network_list_conf {
     size_t plugin_len;
     char *first_plugin_name;
@@ -66,12 +90,59 @@ int cni_del_network_list(const char *net_list_conf_str, const struct runtime_con
 
 int cni_del_network(const char *cni_net_conf_str, const struct runtime_conf *rc, char **paths, char **err);
 
+/* same as the calls above, opts may be NULL for defaults */
+int cni_add_network_list_with_opts(const char *net_list_conf_str, const struct runtime_conf *rc,
+                                   const struct cni_exec_opts *opts, char **paths, struct result **pret, char **err);
+
+int cni_add_network_with_opts(const char *cni_net_conf_str, const struct runtime_conf *rc,
+                              const struct cni_exec_opts *opts, char **paths, struct result **add_result, char **err);
+
+int cni_del_network_list_with_opts(const char *net_list_conf_str, const struct runtime_conf *rc,
+                                   const struct cni_exec_opts *opts, char **paths, char **err);
+
+int cni_del_network_with_opts(const char *cni_net_conf_str, const struct runtime_conf *rc,
+                              const struct cni_exec_opts *opts, char **paths, char **err);
+
+/*
+ * parsed network list with its plugins searched in paths, reused by many add/del
+ * without parsing json again; one handle can be used by many threads at the same time
+ * */
+struct cni_network_list_handle;
+
+int cni_network_list_handle_from_bytes(const char *net_list_conf_str, char **paths,
+                                       struct cni_network_list_handle **handle, char **err);
+
+int cni_network_list_handle_from_file(const char *filename, char **paths, struct cni_network_list_handle **handle,
+                                      char **err);
+
+int cni_add_network_list_by_handle(struct cni_network_list_handle *handle, const struct runtime_conf *rc,
+                                   const struct cni_exec_opts *opts, struct result **pret, char **err);
+
+int cni_del_network_list_by_handle(struct cni_network_list_handle *handle, const struct runtime_conf *rc,
+                                   const struct cni_exec_opts *opts, char **err);
+
+void cni_network_list_handle_free(struct cni_network_list_handle *handle);
+
 int cni_get_version_info(const char *plugin_type, char **paths, struct plugin_info **pinfo, char **err);
 
 int cni_conf_files(const char *dir, const char **extensions, size_t ext_len, char ***result, char **err);
 
+/* fails when more than max_files files are found, 0 means no limit as cni_conf_files */
+int cni_conf_files_with_limit(const char *dir, const char **extensions, size_t ext_len, size_t max_files,
+                              char ***result, char **err);
+
 int cni_conf_from_file(const char *filename, struct cni_network_conf **config, char **err);
 
+/*
+ * config named name in dir, same as reading .conf and .json files of dir in order;
+ * files are parsed once and dir is refreshed after inotify events, or revalidated
+ * by stat of files when inotify is not available
+ * */
+int cni_conf_from_dir(const char *dir, const char *name, struct cni_network_conf **config, char **err);
+
+/* drop indexes of config dirs, e.g. after changing files on a fs without inotify support */
+void cni_flush_conf_dir_cache(void);
+
 int cni_conflist_from_bytes(const char *bytes, struct cni_network_list_conf **list, char **err);
 
 int cni_conflist_from_file(const char *filename, struct cni_network_list_conf **list, char **err);
@@ -94,6 +165,111 @@ void cni_set_log_prefix(const char *prefix);
 
 void cni_free_log_prefix();
 
+/*
+ * fork the exec helper, it is needed by CNI_EXEC_BACKEND_HELPER;
+ * call it early, while the process is still small and before it starts any thread.
+ * A helper killed later is forked again by the next plugin call.
+ * */
+int cni_exec_helper_init(void);
+
+int cni_set_exec_backend(enum cni_exec_backend backend);
+
+/* max bytes of plugin stdout accepted, 0 restores the default (4MB) */
+void cni_set_plugin_output_limit(size_t limit);
+
+/*
+ * plugins found in paths are cached, and dropped when their dirs change;
+ * flush it after changing plugins in a way not seen by inotify, e.g. on a remote fs
+ * */
+void cni_flush_plugin_path_cache(void);
+
+/*
+ * environs of process, without proxy settings, are copied once and passed to all plugins;
+ * call it after changing environs of process to pass the new ones
+ * */
+void cni_refresh_plugin_env(void);
+
+/*
+ * asynchronous add/del of network list, one thread can drive many of them:
+ * wait for fd of cni_op_get_fd to be readable, then call cni_op_process,
+ * until it returns 1 or the callback is called; then take output by cni_op_result.
+ * */
+struct cni_op;
+
+/*
+ * called once by cni_op_process when operation finished, never inside *_async, so *op is
+ * always set first; operation is still owned by caller, and the callback may cni_op_free it
+ * */
+typedef void (*cni_op_callback)(struct cni_op *op, void *data);
+
+int cni_add_network_list_async(const char *net_list_conf_str, const struct runtime_conf *rc,
+                               const struct cni_exec_opts *opts, char **paths, cni_op_callback cb, void *cb_data,
+                               struct cni_op **op, char **err);
+
+int cni_del_network_list_async(const char *net_list_conf_str, const struct runtime_conf *rc,
+                               const struct cni_exec_opts *opts, char **paths, cni_op_callback cb, void *cb_data,
+                               struct cni_op **op, char **err);
+
+int cni_op_get_fd(const struct cni_op *op);
+
+/*
+ * never waits for plugins, exit of them is watched by pidfd, or by a timer in fd of operation
+ * on kernels without pidfd; return 1 when operation finished, 0 when it is still running
+ * */
+int cni_op_process(struct cni_op *op);
+
+/* block until operation finished, timeout_ms < 0 means wait forever */
+int cni_op_wait(struct cni_op *op, int timeout_ms);
+
+/* return code of finished operation, result is only set by add */
+int cni_op_result(struct cni_op *op, struct result **pret, char **err);
+
+/* running plugin is killed, then reaped, which only waits for the killed process to go */
+void cni_op_free(struct cni_op *op);
+
+/* one container of batch, ret, result and err are outputs, result is only set by add */
+struct cni_batch_item {
+    const struct runtime_conf *rc;
+    /* may be NULL for defaults */
+    const struct cni_exec_opts *opts;
+
+    int ret;
+    struct result *result;
+    char *err;
+};
+
+/*
+ * add/del one network list for many containers, the list is parsed and its plugins are
+ * searched once for the whole batch; at most max_parallel chains run at the same time,
+ * 0 means no limit. timeout_ms in opts of each item counts from start of its own chain.
+ * Return 0 only if all items succeed, outputs of each item must be freed by caller.
+ * */
+int cni_add_network_list_batch(const char *net_list_conf_str, char **paths, struct cni_batch_item *items,
+                               size_t items_len, size_t max_parallel, char **err);
+
+int cni_del_network_list_batch(const char *net_list_conf_str, char **paths, struct cni_batch_item *items,
+                               size_t items_len, size_t max_parallel, char **err);
+
+/* one config file of dir, ret and err are the output of cni_conflist_from_file for it */
+struct cni_conf_dir_item {
+    char *file;
+
+    int ret;
+    struct cni_network_list_conf *list;
+    char *err;
+};
+
+/*
+ * load all files with extensions in dir as conflists on at most max_workers threads,
+ * 0 means a small pool sized by cpus. items are sorted by file path and hold the same
+ * as calling cni_conflist_from_file for each file in order; a file failed to load does
+ * not fail the call, only listing dir does. Free items with free_cni_conf_dir_items.
+ * */
+int cni_load_conf_dir(const char *dir, const char **extensions, size_t ext_len, size_t max_workers,
+                      struct cni_conf_dir_item **items, size_t *items_len, char **err);
+
+void free_cni_conf_dir_items(struct cni_conf_dir_item *items, size_t items_len);
+
 #ifdef __cplusplus
 }
 #endif
@@ -27,6 +27,9 @@
 #include <stdint.h>
 #include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/inotify.h>
 
 #include "utils.h"
 #include "isula_libutils/log.h"
@@ -34,14 +37,15 @@
 #include "isula_libutils/cni_net_conf_list.h"
 #include "api.h"
 
-static int do_conf_from_bytes(const char *conf_str, struct network_config *config, char **err)
+/* content is owned by config on success */
+static int do_conf_from_bytes(char *content, struct network_config *config, char **err)
 {
     int ret = 0;
     int nret = 0;
     parser_error jerr = NULL;
     struct parser_context ctx = { OPT_PARSE_FULLKEY | OPT_GEN_SIMPLIFY, 0 };
 
-    config->network = cni_net_conf_parse_data(conf_str, &ctx, &jerr);
+    config->network = cni_net_conf_parse_data(content, &ctx, &jerr);
     if (config->network == NULL) {
         nret = asprintf(err, "Error parsing configuration: %s", jerr);
         if (nret < 0) {
@@ -61,7 +65,7 @@ static int do_conf_from_bytes(const char *conf_str, struct network_config *confi
         goto out;
     }
 
-    config->bytes = clibcni_util_strdup_s(conf_str);
+    config->bytes = content;
 out:
     free(jerr);
     return ret;
@@ -72,19 +76,11 @@ static inline bool check_conf_from_bytes_args(struct network_config * const *con
     return (config == NULL || err == NULL);
 }
 
-int conf_from_bytes(const char *conf_str, struct network_config **config, char **err)
+/* always takes content, it becomes the bytes of config on success */
+static int conf_from_content(char *content, struct network_config **config, char **err)
 {
     int ret = -1;
 
-    if (check_conf_from_bytes_args(config, err)) {
-        ERROR("Invalid arguments");
-        return ret;
-    }
-    if (conf_str == NULL) {
-        *err = clibcni_util_strdup_s("Empty json");
-        ERROR("Empty json");
-        return ret;
-    }
     *config = clibcni_util_common_calloc_s(sizeof(struct network_config));
     if (*config == NULL) {
         *err = clibcni_util_strdup_s("Out of memory");
@@ -92,15 +88,31 @@ int conf_from_bytes(const char *conf_str, struct network_config **config, char *
         goto free_out;
     }
 
-    ret = do_conf_from_bytes(conf_str, *config, err);
+    ret = do_conf_from_bytes(content, *config, err);
 free_out:
     if (ret != 0) {
+        free(content);
         free_network_config(*config);
         *config = NULL;
     }
     return ret;
 }
 
+int conf_from_bytes(const char *conf_str, struct network_config **config, char **err)
+{
+    if (check_conf_from_bytes_args(config, err)) {
+        ERROR("Invalid arguments");
+        return -1;
+    }
+    if (conf_str == NULL) {
+        *err = clibcni_util_strdup_s("Empty json");
+        ERROR("Empty json");
+        return -1;
+    }
+
+    return conf_from_content(clibcni_util_strdup_s(conf_str), config, err);
+}
+
 static char *do_get_cni_net_confs_json(const char *filename, char **err)
 {
     char *content = NULL;
@@ -125,7 +137,6 @@ static inline bool check_conf_from_file_args(const char *filename, struct networ
 int conf_from_file(const char *filename, struct network_config **config, char **err)
 {
     char *content = NULL;
-    int ret = -1;
 
     if (check_conf_from_file_args(filename, config, err)) {
         ERROR("Invalid arguments");
@@ -134,14 +145,10 @@ int conf_from_file(const char *filename, struct network_config **config, char **
     content = do_get_cni_net_confs_json(filename, err);
     if (content == NULL) {
         ERROR("Parse net conf file: %s failed: %s", filename, *err != NULL ? *err : "");
-        ret = -1;
-        goto free_out;
+        return -1;
     }
 
-    ret = conf_from_bytes(content, config, err);
-free_out:
-    free(content);
-    return ret;
+    return conf_from_content(content, config, err);
 }
 
 static int do_check_cni_net_conf_list_plugins(const cni_net_conf_list *tmp_list, char **err)
@@ -194,29 +201,21 @@ static inline bool check_conflist_from_bytes_args(struct network_config_list * c
     return (list == NULL || err == NULL);
 }
 
-int conflist_from_bytes(const char *json_str, struct network_config_list **list, char **err)
+/* always takes content, it becomes the bytes of list on success */
+static int conflist_from_content(char *content, struct network_config_list **list, char **err)
 {
     int ret = -1;
     parser_error jerr = NULL;
     cni_net_conf_list *tmp_list = NULL;
     struct parser_context ctx = { OPT_PARSE_FULLKEY | OPT_GEN_SIMPLIFY, 0 };
 
-    if (check_conflist_from_bytes_args(list, err)) {
-        ERROR("Invalid arguments");
-        return ret;
-    }
-    if (json_str == NULL) {
-        *err = clibcni_util_strdup_s("Empty json");
-        ERROR("Empty json");
-        return -1;
-    }
     *list = clibcni_util_common_calloc_s(sizeof(struct network_config_list));
     if (*list == NULL) {
         *err = clibcni_util_strdup_s("Out of memory");
         ERROR("Out of memory");
         goto free_out;
     }
-    tmp_list = cni_net_conf_list_parse_data(json_str, &ctx, &jerr);
+    tmp_list = cni_net_conf_list_parse_data(content, &ctx, &jerr);
     if (tmp_list == NULL) {
         ret = asprintf(err, "Error parsing configuration list: %s", jerr);
         if (ret < 0) {
@@ -232,13 +231,14 @@ int conflist_from_bytes(const char *json_str, struct network_config_list **list,
         goto free_out;
     }
 
-    (*list)->bytes = clibcni_util_strdup_s(json_str);
+    (*list)->bytes = content;
     (*list)->list = tmp_list;
 
     ret = 0;
 free_out:
     free(jerr);
     if (ret != 0) {
+        free(content);
         free_cni_net_conf_list(tmp_list);
         free_network_config_list(*list);
         *list = NULL;
@@ -246,6 +246,21 @@ free_out:
     return ret;
 }
 
+int conflist_from_bytes(const char *json_str, struct network_config_list **list, char **err)
+{
+    if (check_conflist_from_bytes_args(list, err)) {
+        ERROR("Invalid arguments");
+        return -1;
+    }
+    if (json_str == NULL) {
+        *err = clibcni_util_strdup_s("Empty json");
+        ERROR("Empty json");
+        return -1;
+    }
+
+    return conflist_from_content(clibcni_util_strdup_s(json_str), list, err);
+}
+
 static inline bool check_conflist_from_file_args(const char *filename, struct network_config_list * const *list,
                                                  char * const *err)
 {
@@ -255,7 +270,6 @@ static inline bool check_conflist_from_file_args(const char *filename, struct ne
 int conflist_from_file(const char *filename, struct network_config_list **list, char **err)
 {
     char *content = NULL;
-    int ret = -1;
 
     if (check_conflist_from_file_args(filename, list, err)) {
         ERROR("Invalid arguments");
@@ -264,14 +278,10 @@ int conflist_from_file(const char *filename, struct network_config_list **list,
     content = do_get_cni_net_confs_json(filename, err);
     if (content == NULL) {
         ERROR("Parse net conf file: %s failed: %s", filename, *err != NULL ? *err : "");
-        ret = -1;
-        goto free_out;
+        return -1;
     }
 
-    ret = conflist_from_bytes(content, list, err);
-free_out:
-    free(content);
-    return ret;
+    return conflist_from_content(content, list, err);
 }
 
 static int get_ext(const char *fname)
@@ -298,8 +308,16 @@ static int get_ext(const char *fname)
 
 static int check_conf_dir(const char *dir, DIR **directory, char **err)
 {
-    *directory = opendir(dir);
-    if (*directory == NULL) {
+    int fd = -1;
+
+    fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        *directory = fdopendir(fd);
+        if (*directory == NULL) {
+            (void)close(fd);
+        }
+    }
+    if (fd < 0 || *directory == NULL) {
         if (errno == ENOENT) {
             return 0;
         }
@@ -312,52 +330,92 @@ static int check_conf_dir(const char *dir, DIR **directory, char **err)
     return 1;
 }
 
-static int do_check_file_is_valid(const char *fname, int *result, char **err)
+static bool match_conf_ext(const char *fname, const char * const *extensions, size_t ext_len)
+{
+    const char *ext_name = NULL;
+    size_t i = 0;
+    int nret = -1;
+
+    nret = get_ext(fname);
+    if (nret < 0) {
+        return false;
+    }
+    ext_name = fname + nret;
+    for (i = 0; i < ext_len; i++) {
+        if (extensions[i] != NULL && strcmp(ext_name, extensions[i]) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * same checks as lstat of the file, d_type saves the stat when it tells enough:
+ * dirs are ignored, symlinks are always small
+ * */
+static int do_check_file_is_valid(int dfd, const char *dir, const struct dirent *pdirent, bool *valid, char **err)
 {
     struct stat tmp_fstat;
     int nret = -1;
 
-    nret = lstat(fname, &tmp_fstat);
+    *valid = false;
+    if (pdirent->d_type == DT_DIR) {
+        WARN("conf file %s/%s is dir", dir, pdirent->d_name);
+        return 0;
+    }
+    if (pdirent->d_type == DT_LNK) {
+        *valid = true;
+        return 0;
+    }
+
+    nret = fstatat(dfd, pdirent->d_name, &tmp_fstat, AT_SYMLINK_NOFOLLOW);
     if (nret != 0) {
-        nret = asprintf(err, "lstat %s failed: %s", fname, strerror(errno));
+        nret = asprintf(err, "lstat %s/%s failed: %s", dir, pdirent->d_name, strerror(errno));
         if (nret < 0) {
             *err = clibcni_util_strdup_s("Out of memory");
         }
-        SYSERROR("lstat %s failed", fname);
-        *result = -1;
+        SYSERROR("lstat %s/%s failed", dir, pdirent->d_name);
         return -1;
     }
 
     if (S_ISDIR(tmp_fstat.st_mode)) {
         // ignore dir
-        *result = 0;
-        WARN("conf file %s is dir", fname);
-        return -1;
+        WARN("conf file %s/%s is dir", dir, pdirent->d_name);
+        return 0;
     }
 
     if (tmp_fstat.st_size > MB) {
-        nret = asprintf(err, "Too large config file: %s", fname);
+        nret = asprintf(err, "Too large config file: %s/%s", dir, pdirent->d_name);
         if (nret < 0) {
             *err = clibcni_util_strdup_s("Out of memory");
         }
-        ERROR("Too large config file: %s", fname);
-        *result = -1;
+        ERROR("Too large config file: %s/%s", dir, pdirent->d_name);
         return -1;
     }
 
+    *valid = true;
     return 0;
 }
 
-static int check_conf_file(const char *dir, const char * const *extensions, size_t ext_len,
-                           const struct dirent *pdirent,
-                           size_t *result_size, char ***result, char **err)
+static int check_conf_file(int dfd, const char *dir, const char * const *extensions, size_t ext_len,
+                           const struct dirent *pdirent, size_t *result_size, size_t *cap, char ***result,
+                           char **err)
 {
     char fname[PATH_MAX] = { 0 };
-    size_t i = 0;
-    const char *ext_name = NULL;
+    bool valid = false;
     int nret = -1;
-    int ret = 0;
-    size_t cap = *result_size;
+
+    /* extension is compared first, other files are never stat'ed */
+    if (!match_conf_ext(pdirent->d_name, extensions, ext_len)) {
+        return 0;
+    }
+
+    if (do_check_file_is_valid(dfd, dir, pdirent, &valid, err) != 0) {
+        return -1;
+    }
+    if (!valid) {
+        return 0;
+    }
 
     nret = snprintf(fname, PATH_MAX, "%s/%s", dir, pdirent->d_name);
     if (nret < 0 || nret >= PATH_MAX) {
@@ -366,29 +424,13 @@ static int check_conf_file(const char *dir, const char * const *extensions, size
         return -1;
     }
 
-    nret = do_check_file_is_valid(fname, &ret, err);
-    if (nret != 0) {
-        return ret;
-    }
-
-    /* compare extension */
-    nret = get_ext(pdirent->d_name);
-    if (nret < 0) {
-        // ignore this error
-        return 0;
-    }
-    ext_name = (pdirent->d_name) + nret;
-    for (i = 0; i < ext_len; i++) {
-        if (extensions[i] != NULL && strcmp(ext_name, extensions[i]) == 0) {
-            if (clibcni_util_grow_array(result, &cap, (*result_size) + 1, 2) != 0) {
-                *err = clibcni_util_strdup_s("Out of memory");
-                ERROR("Out of memory");
-                return -1;
-            }
-            (*result)[(*result_size)++] = clibcni_util_strdup_s(fname);
-            break;
-        }
+    /* grow geometrically, large dirs are not copied again for every few files */
+    if (clibcni_util_grow_array(result, cap, (*result_size) + 1, *cap > 0 ? *cap : 16) != 0) {
+        *err = clibcni_util_strdup_s("Out of memory");
+        ERROR("Out of memory");
+        return -1;
     }
+    (*result)[(*result_size)++] = clibcni_util_strdup_s(fname);
 
     return 0;
 }
@@ -399,14 +441,15 @@ static inline bool check_conf_files_args(const char *dir, const char * const *ex
     return (dir == NULL || extensions == NULL || result == NULL || err == NULL);
 }
 
-int conf_files(const char *dir, const char * const *extensions, size_t ext_len, char ***result, char **err)
+int conf_files_with_limit(const char *dir, const char * const *extensions, size_t ext_len, size_t max_files,
+                          char ***result, char **err)
 {
-#define MAX_FILES 200
     int ret = -1;
     int nret = -1;
     DIR *directory = NULL;
     struct dirent *pdirent = NULL;
     size_t size = 0;
+    size_t cap = 0;
 
     if (check_conf_files_args(dir, extensions, result, err)) {
         ERROR("Invalid arguments");
@@ -418,29 +461,26 @@ int conf_files(const char *dir, const char * const *extensions, size_t ext_len,
         return nret;
     }
 
-    pdirent = readdir(directory);
-    while (pdirent != NULL) {
+    /* readdir reads entries by getdents64 in large batches */
+    for (pdirent = readdir(directory); pdirent != NULL; pdirent = readdir(directory)) {
         if (strcmp(pdirent->d_name, ".") == 0 || strcmp(pdirent->d_name, "..") == 0) {
-            pdirent = readdir(directory);
             continue;
         }
 
-        nret = check_conf_file(dir, extensions, ext_len, pdirent, &size, result, err);
+        nret = check_conf_file(dirfd(directory), dir, extensions, ext_len, pdirent, &size, &cap, result, err);
         if (nret < 0) {
             goto free_out;
         }
 
-        pdirent = readdir(directory);
-    }
-
-    if (size > MAX_FILES) {
-        nret = asprintf(err, "Too more config files, current support max count of config file is %d.", MAX_FILES);
-        if (nret < 0) {
-            *err = clibcni_util_strdup_s("Out of memory");
+        if (max_files > 0 && size > max_files) {
+            nret = asprintf(err, "Too more config files, current support max count of config file is %zu.",
+                            max_files);
+            if (nret < 0) {
+                *err = clibcni_util_strdup_s("Out of memory");
+            }
+            ERROR("Too more config files, current support max count of config file is %zu.", max_files);
+            goto free_out;
         }
-        ERROR("Too more config files, current support max count of config file is %d.", MAX_FILES);
-        ret = -1;
-        goto free_out;
     }
 
     ret = 0;
@@ -460,70 +500,481 @@ free_out:
     return ret;
 }
 
+int conf_files(const char *dir, const char * const *extensions, size_t ext_len, char ***result, char **err)
+{
+    return conf_files_with_limit(dir, extensions, ext_len, 0, result, err);
+}
+
 int cmpstr(const void *a, const void *b)
 {
     return strcmp(*((const char **)a), *((const char **)b));
 }
 
-static inline bool check_load_conf_args(const char *dir, const char *name, struct network_config * const *conf,
-                                        char * const *err)
+#define CONF_DIR_BUCKETS 64
+#define CONF_DIR_MAX_CACHED 16
+#define CONF_DIR_WATCH_EVENTS                                                                                   \
+    (IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | \
+     IN_DELETE_SELF | IN_MOVE_SELF)
+
+/* one config file of dir, what load_conf needs from it without parsing again */
+struct conf_dir_entry {
+    char *path;
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;
+    off_t size;
+    /* file changed by inotify event, reload it even if stat looks the same */
+    bool stale;
+
+    /* NULL name, type and bytes with err set if file cannot be loaded */
+    char *name;
+    char *type;
+    char *bytes;
+    char *err;
+
+    /* index + 1 of next entry in same bucket, in file order */
+    size_t bucket_next;
+};
+
+/*
+ * config files of a dir sorted like load_conf reads them, indexed by network name;
+ * with inotify watch of dir it is refreshed only after events, else every lookup
+ * revalidates files by stat, only new or changed files are parsed
+ * */
+struct conf_dir_index {
+    struct conf_dir_index *next;
+    char *dir;
+    int wd;
+    bool dirty;
+
+    int list_ret;
+    char *list_err;
+
+    struct conf_dir_entry *entries;
+    size_t len;
+    /* first entry failed to load, len if none */
+    size_t first_err;
+    size_t buckets[CONF_DIR_BUCKETS];
+};
+
+static struct {
+    pthread_mutex_t lock;
+    bool inited;
+    int inotify_fd;
+    size_t count;
+    struct conf_dir_index *dirs;
+} g_conf_dir_cache = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .inotify_fd = -1,
+};
+
+static unsigned int conf_name_hash(const char *name)
+{
+    unsigned int hash = 2166136261U;
+
+    for (; *name != '\0'; name++) {
+        hash = (hash ^ (unsigned char)(*name)) * 16777619U;
+    }
+    return hash % CONF_DIR_BUCKETS;
+}
 
+static void free_conf_dir_entry(struct conf_dir_entry *entry)
 {
-    return (dir == NULL || name == NULL || conf == NULL || err == NULL);
+    free(entry->path);
+    free(entry->name);
+    free(entry->type);
+    free(entry->bytes);
+    free(entry->err);
+    (void)memset(entry, 0, sizeof(*entry));
 }
 
-int load_conf(const char *dir, const char *name, struct network_config **conf, char **err)
+static void free_conf_dir_entries(struct conf_dir_entry *entries, size_t len)
+{
+    size_t i = 0;
+
+    for (i = 0; i < len; i++) {
+        free_conf_dir_entry(&entries[i]);
+    }
+    free(entries);
+}
+
+static void free_conf_dir_index(struct conf_dir_index *idx)
+{
+    if (idx == NULL) {
+        return;
+    }
+    if (idx->wd >= 0 && g_conf_dir_cache.inotify_fd >= 0) {
+        (void)inotify_rm_watch(g_conf_dir_cache.inotify_fd, idx->wd);
+    }
+    free_conf_dir_entries(idx->entries, idx->len);
+    free(idx->list_err);
+    free(idx->dir);
+    free(idx);
+}
+
+static bool conf_dir_cache_init(void)
+{
+    if (!g_conf_dir_cache.inited) {
+        g_conf_dir_cache.inited = true;
+        g_conf_dir_cache.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (g_conf_dir_cache.inotify_fd < 0) {
+            WARN("Init inotify failed: %s, config dirs will be revalidated by stat", strerror(errno));
+        }
+    }
+    return g_conf_dir_cache.inotify_fd >= 0;
+}
+
+static void conf_dir_mark_stale(struct conf_dir_index *idx, const char *fname)
+{
+    size_t i = 0;
+    const char *base = NULL;
+
+    for (i = 0; i < idx->len; i++) {
+        base = strrchr(idx->entries[i].path, '/');
+        base = base != NULL ? base + 1 : idx->entries[i].path;
+        if (fname == NULL || strcmp(base, fname) == 0) {
+            idx->entries[i].stale = true;
+        }
+    }
+}
+
+static void conf_dir_handle_event(const struct inotify_event *ev)
+{
+    struct conf_dir_index *idx = NULL;
+
+    for (idx = g_conf_dir_cache.dirs; idx != NULL; idx = idx->next) {
+        /* lost events, nothing can be trusted */
+        if ((ev->mask & IN_Q_OVERFLOW) != 0) {
+            idx->dirty = true;
+            conf_dir_mark_stale(idx, NULL);
+            continue;
+        }
+        if (idx->wd != ev->wd) {
+            continue;
+        }
+        idx->dirty = true;
+        if ((ev->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) != 0) {
+            /* watch is gone, it is added again by next refresh */
+            idx->wd = -1;
+        } else if (ev->len > 0) {
+            conf_dir_mark_stale(idx, ev->name);
+        }
+    }
+}
+
+static void conf_dir_cache_drain(void)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *ev = NULL;
+    ssize_t len = 0;
+    ssize_t off = 0;
+
+    if (g_conf_dir_cache.inotify_fd < 0) {
+        return;
+    }
+    for (;;) {
+        len = read(g_conf_dir_cache.inotify_fd, buf, sizeof(buf));
+        if (len < 0 && errno == EINTR) {
+            continue;
+        }
+        if (len <= 0) {
+            break;
+        }
+        for (off = 0; off < len; off += (ssize_t)(sizeof(struct inotify_event) + ev->len)) {
+            ev = (const struct inotify_event *)(buf + off);
+            conf_dir_handle_event(ev);
+        }
+    }
+}
+
+static bool same_conf_file(const struct conf_dir_entry *entry, const struct stat *st)
+{
+    return !entry->stale && entry->dev == st->st_dev && entry->ino == st->st_ino &&
+           entry->mtime.tv_sec == st->st_mtim.tv_sec && entry->mtime.tv_nsec == st->st_mtim.tv_nsec &&
+           entry->size == st->st_size;
+}
+
+/* same as load_conf does for every file, but keep the outcome */
+static void load_conf_dir_entry(struct conf_dir_entry *entry)
+{
+    struct network_config *conf = NULL;
+    char *err = NULL;
+
+    if (conf_from_file(entry->path, &conf, &err) != 0) {
+        entry->err = err != NULL ? err : clibcni_util_strdup_s("Load config file failed");
+        return;
+    }
+    if (conf->network != NULL) {
+        entry->name = conf->network->name != NULL ? clibcni_util_strdup_s(conf->network->name) : NULL;
+        entry->type = conf->network->type != NULL ? clibcni_util_strdup_s(conf->network->type) : NULL;
+    }
+    entry->bytes = conf->bytes;
+    conf->bytes = NULL;
+    free_network_config(conf);
+}
+
+/* both old entries and files are sorted by path */
+static void fill_conf_dir_entry(struct conf_dir_entry *old, size_t old_len, size_t *old_pos, char *path,
+                                struct conf_dir_entry *entry)
+{
+    struct stat st;
+    bool have_stat = false;
+    struct conf_dir_entry *match = NULL;
+
+    while (*old_pos < old_len && strcmp(old[*old_pos].path, path) < 0) {
+        (*old_pos)++;
+    }
+    if (*old_pos < old_len && strcmp(old[*old_pos].path, path) == 0) {
+        match = &old[*old_pos];
+    }
+
+    /* stat before reading, a change after it is seen by next revalidation */
+    have_stat = (stat(path, &st) == 0);
+    if (match != NULL && have_stat && same_conf_file(match, &st)) {
+        *entry = *match;
+        entry->path = path;
+        free(match->path);
+        (void)memset(match, 0, sizeof(*match));
+        (*old_pos)++;
+        return;
+    }
+
+    (void)memset(entry, 0, sizeof(*entry));
+    entry->path = path;
+    if (have_stat) {
+        entry->dev = st.st_dev;
+        entry->ino = st.st_ino;
+        entry->mtime = st.st_mtim;
+        entry->size = st.st_size;
+    } else {
+        /* never matches, so it is loaded again next time */
+        entry->stale = true;
+    }
+    load_conf_dir_entry(entry);
+}
+
+static void build_conf_dir_buckets(struct conf_dir_index *idx)
+{
+    size_t i = 0;
+    size_t *tail[CONF_DIR_BUCKETS];
+    unsigned int b = 0;
+
+    idx->first_err = idx->len;
+    for (b = 0; b < CONF_DIR_BUCKETS; b++) {
+        idx->buckets[b] = 0;
+        tail[b] = &idx->buckets[b];
+    }
+    for (i = 0; i < idx->len; i++) {
+        idx->entries[i].bucket_next = 0;
+        if (idx->entries[i].err != NULL && idx->first_err == idx->len) {
+            idx->first_err = i;
+        }
+        if (idx->entries[i].name == NULL) {
+            continue;
+        }
+        b = conf_name_hash(idx->entries[i].name);
+        *tail[b] = i + 1;
+        tail[b] = &idx->entries[i].bucket_next;
+    }
+}
+
+static void refresh_conf_dir_index(struct conf_dir_index *idx)
 {
-    char **files = NULL;
     const char *exts[] = { ".conf", ".json" };
-    int ret = 0;
+    char **files = NULL;
+    struct conf_dir_entry *entries = NULL;
     size_t len = 0;
     size_t i = 0;
+    size_t old_pos = 0;
 
-    if (check_load_conf_args(dir, name, conf, err)) {
-        ERROR("Invalid arguments");
-        return -1;
+    /* watch before listing, so no change after listing is missed */
+    if (idx->wd < 0 && conf_dir_cache_init()) {
+        idx->wd = inotify_add_watch(g_conf_dir_cache.inotify_fd, idx->dir, CONF_DIR_WATCH_EVENTS);
+        if (idx->wd < 0) {
+            DEBUG("Watch config dir %s failed: %s", idx->dir, strerror(errno));
+        }
     }
-
-    ret = conf_files(dir, exts, sizeof(exts) / sizeof(char *), &files, err);
-    if (ret != 0) {
-        return -1;
+    idx->dirty = false;
+
+    free(idx->list_err);
+    idx->list_err = NULL;
+    idx->list_ret = conf_files(idx->dir, exts, sizeof(exts) / sizeof(char *), &files, &idx->list_err);
+    if (idx->list_ret != 0) {
+        /* error is reported by every lookup until dir changes */
+        return;
     }
+
     len = clibcni_util_array_len((const char * const *)files);
-    if (len == 0) {
-        if (asprintf(err, "no net configurations found in %s", dir) < 0) {
-            *err = clibcni_util_strdup_s("Out of memory");
+    if (len > 0) {
+        qsort((void *)files, len, sizeof(char *), cmpstr);
+        entries = clibcni_util_smart_calloc_s(len, sizeof(struct conf_dir_entry));
+        if (entries == NULL) {
+            idx->list_ret = -1;
+            idx->list_err = clibcni_util_strdup_s("Out of memory");
+            idx->dirty = true;
+            clibcni_util_free_array(files);
+            return;
         }
-        ERROR("no net configurations found in %s", dir);
-        goto free_out;
     }
+    for (i = 0; i < len; i++) {
+        /* path is taken over by entry */
+        fill_conf_dir_entry(idx->entries, idx->len, &old_pos, files[i], &entries[i]);
+    }
+    free(files);
 
-    qsort((void *)files, len, sizeof(char *), cmpstr);
+    free_conf_dir_entries(idx->entries, idx->len);
+    idx->entries = entries;
+    idx->len = len;
+    build_conf_dir_buckets(idx);
+}
 
-    for (i = 0; i < len; i++) {
-        ret = conf_from_file(files[i], conf, err);
-        if (ret != 0) {
-            goto free_out;
+static struct conf_dir_index *get_conf_dir_index(const char *dir, bool *cached)
+{
+    struct conf_dir_index *idx = NULL;
+
+    for (idx = g_conf_dir_cache.dirs; idx != NULL; idx = idx->next) {
+        if (strcmp(idx->dir, dir) == 0) {
+            *cached = true;
+            return idx;
         }
-        if (((*conf)->network->name) != NULL && strcmp((*conf)->network->name, name) == 0) {
-            ret = 0;
-            goto free_out;
+    }
+
+    idx = clibcni_util_common_calloc_s(sizeof(struct conf_dir_index));
+    if (idx == NULL) {
+        return NULL;
+    }
+    idx->dir = clibcni_util_strdup_s(dir);
+    idx->wd = -1;
+    idx->dirty = true;
+    /* too many dirs, use index once without caching it */
+    *cached = (g_conf_dir_cache.count < CONF_DIR_MAX_CACHED);
+    if (*cached) {
+        idx->next = g_conf_dir_cache.dirs;
+        g_conf_dir_cache.dirs = idx;
+        g_conf_dir_cache.count++;
+    }
+    return idx;
+}
+
+/* same outcome as reading sorted files one by one until the name matches */
+static const struct conf_dir_entry *lookup_conf_dir_index(const struct conf_dir_index *idx, const char *name,
+                                                          char **err)
+{
+    size_t pos = 0;
+
+    if (idx->list_ret != 0) {
+        *err = clibcni_util_strdup_s(idx->list_err != NULL ? idx->list_err : "List config dir failed");
+        return NULL;
+    }
+    if (idx->len == 0) {
+        if (asprintf(err, "no net configurations found in %s", idx->dir) < 0) {
+            *err = clibcni_util_strdup_s("Out of memory");
+        }
+        ERROR("no net configurations found in %s", idx->dir);
+        return NULL;
+    }
+
+    for (pos = idx->buckets[conf_name_hash(name)]; pos != 0; pos = idx->entries[pos - 1].bucket_next) {
+        if (strcmp(idx->entries[pos - 1].name, name) == 0) {
+            break;
         }
-        free_network_config(*conf);
-        *conf = NULL;
     }
-    ret = asprintf(err, "No net configuration with name \"%s\" in %s", name, dir);
-    if (ret < 0) {
+    /* a broken file before the match fails the lookup, as it did when parsing in order */
+    if (idx->first_err < (pos != 0 ? pos - 1 : idx->len)) {
+        *err = clibcni_util_strdup_s(idx->entries[idx->first_err].err);
+        ERROR("Parse net conf file: %s failed: %s", idx->entries[idx->first_err].path, *err);
+        return NULL;
+    }
+    if (pos == 0) {
+        if (asprintf(err, "No net configuration with name \"%s\" in %s", name, idx->dir) < 0) {
+            *err = clibcni_util_strdup_s("Out of memory");
+        }
+        ERROR("No net configuration with name \"%s\" in %s", name, idx->dir);
+        return NULL;
+    }
+    return &idx->entries[pos - 1];
+}
+
+static inline bool check_load_conf_args(const char *dir, const char *name, char * const *err)
+{
+    return (dir == NULL || name == NULL || err == NULL);
+}
+
+int load_conf_from_dir_index(const char *dir, const char *name, char **type, char **bytes, char **err)
+{
+    struct conf_dir_index *idx = NULL;
+    const struct conf_dir_entry *entry = NULL;
+    bool cached = false;
+    int ret = -1;
+
+    if (check_load_conf_args(dir, name, err)) {
+        ERROR("Invalid arguments");
+        return -1;
+    }
+
+    (void)pthread_mutex_lock(&g_conf_dir_cache.lock);
+    conf_dir_cache_drain();
+    idx = get_conf_dir_index(dir, &cached);
+    if (idx == NULL) {
         *err = clibcni_util_strdup_s("Out of memory");
+        ERROR("Out of memory");
+        goto unlock;
     }
-    ERROR("No net configuration with name \"%s\" in %s", name, dir);
-    ret = -1;
+    if (idx->dirty || idx->wd < 0) {
+        refresh_conf_dir_index(idx);
+    }
+    entry = lookup_conf_dir_index(idx, name, err);
+    if (entry == NULL) {
+        goto unlock;
+    }
+    if (type != NULL) {
+        *type = clibcni_util_strdup_s(entry->type);
+    }
+    *bytes = clibcni_util_strdup_s(entry->bytes);
+    ret = 0;
 
-free_out:
-    clibcni_util_free_array(files);
+unlock:
+    if (!cached) {
+        free_conf_dir_index(idx);
+    }
+    (void)pthread_mutex_unlock(&g_conf_dir_cache.lock);
+    return ret;
+}
+
+int load_conf(const char *dir, const char *name, struct network_config **conf, char **err)
+{
+    char *bytes = NULL;
+    int ret = 0;
+
+    if (conf == NULL) {
+        ERROR("Invalid arguments");
+        return -1;
+    }
+
+    ret = load_conf_from_dir_index(dir, name, NULL, &bytes, err);
+    if (ret != 0) {
+        return ret;
+    }
+    ret = conf_from_bytes(bytes, conf, err);
+    free(bytes);
     return ret;
 }
 
+void flush_conf_dir_cache(void)
+{
+    struct conf_dir_index *idx = NULL;
+
+    (void)pthread_mutex_lock(&g_conf_dir_cache.lock);
+    while (g_conf_dir_cache.dirs != NULL) {
+        idx = g_conf_dir_cache.dirs;
+        g_conf_dir_cache.dirs = idx->next;
+        free_conf_dir_index(idx);
+    }
+    g_conf_dir_cache.count = 0;
+    conf_dir_cache_drain();
+    (void)pthread_mutex_unlock(&g_conf_dir_cache.lock);
+}
+
 static int generate_new_conflist(const cni_net_conf_list *list, struct network_config_list **conf_list, char **err)
 {
     struct parser_context ctx = { OPT_PARSE_FULLKEY | OPT_GEN_SIMPLIFY, 0 };
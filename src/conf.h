@@ -46,12 +46,24 @@ int conflist_from_bytes(const char *json_str, struct network_config_list **list,
 
 int conflist_from_file(const char *filename, struct network_config_list **list, char **err);
 
+/*
+ * find config named name in dir, same as reading its .conf and .json files in order,
+ * dirs are indexed once and refreshed by inotify events or by stat of files
+ * */
 int load_conf(const char *dir, const char *name, struct network_config **conf, char **err);
 
+int load_conf_from_dir_index(const char *dir, const char *name, char **type, char **bytes, char **err);
+
+void flush_conf_dir_cache(void);
+
 int conflist_from_conf(const struct network_config *conf, struct network_config_list **conf_list, char **err);
 
 int conf_files(const char *dir, const char * const *extensions, size_t ext_len, char ***result, char **err);
 
+/* max_files 0 means no limit */
+int conf_files_with_limit(const char *dir, const char * const *extensions, size_t ext_len, size_t max_files,
+                          char ***result, char **err);
+
 #ifdef __cplusplus
 }
 #endif
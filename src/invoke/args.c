@@ -17,7 +17,9 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <limits.h>
+#include <pthread.h>
 
 #include "utils.h"
 #include "args.h"
@@ -91,121 +93,221 @@ free_out:
     return result;
 }
 
-static int add_cni_envs(const struct cni_args *cniargs, size_t *pos, char **result)
+/* filtered copy of environ shared by all plugins, replaced only by refresh_env_template */
+struct env_template {
+    size_t refs;
+    char **envs;
+    size_t len;
+};
+
+static pthread_mutex_t g_env_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct env_template *g_env_template = NULL;
+
+static bool is_proxy_env(const char *env)
 {
-    char *plugin_args_str = NULL;
-    char *buffer = NULL;
-    size_t i = *pos;
-    int nret = 0;
-    int ret = -1;
-
-    plugin_args_str = cniargs->plugin_args_str ? clibcni_util_strdup_s(cniargs->plugin_args_str) : NULL;
-    if (clibcni_is_null_or_empty(plugin_args_str)) {
-        free(plugin_args_str);
-        plugin_args_str = env_stringify(cniargs->plugin_args, cniargs->plugin_args_len);
+#define NO_PROXY_KEY "no_proxy"
+#define HTTP_PROXY_KEY "http_proxy"
+#define HTTPS_PROXY_KEY "https_proxy"
+    return strncasecmp(env, NO_PROXY_KEY, strlen(NO_PROXY_KEY)) == 0 ||
+           strncasecmp(env, HTTP_PROXY_KEY, strlen(HTTP_PROXY_KEY)) == 0 ||
+           strncasecmp(env, HTTPS_PROXY_KEY, strlen(HTTPS_PROXY_KEY)) == 0;
+}
+
+static void free_env_template(struct env_template *tmpl)
+{
+    if (tmpl == NULL) {
+        return;
     }
+    clibcni_util_free_array(tmpl->envs);
+    free(tmpl);
+}
 
-    nret = asprintf(&buffer, "%s=%s", ENV_CNI_COMMAND, cniargs->command);
-    if (nret < 0) {
-        ERROR("Sprintf failed");
-        goto free_out;
+static struct env_template *new_env_template(void)
+{
+    struct env_template *tmpl = NULL;
+    char **pos = NULL;
+    size_t len = 0;
+
+    tmpl = clibcni_util_common_calloc_s(sizeof(struct env_template));
+    if (tmpl == NULL) {
+        ERROR("Out of memory");
+        return NULL;
     }
-    result[i++] = buffer;
-    buffer = NULL;
-    nret = asprintf(&buffer, "%s=%s", ENV_CNI_CONTAINERID, cniargs->container_id);
-    if (nret < 0) {
-        ERROR("Sprintf failed");
-        goto free_out;
+    len = clibcni_util_array_len((const char * const *)environ);
+    tmpl->envs = clibcni_util_smart_calloc_s(len + 1, sizeof(char *));
+    if (tmpl->envs == NULL) {
+        ERROR("Out of memory");
+        free(tmpl);
+        return NULL;
     }
-    result[i++] = buffer;
-    buffer = NULL;
-    nret = asprintf(&buffer, "%s=%s", ENV_CNI_NETNS, cniargs->netns);
-    if (nret < 0) {
-        ERROR("Sprintf failed");
-        goto free_out;
+
+    /* inherit environs of parent, ignore proxy environs */
+    for (pos = environ; pos != NULL && *pos != NULL && tmpl->len < len; pos++) {
+        if (is_proxy_env(*pos)) {
+            continue;
+        }
+        tmpl->envs[tmpl->len] = clibcni_util_strdup_s(*pos);
+        tmpl->len++;
     }
-    result[i++] = buffer;
-    buffer = NULL;
-    nret = asprintf(&buffer, "%s=%s", ENV_CNI_ARGS, plugin_args_str == NULL ? "" : plugin_args_str);
-    if (nret < 0) {
-        ERROR("Sprintf failed");
-        goto free_out;
+    tmpl->refs = 1;
+    return tmpl;
+}
+
+static struct env_template *get_env_template(void)
+{
+    struct env_template *tmpl = NULL;
+
+    (void)pthread_mutex_lock(&g_env_lock);
+    if (g_env_template == NULL) {
+        g_env_template = new_env_template();
     }
-    result[i++] = buffer;
-    buffer = NULL;
-    nret = asprintf(&buffer, "%s=%s", ENV_CNI_IFNAME, cniargs->ifname);
-    if (nret < 0) {
-        ERROR("Sprintf failed");
-        goto free_out;
+    tmpl = g_env_template;
+    if (tmpl != NULL) {
+        tmpl->refs++;
     }
-    result[i++] = buffer;
-    buffer = NULL;
-    nret = asprintf(&buffer, "%s=%s", ENV_CNI_PATH, cniargs->path);
-    if (nret < 0) {
-        ERROR("Sprintf failed");
-        goto free_out;
+    (void)pthread_mutex_unlock(&g_env_lock);
+    return tmpl;
+}
+
+static void put_env_template(struct env_template *tmpl)
+{
+    bool last = false;
+
+    if (tmpl == NULL) {
+        return;
+    }
+    (void)pthread_mutex_lock(&g_env_lock);
+    tmpl->refs--;
+    last = (tmpl->refs == 0);
+    (void)pthread_mutex_unlock(&g_env_lock);
+    if (last) {
+        free_env_template(tmpl);
     }
-    result[i++] = buffer;
+}
 
-    ret = 0;
-free_out:
-    free(plugin_args_str);
-    *pos = i;
-    return ret;
+void refresh_env_template(void)
+{
+    struct env_template *old = NULL;
+
+    /* built at next as_env, environs of plugins running now keep the old one */
+    (void)pthread_mutex_lock(&g_env_lock);
+    old = g_env_template;
+    g_env_template = NULL;
+    (void)pthread_mutex_unlock(&g_env_lock);
+    put_env_template(old);
 }
 
-char **as_env(const struct cni_args *cniargs)
+struct cni_env_entry {
+    const char *key;
+    const char *value;
+};
+
+static size_t cni_envs_size(const struct cni_env_entry *entries, size_t len)
 {
-#define NO_PROXY_KEY "no_proxy"
-#define HTTP_PROXY_KEY "http_proxy"
-#define HTTPS_PROXY_KEY "https_proxy"
-    char **result = NULL;
-    char **pos = NULL;
-    size_t len = 0;
+    size_t size = 0;
     size_t i = 0;
-    size_t j = 0;
-    char **envir = environ;
 
-    if (cniargs == NULL) {
-        ERROR("Invlaid cni args");
-        return NULL;
+    for (i = 0; i < len; i++) {
+        size += strlen(entries[i].key) + strlen(entries[i].value) + 2;
     }
+    return size;
+}
 
-    len = clibcni_util_array_len((const char * const *)envir);
+/* "key=value" of all entries are written into buf one after another */
+static void fill_cni_envs(const struct cni_env_entry *entries, size_t len, char *buf, char **result)
+{
+    size_t klen = 0;
+    size_t vlen = 0;
+    size_t i = 0;
 
-    if (len > ((SIZE_MAX / sizeof(char *)) - (CNI_ENVS_LEN + 1))) {
-        ERROR("Too large arguments");
-        return NULL;
+    for (i = 0; i < len; i++) {
+        klen = strlen(entries[i].key);
+        vlen = strlen(entries[i].value);
+        result[i] = buf;
+        (void)memcpy(buf, entries[i].key, klen);
+        buf[klen] = '=';
+        (void)memcpy(buf + klen + 1, entries[i].value, vlen);
+        buf[klen + 1 + vlen] = '\0';
+        buf += klen + vlen + 2;
     }
+}
 
-    len += (CNI_ENVS_LEN + 1);
-    result = clibcni_util_common_calloc_s(len * sizeof(char *));
-    if (result == NULL) {
-        ERROR("Out of memory");
+static inline const char *env_value(const char *value)
+{
+    return value != NULL ? value : "";
+}
+
+static void set_cni_env_entries(const struct cni_args *cniargs, const char *plugin_args_str,
+                                struct cni_env_entry *entries)
+{
+    entries[0].key = ENV_CNI_COMMAND;
+    entries[0].value = env_value(cniargs->command);
+    entries[1].key = ENV_CNI_CONTAINERID;
+    entries[1].value = env_value(cniargs->container_id);
+    entries[2].key = ENV_CNI_NETNS;
+    entries[2].value = env_value(cniargs->netns);
+    entries[3].key = ENV_CNI_ARGS;
+    entries[3].value = env_value(plugin_args_str);
+    entries[4].key = ENV_CNI_IFNAME;
+    entries[4].value = env_value(cniargs->ifname);
+    entries[5].key = ENV_CNI_PATH;
+    entries[5].value = env_value(cniargs->path);
+}
+
+struct cni_env *as_env(const struct cni_args *cniargs)
+{
+    struct cni_env *env = NULL;
+    struct env_template *tmpl = NULL;
+    struct cni_env_entry entries[CNI_ENVS_LEN];
+    char *plugin_args_str = NULL;
+    size_t envs_len = 0;
+    size_t size = 0;
+
+    if (cniargs == NULL) {
+        ERROR("Invlaid cni args");
         return NULL;
     }
 
-    if (add_cni_envs(cniargs, &i, result) != 0) {
+    if (clibcni_is_null_or_empty(cniargs->plugin_args_str) && cniargs->plugin_args_len > 0) {
+        plugin_args_str = env_stringify(cniargs->plugin_args, cniargs->plugin_args_len);
+    }
+    set_cni_env_entries(cniargs, plugin_args_str != NULL ? plugin_args_str : cniargs->plugin_args_str, entries);
+
+    tmpl = get_env_template();
+    if (tmpl == NULL) {
         goto free_out;
     }
 
-    /* inherit environs of parent */
-    for (pos = envir; pos != NULL && *pos != NULL && i < len; pos++) {
-        // ignore proxy environs
-        if (strncasecmp(*pos, NO_PROXY_KEY, strlen(NO_PROXY_KEY)) == 0 ||
-            strncasecmp(*pos, HTTP_PROXY_KEY, strlen(HTTP_PROXY_KEY)) == 0 ||
-            strncasecmp(*pos, HTTPS_PROXY_KEY, strlen(HTTPS_PROXY_KEY)) == 0) {
-            continue;
-        }
-        result[i] = clibcni_util_strdup_s(*pos);
-        i++;
+    /* one block: env struct, NULL terminated array, then strings of CNI_* entries */
+    envs_len = CNI_ENVS_LEN + tmpl->len;
+    if (envs_len > ((SIZE_MAX - sizeof(struct cni_env)) / sizeof(char *)) - 1) {
+        ERROR("Too large arguments");
+        goto free_out;
+    }
+    size = sizeof(struct cni_env) + (envs_len + 1) * sizeof(char *) + cni_envs_size(entries, CNI_ENVS_LEN);
+    env = clibcni_util_common_calloc_s(size);
+    if (env == NULL) {
+        ERROR("Out of memory");
+        goto free_out;
     }
+    env->envs = (char **)(env + 1);
+    fill_cni_envs(entries, CNI_ENVS_LEN, (char *)(env->envs + envs_len + 1), env->envs);
+    /* inherited strings are not copied, the template lives until free_cni_env */
+    (void)memcpy(env->envs + CNI_ENVS_LEN, tmpl->envs, tmpl->len * sizeof(char *));
+    env->tmpl = tmpl;
+    tmpl = NULL;
 
-    return result;
 free_out:
-    for (j = 0; j < i; j++) {
-        free(result[j]);
+    put_env_template(tmpl);
+    free(plugin_args_str);
+    return env;
+}
+
+void free_cni_env(struct cni_env *env)
+{
+    if (env == NULL) {
+        return;
     }
-    free(result);
-    return NULL;
+    put_env_template(env->tmpl);
+    free(env);
 }
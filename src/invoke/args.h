@@ -37,7 +37,21 @@ struct cni_args {
     char *path;
 };
 
-char **as_env(const struct cni_args *cniargs);
+struct env_template;
+
+/* environs of one plugin exec, inherited part is shared with other execs */
+struct cni_env {
+    /* NULL terminated, CNI_* entries first */
+    char **envs;
+    struct env_template *tmpl;
+};
+
+struct cni_env *as_env(const struct cni_args *cniargs);
+
+void free_cni_env(struct cni_env *env);
+
+/* environ is filtered and copied once, call it after environ of process changed */
+void refresh_env_template(void);
 
 void free_cni_args(struct cni_args *cargs);
 
@@ -15,25 +15,92 @@
 #define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
+#include <limits.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <signal.h>
+#include <spawn.h>
+#include <pthread.h>
+#include <time.h>
 #include <linux/limits.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/resource.h>
 
 #include "exec.h"
 
+#include "exec_helper.h"
 #include "utils.h"
 #include "tools.h"
 #include "invoke_errno.h"
 #include "isula_libutils/log.h"
 
-static int raw_exec(const char *plugin_path, const char *stdin_data, char * const environs[], char **stdout_str,
-                    cni_exec_error **err);
+static int raw_exec(const char *plugin_path, const char *stdin_data, char * const environs[], int64_t deadline,
+                    char **stdout_str, cni_exec_error **err);
+
+/* set and read from any thread, only through __atomic builtins */
+static enum cni_exec_backend g_exec_backend = CNI_EXEC_BACKEND_SPAWN;
+
+static inline enum cni_exec_backend get_exec_backend(void)
+{
+    return __atomic_load_n(&g_exec_backend, __ATOMIC_RELAXED);
+}
+
+#define DEFAULT_PLUGIN_OUTPUT_LIMIT (4 * MB)
+
+/* interval of polling exit of child when kernel has no pidfd */
+#define REAP_POLL_INTERVAL_MS 10
+
+/* set and read from any thread, only through __atomic builtins */
+static size_t g_plugin_output_limit = DEFAULT_PLUGIN_OUTPUT_LIMIT;
+
+void set_plugin_output_limit(size_t limit)
+{
+    __atomic_store_n(&g_plugin_output_limit, limit > 0 ? limit : DEFAULT_PLUGIN_OUTPUT_LIMIT, __ATOMIC_RELAXED);
+}
+
+static inline size_t get_plugin_output_limit(void)
+{
+    return __atomic_load_n(&g_plugin_output_limit, __ATOMIC_RELAXED);
+}
+
+int set_exec_backend(enum cni_exec_backend backend)
+{
+    switch (backend) {
+        case CNI_EXEC_BACKEND_SPAWN:
+        case CNI_EXEC_BACKEND_FORK:
+            /* helper is kept, forking it again later would be from a bigger process */
+            __atomic_store_n(&g_exec_backend, backend, __ATOMIC_RELAXED);
+            return 0;
+        case CNI_EXEC_BACKEND_HELPER:
+            if (!exec_helper_started()) {
+                ERROR("Exec helper is not started, call cni_exec_helper_init first");
+                return -1;
+            }
+            __atomic_store_n(&g_exec_backend, backend, __ATOMIC_RELAXED);
+            return 0;
+        default:
+            ERROR("Invalid exec backend: %d", (int)backend);
+            return -1;
+    }
+}
+
+int start_exec_helper(void)
+{
+    if (exec_helper_start() != 0) {
+        ERROR("Start exec helper failed");
+        return -1;
+    }
+    return 0;
+}
 
 static char *str_cni_exec_error(const cni_exec_error *e_err)
 {
@@ -52,18 +119,26 @@ static char *str_cni_exec_error(const cni_exec_error *e_err)
     return result;
 }
 
-static int do_parse_exec_stdout_str(int exec_ret, const char *cni_net_conf_json, const cni_exec_error *e_err,
-                                    const char *stdout_str, struct result **result, char **err)
+static int do_parse_exec_err(int exec_ret, const cni_exec_error *e_err, char **err)
 {
-    int ret = exec_ret;
-    char *version = NULL;
-
     if (exec_ret != 0) {
         if (e_err != NULL) {
             *err = str_cni_exec_error(e_err);
         } else {
             *err = clibcni_util_strdup_s("raw exec fail");
         }
+    }
+    return exec_ret;
+}
+
+static int do_parse_exec_stdout_str(int exec_ret, const char *cni_net_conf_json, const cni_exec_error *e_err,
+                                    const char *stdout_str, struct result **result, char **err)
+{
+    int ret = exec_ret;
+    char *version = NULL;
+
+    if (exec_ret != 0) {
+        (void)do_parse_exec_err(exec_ret, e_err, err);
     } else {
         version = cniversion_decode(cni_net_conf_json, err);
         if (version == NULL) {
@@ -87,6 +162,41 @@ out:
     return ret;
 }
 
+/* same as do_parse_exec_stdout_str, and stdout is handed over as raw json too */
+static int do_check_exec_stdout_str(int exec_ret, const char *cni_net_conf_json, const cni_exec_error *e_err,
+                                    char **stdout_str, char **raw_result, struct result **result, char **err)
+{
+    int ret = exec_ret;
+    char *version = NULL;
+
+    if (exec_ret != 0) {
+        (void)do_parse_exec_err(exec_ret, e_err, err);
+    } else {
+        version = cniversion_decode(cni_net_conf_json, err);
+        if (version == NULL) {
+            ret = -1;
+            ERROR("Decode cni version failed: %s", *err != NULL ? *err : "");
+            goto out;
+        }
+        if (clibcni_is_null_or_empty(*stdout_str)) {
+            ERROR("Get empty stdout message");
+            goto out;
+        }
+        *result = new_result(version, *stdout_str, err);
+        if (*result == NULL) {
+            ERROR("Parse result failed: %s", *err != NULL ? *err : "");
+            ret = -1;
+            goto out;
+        }
+        *raw_result = *stdout_str;
+        *stdout_str = NULL;
+    }
+
+out:
+    free(version);
+    return ret;
+}
+
 static inline bool check_exec_plugin_with_result_args(const char *cni_net_conf_json, struct result * const *result,
                                                       char * const *err)
 {
@@ -94,9 +204,9 @@ static inline bool check_exec_plugin_with_result_args(const char *cni_net_conf_j
 }
 
 int exec_plugin_with_result(const char *plugin_path, const char *cni_net_conf_json, const struct cni_args *cniargs,
-                            struct result **result, char **err)
+                            int64_t deadline, struct result **result, char **err)
 {
-    char **envs = NULL;
+    struct cni_env *env = NULL;
     char *stdout_str = NULL;
     cni_exec_error *e_err = NULL;
     int ret = 0;
@@ -106,55 +216,82 @@ int exec_plugin_with_result(const char *plugin_path, const char *cni_net_conf_js
         return -1;
     }
     if (cniargs != NULL) {
-        envs = as_env(cniargs);
-        if (envs == NULL) {
+        env = as_env(cniargs);
+        if (env == NULL) {
             *err = clibcni_util_strdup_s("As env failed");
             ret = -1;
             goto out;
         }
     }
 
-    ret = raw_exec(plugin_path, cni_net_conf_json, envs, &stdout_str, &e_err);
+    ret = raw_exec(plugin_path, cni_net_conf_json, env != NULL ? env->envs : NULL, deadline, &stdout_str, &e_err);
     DEBUG("Raw exec \"%s\" result: %d", plugin_path, ret);
     ret = do_parse_exec_stdout_str(ret, cni_net_conf_json, e_err, stdout_str, result, err);
 out:
     free(stdout_str);
-    clibcni_util_free_array(envs);
+    free_cni_env(env);
     free_cni_exec_error(e_err);
     return ret;
 }
 
-int exec_plugin_without_result(const char *plugin_path, const char *cni_net_conf_json, const struct cni_args *cniargs,
-                               char **err)
+int exec_plugin_with_raw_result(const char *plugin_path, const char *cni_net_conf_json,
+                                const struct cni_args *cniargs, int64_t deadline, char **raw_result,
+                                struct result **result, char **err)
 {
-    char **envs = NULL;
+    struct cni_env *env = NULL;
+    char *stdout_str = NULL;
     cni_exec_error *e_err = NULL;
     int ret = 0;
-    bool invalid_arg = (cni_net_conf_json == NULL || err == NULL);
+    bool invalid_arg = (cni_net_conf_json == NULL || raw_result == NULL || result == NULL || err == NULL);
 
     if (invalid_arg) {
         ERROR("Invalid arguments");
         return -1;
     }
     if (cniargs != NULL) {
-        envs = as_env(cniargs);
-        if (envs == NULL) {
+        env = as_env(cniargs);
+        if (env == NULL) {
             *err = clibcni_util_strdup_s("As env failed");
+            ret = -1;
             goto out;
         }
     }
 
-    ret = raw_exec(plugin_path, cni_net_conf_json, envs, NULL, &e_err);
-    if (ret != 0) {
-        if (e_err != NULL) {
-            *err = str_cni_exec_error(e_err);
-        } else {
-            *err = clibcni_util_strdup_s("raw exec fail");
+    ret = raw_exec(plugin_path, cni_net_conf_json, env != NULL ? env->envs : NULL, deadline, &stdout_str, &e_err);
+    DEBUG("Raw exec \"%s\" result: %d", plugin_path, ret);
+    ret = do_check_exec_stdout_str(ret, cni_net_conf_json, e_err, &stdout_str, raw_result, result, err);
+out:
+    free(stdout_str);
+    free_cni_env(env);
+    free_cni_exec_error(e_err);
+    return ret;
+}
+
+int exec_plugin_without_result(const char *plugin_path, const char *cni_net_conf_json, const struct cni_args *cniargs,
+                               int64_t deadline, char **err)
+{
+    struct cni_env *env = NULL;
+    cni_exec_error *e_err = NULL;
+    int ret = 0;
+    bool invalid_arg = (cni_net_conf_json == NULL || err == NULL);
+
+    if (invalid_arg) {
+        ERROR("Invalid arguments");
+        return -1;
+    }
+    if (cniargs != NULL) {
+        env = as_env(cniargs);
+        if (env == NULL) {
+            *err = clibcni_util_strdup_s("As env failed");
+            goto out;
         }
     }
+
+    ret = raw_exec(plugin_path, cni_net_conf_json, env != NULL ? env->envs : NULL, deadline, NULL, &e_err);
+    ret = do_parse_exec_err(ret, e_err, err);
     DEBUG("Raw exec \"%s\" result: %d", plugin_path, ret);
 out:
-    clibcni_util_free_array(envs);
+    free_cni_env(env);
     free_cni_exec_error(e_err);
     return ret;
 }
@@ -201,7 +338,7 @@ int raw_get_version_info(const char *plugin_path, struct plugin_info **result, c
     char *stdout_str = NULL;
     const char *version = current();
     size_t len = 0;
-    char **envs = NULL;
+    struct cni_env *env = NULL;
     cni_exec_error *e_err = NULL;
     bool invalid_arg = (result == NULL || err == NULL);
 
@@ -210,8 +347,8 @@ int raw_get_version_info(const char *plugin_path, struct plugin_info **result, c
         return -1;
     }
 
-    envs = as_env(&args);
-    if (envs == NULL) {
+    env = as_env(&args);
+    if (env == NULL) {
         ret = -1;
         *err = clibcni_util_strdup_s("As env failed");
         goto free_out;
@@ -229,7 +366,7 @@ int raw_get_version_info(const char *plugin_path, struct plugin_info **result, c
         *err = clibcni_util_strdup_s("Sprintf failed");
         goto free_out;
     }
-    ret = raw_exec(plugin_path, stdin_data, envs, &stdout_str, &e_err);
+    ret = raw_exec(plugin_path, stdin_data, env->envs, 0, &stdout_str, &e_err);
     DEBUG("Raw exec \"%s\" result: %d", plugin_path, ret);
     ret = do_parse_get_version_errmsg(ret, e_err, result, err);
     if (ret != 0) {
@@ -242,7 +379,7 @@ int raw_get_version_info(const char *plugin_path, struct plugin_info **result, c
 
 free_out:
     free_cni_exec_error(e_err);
-    clibcni_util_free_array(envs);
+    free_cni_env(env);
     free(stdin_data);
     free(stdout_str);
     return ret;
@@ -254,6 +391,12 @@ static int prepare_child(int pipe_stdin, int pipe_stdout)
     int ecode = 0;
     int ret = 0;
 
+    /* own process group, so that a timeout kills everything the plugin started */
+    if (setpgid(0, 0) != 0) {
+        ecode = EXIT_FAILURE;
+        goto child_err_out;
+    }
+
     if (pipe_stdin != STDIN_FILENO) {
         ret = dup2(pipe_stdin, STDIN_FILENO);
     } else {
@@ -298,8 +441,8 @@ child_err_out:
     return ecode;
 }
 
-static void child_fun(const char *plugin_path, int pipe_stdin, int pipe_stdout, char * const environs[],
-                      size_t envs_len)
+static void child_fun(const char *plugin_path, int exec_fd, int pipe_stdin, int pipe_stdout,
+                      char * const environs[], size_t envs_len)
 {
     char *argv[2] = { NULL };
     int ecode = 0;
@@ -311,6 +454,10 @@ static void child_fun(const char *plugin_path, int pipe_stdin, int pipe_stdout,
         goto child_err_out;
     }
 
+    if (exec_fd >= 0) {
+        /* binary checked by find_in_path is the one started, fall back to path if kernel refuses it */
+        (void)fexecve(exec_fd, argv, envs_len > 0 ? environs : environ);
+    }
     if (envs_len > 0) {
         ecode = execvpe(plugin_path, argv, environs);
     } else {
@@ -338,6 +485,16 @@ static inline bool check_prepare_raw_exec_args(const char *plugin_path)
     return (plugin_path == NULL || clibcni_util_validate_absolute_path(plugin_path));
 }
 
+static int set_fd_nonblock(int fd)
+{
+    int flags = fcntl(fd, F_GETFL);
+
+    if (flags < 0) {
+        return -1;
+    }
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
 static int prepare_raw_exec(const char *plugin_path, int pipe_stdin[2], int pipe_stdout[2], char *errmsg, size_t len)
 {
     int ret = 0;
@@ -350,7 +507,7 @@ static int prepare_raw_exec(const char *plugin_path, int pipe_stdin[2], int pipe
         return -1;
     }
 
-    ret = pipe2(pipe_stdin, O_CLOEXEC | O_NONBLOCK);
+    ret = pipe2(pipe_stdin, O_CLOEXEC);
     if (ret < 0) {
         ret = snprintf(errmsg, len, "Pipe stdin failed: %s", strerror(errno));
         if (ret < 0 || (size_t)ret >= len) {
@@ -359,7 +516,7 @@ static int prepare_raw_exec(const char *plugin_path, int pipe_stdin[2], int pipe
         return -1;
     }
 
-    ret = pipe2(pipe_stdout, O_CLOEXEC | O_NONBLOCK);
+    ret = pipe2(pipe_stdout, O_CLOEXEC);
     if (ret < 0) {
         ret = snprintf(errmsg, len, "Pipe stdout failed: %s", strerror(errno));
         if (ret < 0 || (size_t)ret >= len) {
@@ -367,103 +524,52 @@ static int prepare_raw_exec(const char *plugin_path, int pipe_stdin[2], int pipe
         }
         return -1;
     }
-    return 0;
-}
-
-static int write_stdin_data_to_child(int pipe_stdin[2], const char *stdin_data, char *errmsg, size_t errmsg_len)
-{
-    int ret = 0;
-    size_t len = 0;
-
-    if (stdin_data == NULL) {
-        goto close_pipe;
-    }
 
-    len = strlen(stdin_data);
-    if (clibcni_util_write_nointr(pipe_stdin[1], stdin_data, len) != (ssize_t)len) {
-        ret = snprintf(errmsg, errmsg_len, "Write stdin data failed: %s", strerror(errno));
-        if (ret < 0 || (size_t)ret >= errmsg_len) {
+    /* only our ends are nonblocking, plugin gets plain blocking stdin and stdout */
+    if (set_fd_nonblock(pipe_stdin[1]) != 0 || set_fd_nonblock(pipe_stdout[0]) != 0) {
+        ret = snprintf(errmsg, len, "Set pipe nonblock failed: %s", strerror(errno));
+        if (ret < 0 || (size_t)ret >= len) {
             ERROR("Sprintf failed");
         }
-        ret = -1;
+        return -1;
     }
-close_pipe:
-    (void)close(pipe_stdin[1]);
-    pipe_stdin[1] = -1;
-    return ret;
+    return 0;
 }
 
-static int read_child_stdout_msg(const int pipe_stdout[2], char *errmsg, size_t errmsg_len, char **stdout_str)
+/* append to errmsg in place, snprintf can not take errmsg as both source and destination */
+static void append_errmsg(char *errmsg, size_t errmsg_len, const char *format, ...)
 {
+    size_t used = strnlen(errmsg, errmsg_len);
+    va_list args;
     int ret = 0;
 
-    if (errmsg == NULL) {
-        return 0;
+    if (used + 1 >= errmsg_len) {
+        return;
     }
-    if (stdout_str != NULL) {
-        char buffer[CLIBCNI_BUFFER_SIZE] = { 0 };
-        ssize_t tmp_len = clibcni_util_read_nointr(pipe_stdout[0], buffer, CLIBCNI_BUFFER_SIZE - 1);
-        if (tmp_len < 0) {
-            ret = snprintf(errmsg, errmsg_len, "%s; read stdout failed: %s", strlen(errmsg) > 0 ? errmsg : "",
-                           strerror(errno));
-            if (ret < 0 || (size_t)ret >= errmsg_len) {
-                ERROR("Sprintf failed");
-            }
-            ret = -1;
-        } else if (tmp_len > 0) {
-            *stdout_str = clibcni_util_strdup_s(buffer);
-        }
+    va_start(args, format);
+    ret = vsnprintf(errmsg + used, errmsg_len - used, format, args);
+    va_end(args);
+    if (ret < 0 || (size_t)ret >= errmsg_len - used) {
+        ERROR("Sprintf failed");
     }
-
-    return ret;
 }
 
-static int wait_pid_for_raw_exec_child(pid_t child_pid, const int pipe_stdout[2], char **stdout_str, char *errmsg,
-                                       size_t errmsg_len, bool *parse_exec_err)
+static int check_child_exit_status(const struct plugin_process_status *pstatus, char *errmsg, size_t errmsg_len,
+                                   bool *parse_exec_err)
 {
-    pid_t wait_pid = 0;
-    int wait_status = 0;
-    int ret = 0;
-
-    if (errmsg == NULL) {
-        return -1;
-    }
-    do {
-        wait_pid = waitpid(child_pid, &wait_status, 0);
-    } while (wait_pid < 0 && errno == EINTR);
-
-    ret = read_child_stdout_msg(pipe_stdout, errmsg, errmsg_len, stdout_str);
+    int wait_status = pstatus->wait_status;
 
-    if (wait_pid < 0) {
-        ret = snprintf(errmsg, errmsg_len, "%s; waitpid failed: %s", strlen(errmsg) > 0 ? errmsg : "",
-                       strerror(errno));
-        if (ret < 0 || (size_t)ret >= errmsg_len) {
-            ERROR("Sprintf failed");
-        }
-        ret = -1;
-        goto err_free_out;
-    } else if (WIFEXITED(wait_status) && WEXITSTATUS(wait_status)) {
-        ret = snprintf(errmsg, errmsg_len, "%s; get child status: %d", strlen(errmsg) > 0 ? errmsg : "",
-                       WEXITSTATUS(wait_status));
-        if (ret < 0 || (size_t)ret >= errmsg_len) {
-            ERROR("Sprintf failed");
-        }
-        ret = WEXITSTATUS(wait_status);
+    if (WIFEXITED(wait_status) && WEXITSTATUS(wait_status)) {
+        append_errmsg(errmsg, errmsg_len, "; get child status: %d", WEXITSTATUS(wait_status));
         *parse_exec_err = true;
-        goto err_free_out;
+        return WEXITSTATUS(wait_status);
     } else if (WIFSIGNALED(wait_status)) {
-        ret = snprintf(errmsg, errmsg_len, "%s; child get signal: %d", strlen(errmsg) > 0 ? errmsg : "",
-                       WTERMSIG(wait_status));
-        if (ret < 0 || (size_t)ret >= errmsg_len) {
-            ERROR("Sprintf failed");
-        }
-        ret = INK_ERR_TERM_BY_SIG;
+        append_errmsg(errmsg, errmsg_len, "; child get signal: %d", WTERMSIG(wait_status));
         *parse_exec_err = true;
-        goto err_free_out;
+        return INK_ERR_TERM_BY_SIG;
     }
 
-err_free_out:
-    return ret;
+    return 0;
 }
 
 static void close_raw_exec_pipes(int pipe_stdin[2], int pipe_stdout[2])
@@ -504,8 +610,11 @@ static void make_err_message(const char *plugin_path, char **stdout_str, int ret
         parser_error json_err = NULL;
         *err = cni_exec_error_parse_data(*stdout_str, NULL, &json_err);
         if (*err == NULL) {
-            nret = snprintf(errmsg, errmsg_len, "exec \'%s\': %s; parse failed: %s", plugin_path,
-                            strlen(errmsg) > 0 ? errmsg : "", json_err);
+            char old_errmsg[CLIBCNI_BUFFER_SIZE] = { 0 };
+
+            (void)snprintf(old_errmsg, sizeof(old_errmsg), "%s", errmsg);
+            nret = snprintf(errmsg, errmsg_len, "exec \'%s\': %s; parse failed: %s", plugin_path, old_errmsg,
+                            json_err);
             if (nret < 0 || (size_t)nret >= errmsg_len) {
                 ERROR("Sprintf failed");
             }
@@ -529,84 +638,752 @@ static void make_err_message(const char *plugin_path, char **stdout_str, int ret
     }
 }
 
-static int do_parent_waitpid(int pipe_stdin[2], const int pipe_stdout[2], pid_t child_pid, char *errmsg,
-                             size_t errmsg_len, const char *stdin_data, char **stdout_str, bool *parse_exec_err)
+static int fork_plugin(const char *plugin_path, int exec_fd, int pipe_stdin[2], int pipe_stdout[2],
+                       char * const environs[], pid_t *child_pid, char *errmsg, size_t errmsg_len)
 {
     int ret = 0;
 
-    if (errmsg == NULL) {
+    *child_pid = fork();
+    if (*child_pid < 0) {
+        ret = snprintf(errmsg, errmsg_len, "Fork failed: %s", strerror(errno));
+        if (ret < 0 || (size_t)ret >= errmsg_len) {
+            ERROR("Sprintf failed");
+        }
         return -1;
     }
-    /* write stdin_data into stdin of child process */
-    if (write_stdin_data_to_child(pipe_stdin, stdin_data, errmsg, errmsg_len) != 0) {
-        ERROR("Write stdin data failed: %s", errmsg);
-        ret = -1;
+
+    if (*child_pid == 0) {
+        (void)close(pipe_stdin[1]);
+        pipe_stdin[1] = -1;
+        (void)close(pipe_stdout[0]);
+        pipe_stdout[0] = -1;
+
+        size_t envs_len = 0;
+        envs_len = clibcni_util_array_len((const char * const *)environs);
+        child_fun(plugin_path, exec_fd, pipe_stdin[0], pipe_stdout[1], environs, envs_len);
+        /* exit in child_fun */
+    }
+
+    /* child does the same, whoever is first wins */
+    (void)setpgid(*child_pid, *child_pid);
+    return 0;
+}
+
+static int do_spawn_plugin(const char *plugin_path, int exec_fd, const int pipe_stdin[2], const int pipe_stdout[2],
+                           char * const environs[], posix_spawn_file_actions_t *factions, posix_spawnattr_t *attr,
+                           pid_t *child_pid)
+{
+    sigset_t mask;
+    char * const argv[2] = { (char *)plugin_path, NULL };
+    char * const *envs = environs;
+    char fd_path[PATH_MAX] = { 0 };
+    int ret = 0;
+    int nret = 0;
+
+    /* dup2 clears FD_CLOEXEC of targets, the other pipe fds are closed by exec */
+    ret = posix_spawn_file_actions_adddup2(factions, pipe_stdin[0], STDIN_FILENO);
+    if (ret != 0) {
+        return ret;
+    }
+    ret = posix_spawn_file_actions_adddup2(factions, pipe_stdout[1], STDOUT_FILENO);
+    if (ret != 0) {
+        return ret;
+    }
+
+    /* unblock all signal in child, same as fork backend */
+    (void)sigemptyset(&mask);
+    ret = posix_spawnattr_setsigmask(attr, &mask);
+    if (ret != 0) {
+        return ret;
+    }
+    /* own process group, so that a timeout kills everything the plugin started */
+    ret = posix_spawnattr_setpgroup(attr, 0);
+    if (ret != 0) {
+        return ret;
+    }
+    ret = posix_spawnattr_setflags(attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETPGROUP);
+    if (ret != 0) {
+        return ret;
+    }
+
+    if (clibcni_util_array_len((const char * const *)environs) == 0) {
+        envs = environ;
+    }
+
+    /* close-on-exec fds are closed after kernel opened the binary, so proc link of exec fd works */
+    if (exec_fd >= 0) {
+        nret = snprintf(fd_path, sizeof(fd_path), "/proc/self/fd/%d", exec_fd);
+        if (nret > 0 && (size_t)nret < sizeof(fd_path)) {
+            ret = posix_spawn(child_pid, fd_path, factions, attr, argv, envs);
+            /* without proc mounted, start it by path */
+            if (ret != ENOENT) {
+                return ret;
+            }
+        }
+    }
+
+    return posix_spawn(child_pid, plugin_path, factions, attr, argv, envs);
+}
+
+/*
+ * posix_spawn of glibc uses clone(CLONE_VM | CLONE_VFORK), so we do not copy
+ * page tables of the caller and do not run any non async-signal-safe code in child.
+ * */
+static int spawn_plugin(const char *plugin_path, int exec_fd, const int pipe_stdin[2], const int pipe_stdout[2],
+                        char * const environs[], pid_t *child_pid, char *errmsg, size_t errmsg_len)
+{
+    posix_spawn_file_actions_t factions;
+    posix_spawnattr_t attr;
+    int ret = 0;
+    int nret = 0;
+
+    ret = posix_spawn_file_actions_init(&factions);
+    if (ret != 0) {
+        nret = snprintf(errmsg, errmsg_len, "Init spawn file actions failed: %s", strerror(ret));
+        if (nret < 0 || (size_t)nret >= errmsg_len) {
+            ERROR("Sprintf failed");
+        }
+        return -1;
+    }
+    ret = posix_spawnattr_init(&attr);
+    if (ret != 0) {
+        nret = snprintf(errmsg, errmsg_len, "Init spawn attributes failed: %s", strerror(ret));
+        if (nret < 0 || (size_t)nret >= errmsg_len) {
+            ERROR("Sprintf failed");
+        }
+        (void)posix_spawn_file_actions_destroy(&factions);
+        return -1;
     }
 
-    /* wait child exit, and deal with exitcode */
-    if (wait_pid_for_raw_exec_child(child_pid, pipe_stdout, stdout_str, errmsg, errmsg_len, parse_exec_err) != 0) {
-        ERROR("Wait pid for child failed: %s", errmsg);
+    ret = do_spawn_plugin(plugin_path, exec_fd, pipe_stdin, pipe_stdout, environs, &factions, &attr, child_pid);
+    if (ret != 0) {
+        nret = snprintf(errmsg, errmsg_len, "Spawn %s failed: %s", plugin_path, strerror(ret));
+        if (nret < 0 || (size_t)nret >= errmsg_len) {
+            ERROR("Sprintf failed");
+        }
         ret = -1;
     }
 
+    (void)posix_spawnattr_destroy(&attr);
+    (void)posix_spawn_file_actions_destroy(&factions);
     return ret;
 }
 
-static int raw_exec(const char *plugin_path, const char *stdin_data, char * const environs[], char **stdout_str,
-                    cni_exec_error **err)
+static int launch_plugin(const struct plugin_process_request *req, int pipe_stdin[2], int pipe_stdout[2],
+                         pid_t *child_pid, char *errmsg, size_t errmsg_len)
 {
+    int exec_fd = -1;
     int ret = 0;
+
+    if (req->use_exec_fd) {
+        exec_fd = get_plugin_exec_fd(req->plugin_path);
+    }
+    if (get_exec_backend() == CNI_EXEC_BACKEND_FORK) {
+        ret = fork_plugin(req->plugin_path, exec_fd, pipe_stdin, pipe_stdout, req->environs, child_pid, errmsg,
+                          errmsg_len);
+    } else {
+        ret = spawn_plugin(req->plugin_path, exec_fd, pipe_stdin, pipe_stdout, req->environs, child_pid, errmsg,
+                           errmsg_len);
+    }
+    if (exec_fd >= 0) {
+        (void)close(exec_fd);
+    }
+    return ret;
+}
+
+static int open_pidfd(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+    /* pidfd is always close-on-exec */
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+static void close_fd(int *fd)
+{
+    if (*fd >= 0) {
+        (void)close(*fd);
+        *fd = -1;
+    }
+}
+
+/* fd may be shared by other processes, so it must leave the epoll set before close */
+static void close_process_fd(struct plugin_process *proc, int *fd)
+{
+    if (*fd >= 0 && proc->epfd >= 0) {
+        (void)epoll_ctl(proc->epfd, EPOLL_CTL_DEL, *fd, NULL);
+    }
+    close_fd(fd);
+}
+
+int plugin_process_start(const struct plugin_process_request *req, bool keep_stdout, struct plugin_process *proc,
+                         char *errmsg, size_t errmsg_len)
+{
     int pipe_stdout[2] = { -1, -1 };
     int pipe_stdin[2] = { -1, -1 };
-    pid_t child_pid = 0;
-    char errmsg[CLIBCNI_BUFFER_SIZE] = { 0 };
-    bool parse_exec_err = false;
 
-    if (prepare_raw_exec(plugin_path, pipe_stdin, pipe_stdout, errmsg, sizeof(errmsg)) != 0) {
-        ret = -1;
-        goto err_free_out;
+    (void)memset(proc, 0, sizeof(*proc));
+    proc->pid = -1;
+    proc->pidfd = -1;
+    proc->reap_timer = -1;
+    proc->epfd = -1;
+    proc->stdin_fd = -1;
+    proc->stdout_fd = -1;
+    proc->errmsg = errmsg;
+    proc->errmsg_len = errmsg_len;
+    proc->keep_stdout = keep_stdout;
+    proc->output_limit = req->output_limit;
+    proc->deadline = req->deadline;
+    proc->stdin_data = req->stdin_data;
+    proc->stdin_len = req->stdin_data != NULL ? strlen(req->stdin_data) : 0;
+
+    if (prepare_raw_exec(req->plugin_path, pipe_stdin, pipe_stdout, errmsg, errmsg_len) != 0) {
+        goto err_out;
     }
 
-    child_pid = fork();
-    if (child_pid < 0) {
-        ret = snprintf(errmsg, sizeof(errmsg), "Fork failed: %s", strerror(errno));
-        if (ret < 0 || (size_t)ret >= sizeof(errmsg)) {
-            ERROR("Sprintf failed");
+    if (launch_plugin(req, pipe_stdin, pipe_stdout, &proc->pid, errmsg, errmsg_len) != 0) {
+        proc->pid = -1;
+        goto err_out;
+    }
+
+    close_fd(&pipe_stdout[1]);
+    close_fd(&pipe_stdin[0]);
+    proc->stdin_fd = pipe_stdin[1];
+    proc->stdout_fd = pipe_stdout[0];
+    if (proc->stdin_len == 0) {
+        close_process_fd(proc, &proc->stdin_fd);
+    }
+
+    /* without pidfd, stdout EOF tells us the child is exiting */
+    proc->pidfd = open_pidfd(proc->pid);
+    if (proc->pidfd < 0 && errno != ENOSYS) {
+        DEBUG("Open pidfd for %d failed: %s", (int)proc->pid, strerror(errno));
+    }
+    return 0;
+
+err_out:
+    close_raw_exec_pipes(pipe_stdin, pipe_stdout);
+    proc->ret = -1;
+    proc->waited = true;
+    return -1;
+}
+
+static void plugin_process_fail(struct plugin_process *proc, const char *what, const char *reason)
+{
+    append_errmsg(proc->errmsg, proc->errmsg_len, "; %s failed: %s", what, reason);
+    proc->ret = -1;
+}
+
+void plugin_process_kill(struct plugin_process *proc)
+{
+    if (proc->pid > 0 && !proc->waited) {
+        /* whole process group first, plugin may not have set it up yet */
+        (void)kill(-proc->pid, SIGKILL);
+        (void)kill(proc->pid, SIGKILL);
+    }
+}
+
+static void check_deadline(struct plugin_process *proc)
+{
+    if (proc->deadline <= 0 || proc->status.timed_out || proc->waited) {
+        return;
+    }
+    if (clibcni_util_monotonic_ms() < proc->deadline) {
+        return;
+    }
+    proc->status.timed_out = true;
+    plugin_process_fail(proc, "wait plugin", get_invoke_err_msg(INK_ERR_TIMEOUT));
+    plugin_process_kill(proc);
+    /* output is dropped anyway, do not wait for pipes kept open by processes escaped from the group */
+    close_process_fd(proc, &proc->stdin_fd);
+    close_process_fd(proc, &proc->stdout_fd);
+}
+
+int plugin_process_timeout_ms(const struct plugin_process *proc)
+{
+    int64_t remain = 0;
+
+    if (proc->deadline <= 0 || proc->status.timed_out) {
+        return -1;
+    }
+    remain = proc->deadline - clibcni_util_monotonic_ms();
+    if (remain <= 0) {
+        return 0;
+    }
+    return remain > INT_MAX ? INT_MAX : (int)remain;
+}
+
+/* writing to a pipe without reader raises SIGPIPE, keep it away from the caller */
+static ssize_t write_nosigpipe(int fd, const void *buf, size_t len)
+{
+    sigset_t pipe_set;
+    sigset_t old_set;
+    sigset_t pending;
+    bool was_pending = false;
+    struct timespec nowait = { 0 };
+    ssize_t n = 0;
+    int saved_errno = 0;
+
+    (void)sigemptyset(&pipe_set);
+    (void)sigaddset(&pipe_set, SIGPIPE);
+    (void)sigemptyset(&pending);
+    if (sigpending(&pending) == 0) {
+        was_pending = (sigismember(&pending, SIGPIPE) == 1);
+    }
+    (void)pthread_sigmask(SIG_BLOCK, &pipe_set, &old_set);
+
+    do {
+        n = write(fd, buf, len);
+    } while (n < 0 && errno == EINTR);
+    saved_errno = errno;
+
+    if (n < 0 && saved_errno == EPIPE && !was_pending) {
+        while (sigtimedwait(&pipe_set, NULL, &nowait) < 0 && errno == EINTR) {
         }
-        ret = -1;
-        goto err_free_out;
     }
+    (void)pthread_sigmask(SIG_SETMASK, &old_set, NULL);
 
-    if (child_pid == 0) {
-        (void)close(pipe_stdin[1]);
-        pipe_stdin[1] = -1;
-        (void)close(pipe_stdout[0]);
-        pipe_stdout[0] = -1;
+    errno = saved_errno;
+    return n;
+}
 
-        size_t envs_len = 0;
-        envs_len = clibcni_util_array_len((const char * const *)environs);
-        child_fun(plugin_path, pipe_stdin[0], pipe_stdout[1], environs, envs_len);
-        /* exit in child_fun */
+static void write_child_stdin(struct plugin_process *proc)
+{
+    ssize_t n = 0;
+
+    while (proc->stdin_off < proc->stdin_len) {
+        n = write_nosigpipe(proc->stdin_fd, proc->stdin_data + proc->stdin_off, proc->stdin_len - proc->stdin_off);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            /* plugin exited or closed stdin without reading it all, its exit status tells the result */
+            if (errno == EPIPE) {
+                break;
+            }
+            plugin_process_fail(proc, "write stdin data", strerror(errno));
+            break;
+        }
+        proc->stdin_off += (size_t)n;
+    }
+
+    close_process_fd(proc, &proc->stdin_fd);
+}
+
+static void read_child_stdout(struct plugin_process *proc)
+{
+    char buffer[CLIBCNI_BUFFER_SIZE] = { 0 };
+    ssize_t n = 0;
+
+    for (;;) {
+        n = read(proc->stdout_fd, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (n < 0) {
+            plugin_process_fail(proc, "read stdout", strerror(errno));
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+        if (!proc->keep_stdout) {
+            continue;
+        }
+        if ((size_t)n > proc->output_limit - proc->out.len) {
+            plugin_process_fail(proc, "read stdout", "output exceeds limit");
+            break;
+        }
+        if (clibcni_util_buffer_append(&proc->out, buffer, (size_t)n) != 0) {
+            plugin_process_fail(proc, "read stdout", "out of memory");
+            break;
+        }
+    }
+
+    if (n != 0) {
+        /* child may block on write forever, nobody reads its stdout anymore */
+        plugin_process_kill(proc);
+    }
+    close_process_fd(proc, &proc->stdout_fd);
+}
+
+/* return 0 if child is still running */
+static pid_t wait_child(struct plugin_process *proc, int options)
+{
+    pid_t wait_pid = 0;
+
+    do {
+        wait_pid = wait4(proc->pid, &proc->status.wait_status, options, &proc->status.usage);
+    } while (wait_pid < 0 && errno == EINTR);
+
+    if (wait_pid == 0) {
+        return 0;
+    }
+    proc->waited = true;
+    close_process_fd(proc, &proc->pidfd);
+    close_process_fd(proc, &proc->reap_timer);
+    if (wait_pid < 0) {
+        plugin_process_fail(proc, "waitpid", strerror(errno));
+        return wait_pid;
+    }
+    proc->status.reaped = true;
+    return wait_pid;
+}
+
+static int start_reap_timer(struct plugin_process *proc)
+{
+    struct itimerspec its = { 0 };
+    struct epoll_event ev = { 0 };
+
+    proc->reap_timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (proc->reap_timer < 0) {
+        return -1;
+    }
+    its.it_interval.tv_nsec = REAP_POLL_INTERVAL_MS * 1000000L;
+    its.it_value = its.it_interval;
+    if (timerfd_settime(proc->reap_timer, 0, &its, NULL) != 0) {
+        goto err_out;
+    }
+    if (proc->epfd >= 0) {
+        ev.events = EPOLLIN;
+        ev.data.fd = proc->reap_timer;
+        if (epoll_ctl(proc->epfd, EPOLL_CTL_ADD, proc->reap_timer, &ev) != 0) {
+            goto err_out;
+        }
+    }
+    return 0;
+
+err_out:
+    close_fd(&proc->reap_timer);
+    return -1;
+}
+
+static void reap_child(struct plugin_process *proc)
+{
+    uint64_t expirations = 0;
+
+    if (proc->pidfd >= 0) {
+        (void)wait_child(proc, WNOHANG);
+        return;
     }
 
-    (void)close(pipe_stdout[1]);
-    pipe_stdout[1] = -1;
-    (void)close(pipe_stdin[0]);
-    pipe_stdin[0] = -1;
+    /* no pidfd, stdout EOF tells the child is exiting, then poll until it is gone */
+    if (proc->stdout_fd >= 0) {
+        return;
+    }
+    if (proc->reap_timer >= 0) {
+        (void)clibcni_util_read_nointr(proc->reap_timer, &expirations, sizeof(expirations));
+    }
+    if (wait_child(proc, WNOHANG) != 0 || proc->reap_timer >= 0) {
+        return;
+    }
+    if (start_reap_timer(proc) != 0) {
+        /* nothing would wake us up to wait again, a killed child exits soon, so wait for it here */
+        plugin_process_fail(proc, "create reap timer", strerror(errno));
+        plugin_process_kill(proc);
+        (void)wait_child(proc, 0);
+    }
+}
+
+bool plugin_process_progress(struct plugin_process *proc)
+{
+    check_deadline(proc);
+    if (proc->stdin_fd >= 0) {
+        write_child_stdin(proc);
+    }
+    if (proc->stdout_fd >= 0) {
+        read_child_stdout(proc);
+    }
+    if (!proc->waited) {
+        reap_child(proc);
+    }
+    if (!proc->waited) {
+        return false;
+    }
+
+    /* child is gone, take what is left in stdout, but do not wait for processes it left behind */
+    if (proc->stdout_fd >= 0) {
+        read_child_stdout(proc);
+        close_process_fd(proc, &proc->stdout_fd);
+    }
+    close_process_fd(proc, &proc->stdin_fd);
+    return true;
+}
+
+int plugin_process_watch(struct plugin_process *proc, int epfd)
+{
+    struct pollfd fds[PLUGIN_PROCESS_MAX_FDS];
+    struct epoll_event ev;
+    size_t nfds = 0;
+    size_t i = 0;
+
+    nfds = plugin_process_pollfds(proc, fds);
+    for (i = 0; i < nfds; i++) {
+        (void)memset(&ev, 0, sizeof(ev));
+        ev.events = (fds[i].events & POLLOUT) ? EPOLLOUT : EPOLLIN;
+        ev.data.fd = fds[i].fd;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fds[i].fd, &ev) != 0) {
+            ERROR("Add fd to epoll failed: %s", strerror(errno));
+            return -1;
+        }
+    }
+    proc->epfd = epfd;
+    return 0;
+}
+
+size_t plugin_process_pollfds(const struct plugin_process *proc, struct pollfd *fds)
+{
+    size_t nfds = 0;
+
+    if (proc->stdin_fd >= 0) {
+        fds[nfds].fd = proc->stdin_fd;
+        fds[nfds].events = POLLOUT;
+        fds[nfds].revents = 0;
+        nfds++;
+    }
+    if (proc->stdout_fd >= 0) {
+        fds[nfds].fd = proc->stdout_fd;
+        fds[nfds].events = POLLIN;
+        fds[nfds].revents = 0;
+        nfds++;
+    }
+    if (proc->pidfd >= 0 && !proc->waited) {
+        fds[nfds].fd = proc->pidfd;
+        fds[nfds].events = POLLIN;
+        fds[nfds].revents = 0;
+        nfds++;
+    }
+    if (proc->reap_timer >= 0 && !proc->waited) {
+        fds[nfds].fd = proc->reap_timer;
+        fds[nfds].events = POLLIN;
+        fds[nfds].revents = 0;
+        nfds++;
+    }
+    return nfds;
+}
+
+int plugin_process_finish(struct plugin_process *proc, struct plugin_process_status *pstatus, char **stdout_str)
+{
+    int ret = 0;
+
+    close_process_fd(proc, &proc->stdin_fd);
+    close_process_fd(proc, &proc->stdout_fd);
+    close_process_fd(proc, &proc->pidfd);
+    close_process_fd(proc, &proc->reap_timer);
+    if (!proc->waited) {
+        /* the only blocking wait, child is killed first so it does not last */
+        plugin_process_kill(proc);
+        (void)wait_child(proc, 0);
+    }
+
+    if (pstatus != NULL) {
+        *pstatus = proc->status;
+    }
+    if (proc->ret == 0 && stdout_str != NULL && proc->out.len > 0) {
+        *stdout_str = clibcni_util_buffer_steal(&proc->out);
+    }
+    clibcni_util_buffer_free(&proc->out);
+    ret = proc->ret;
+    proc->ret = -1;
+    return ret;
+}
+
+int run_plugin_process(const struct plugin_process_request *req, struct plugin_process_status *pstatus,
+                       char **stdout_str, char *errmsg, size_t errmsg_len)
+{
+    struct plugin_process proc;
+    struct pollfd fds[PLUGIN_PROCESS_MAX_FDS];
+    size_t nfds = 0;
+
+    if (plugin_process_start(req, stdout_str != NULL, &proc, errmsg, errmsg_len) != 0) {
+        return plugin_process_finish(&proc, pstatus, stdout_str);
+    }
+
+    while (!plugin_process_progress(&proc)) {
+        nfds = plugin_process_pollfds(&proc, fds);
+        if (poll(fds, (nfds_t)nfds, plugin_process_timeout_ms(&proc)) < 0 && errno != EINTR) {
+            plugin_process_fail(&proc, "poll", strerror(errno));
+            break;
+        }
+    }
+
+    return plugin_process_finish(&proc, pstatus, stdout_str);
+}
+
+/* turn status of a finished plugin process into return code and cni_exec_error */
+static int raw_exec_result(const char *plugin_path, int ret, const struct plugin_process_status *pstatus,
+                           char **stdout_str, char *errmsg, size_t errmsg_len, cni_exec_error **err)
+{
+    int nret = 0;
+    bool parse_exec_err = false;
+
+    if (pstatus->timed_out) {
+        ERROR("Plugin %s execution timeout: %s", plugin_path, errmsg);
+        ret = INK_ERR_TIMEOUT;
+    } else if (pstatus->reaped) {
+        DEBUG("Plugin %s exit with status: %d, user time: %ld.%06lds, sys time: %ld.%06lds, max rss: %ldKB",
+              plugin_path, pstatus->wait_status, (long)pstatus->usage.ru_utime.tv_sec,
+              (long)pstatus->usage.ru_utime.tv_usec, (long)pstatus->usage.ru_stime.tv_sec,
+              (long)pstatus->usage.ru_stime.tv_usec, pstatus->usage.ru_maxrss);
+        /* deal with exitcode */
+        nret = check_child_exit_status(pstatus, errmsg, errmsg_len, &parse_exec_err);
+        if (nret != 0) {
+            ERROR("Plugin %s exit with error: %s", plugin_path, errmsg);
+            ret = -1;
+        }
+    }
 
-    ret = do_parent_waitpid(pipe_stdin, pipe_stdout, child_pid, errmsg, sizeof(errmsg), stdin_data, stdout_str,
-                            &parse_exec_err);
-err_free_out:
     /* parse error json message */
-    make_err_message(plugin_path, stdout_str, ret, parse_exec_err, errmsg, sizeof(errmsg), err);
+    make_err_message(plugin_path, stdout_str, ret, parse_exec_err, errmsg, errmsg_len, err);
 
     if (ret != 0 && stdout_str != NULL) {
         free(*stdout_str);
         *stdout_str = NULL;
     }
 
-    close_raw_exec_pipes(pipe_stdin, pipe_stdout);
+    return ret;
+}
+
+static int raw_exec(const char *plugin_path, const char *stdin_data, char * const environs[], int64_t deadline,
+                    char **stdout_str, cni_exec_error **err)
+{
+    int ret = 0;
+    char errmsg[CLIBCNI_BUFFER_SIZE] = { 0 };
+    struct plugin_process_status pstatus = { 0 };
+    struct plugin_process_request req = {
+        .plugin_path = plugin_path,
+        .stdin_data = stdin_data,
+        .environs = environs,
+        .output_limit = get_plugin_output_limit(),
+        .deadline = deadline,
+        .use_exec_fd = true,
+    };
+
+    if (get_exec_backend() == CNI_EXEC_BACKEND_HELPER) {
+        ret = exec_helper_run(&req, &pstatus, stdout_str, errmsg, sizeof(errmsg));
+    } else {
+        ret = run_plugin_process(&req, &pstatus, stdout_str, errmsg, sizeof(errmsg));
+    }
+
+    return raw_exec_result(plugin_path, ret, &pstatus, stdout_str, errmsg, sizeof(errmsg), err);
+}
+
+int plugin_exec_start(struct plugin_exec *pexec, const char *plugin_path, const char *cni_net_conf_json,
+                      const struct cni_args *cniargs, int64_t deadline, bool with_result, int epfd, char **err)
+{
+    struct plugin_process_request req = { 0 };
+    bool watch_failed = false;
+    int ret = 0;
+
+    (void)memset(pexec, 0, sizeof(*pexec));
+    pexec->with_result = with_result;
+    if (plugin_path == NULL || cni_net_conf_json == NULL || err == NULL) {
+        ERROR("Invalid arguments");
+        return -1;
+    }
+    if (cniargs != NULL) {
+        pexec->env = as_env(cniargs);
+        if (pexec->env == NULL) {
+            *err = clibcni_util_strdup_s("As env failed");
+            return -1;
+        }
+    }
+    pexec->plugin_path = clibcni_util_strdup_s(plugin_path);
+    pexec->stdin_data = clibcni_util_strdup_s(cni_net_conf_json);
+
+    req.plugin_path = pexec->plugin_path;
+    req.stdin_data = pexec->stdin_data;
+    req.environs = pexec->env != NULL ? pexec->env->envs : NULL;
+    req.output_limit = get_plugin_output_limit();
+    req.deadline = deadline;
+    req.use_exec_fd = true;
+    pexec->by_helper = (get_exec_backend() == CNI_EXEC_BACKEND_HELPER);
+    /* failure of start is reported by plugin_exec_finish, same as a failed run */
+    if (pexec->by_helper) {
+        ret = exec_helper_call_start(&req, &pexec->call, pexec->errmsg, sizeof(pexec->errmsg));
+        if (ret == 0 && epfd >= 0) {
+            ret = exec_helper_call_watch(&pexec->call, epfd);
+            watch_failed = (ret != 0);
+        }
+    } else {
+        ret = plugin_process_start(&req, with_result, &pexec->proc, pexec->errmsg, sizeof(pexec->errmsg));
+        if (ret == 0 && epfd >= 0) {
+            ret = plugin_process_watch(&pexec->proc, epfd);
+            watch_failed = (ret != 0);
+        }
+    }
+    pexec->started = true;
+    if (watch_failed) {
+        *err = clibcni_util_strdup_s("Watch plugin process failed");
+        plugin_exec_release(pexec);
+        return -1;
+    }
+    return 0;
+}
+
+bool plugin_exec_progress(struct plugin_exec *pexec)
+{
+    if (pexec->by_helper) {
+        return exec_helper_call_progress(&pexec->call);
+    }
+    return plugin_process_progress(&pexec->proc);
+}
+
+static int plugin_exec_finish_process(struct plugin_exec *pexec, struct plugin_process_status *pstatus,
+                                      char **stdout_str)
+{
+    if (pexec->by_helper) {
+        return exec_helper_call_finish(&pexec->call, pstatus, stdout_str);
+    }
+    return plugin_process_finish(&pexec->proc, pstatus, stdout_str);
+}
+
+int plugin_exec_finish(struct plugin_exec *pexec, char **raw_result, struct result **result, char **err)
+{
+    int ret = 0;
+    char *stdout_str = NULL;
+    char **pstdout = pexec->with_result ? &stdout_str : NULL;
+    cni_exec_error *e_err = NULL;
+    struct plugin_process_status pstatus = { 0 };
+
+    if (!pexec->started) {
+        return -1;
+    }
+    ret = plugin_exec_finish_process(pexec, &pstatus, pstdout);
+    pexec->started = false;
+    ret = raw_exec_result(pexec->plugin_path, ret, &pstatus, pstdout, pexec->errmsg, sizeof(pexec->errmsg),
+                          &e_err);
+    DEBUG("Raw exec \"%s\" result: %d", pexec->plugin_path, ret);
+    if (pexec->with_result) {
+        ret = do_check_exec_stdout_str(ret, pexec->stdin_data, e_err, &stdout_str, raw_result, result, err);
+    } else {
+        ret = do_parse_exec_err(ret, e_err, err);
+    }
 
+    free(stdout_str);
+    free_cni_exec_error(e_err);
+    plugin_exec_release(pexec);
     return ret;
 }
 
+void plugin_exec_release(struct plugin_exec *pexec)
+{
+    if (pexec->started) {
+        /* kill and reap the plugin if it still runs */
+        (void)plugin_exec_finish_process(pexec, NULL, NULL);
+        pexec->started = false;
+    }
+    free(pexec->plugin_path);
+    pexec->plugin_path = NULL;
+    free(pexec->stdin_data);
+    pexec->stdin_data = NULL;
+    free_cni_env(pexec->env);
+    pexec->env = NULL;
+}
+
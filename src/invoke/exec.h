@@ -16,23 +16,157 @@
 #ifndef CLIBCNI_INVOKE_EXEC_H
 #define CLIBCNI_INVOKE_EXEC_H
 
+#include <stdbool.h>
+#include <stdint.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
 #include "args.h"
 #include "types.h"
 #include "version.h"
+#include "api.h"
+#include "utils.h"
 #include "isula_libutils/cni_exec_error.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+struct plugin_process_request {
+    const char *plugin_path;
+    const char *stdin_data;
+    char * const *environs;
+    /* max bytes of stdout kept, child is killed when it writes more */
+    size_t output_limit;
+    /* monotonic time in milliseconds, child is killed when reached; 0 means no deadline */
+    int64_t deadline;
+    /* exec the binary opened and cached by us, instead of walking plugin_path again */
+    bool use_exec_fd;
+};
+
+struct plugin_process_status {
+    /* child was reaped, wait_status and usage are valid */
+    bool reaped;
+    /* killed because deadline was reached */
+    bool timed_out;
+    int wait_status;
+    struct rusage usage;
+};
+
+/* stdin, stdout and pidfd or reap timer */
+#define PLUGIN_PROCESS_MAX_FDS 3
+
+/* one running plugin, driven by plugin_process_progress whenever one of its fds is ready */
+struct plugin_process {
+    pid_t pid;
+    /* -1 if kernel has no pidfd, then stdout EOF means the child is exiting */
+    int pidfd;
+    /* without pidfd, periodic timer to poll exit of child after its stdout is closed; -1 if none */
+    int reap_timer;
+    int stdin_fd;
+    int stdout_fd;
+    /* epoll set watching fds of process, -1 if none */
+    int epfd;
+    const char *stdin_data;
+    size_t stdin_len;
+    size_t stdin_off;
+    size_t output_limit;
+    /* monotonic time in milliseconds, 0 means no deadline */
+    int64_t deadline;
+    bool keep_stdout;
+    struct clibcni_util_buffer out;
+    /* child reaped or wait failed, nothing left to wait */
+    bool waited;
+    int ret;
+    struct plugin_process_status status;
+    char *errmsg;
+    size_t errmsg_len;
+};
+
+/* one plugin call run by the exec helper, see exec_helper.h */
+struct exec_helper_call {
+    /* stream socket to the worker running plugin, closing it kills the plugin */
+    int conn;
+    /* epoll set watching conn, -1 if none */
+    int epfd;
+    /* encoded request, reused for response once request is sent */
+    struct clibcni_util_buffer msg;
+    size_t msg_off;
+    bool sending;
+    size_t resp_limit;
+    int ret;
+    char *errmsg;
+    size_t errmsg_len;
+};
+
+/* one plugin call of an async operation, by the exec helper when it is the backend */
+struct plugin_exec {
+    char *plugin_path;
+    char *stdin_data;
+    struct cni_env *env;
+    bool with_result;
+    bool started;
+    bool by_helper;
+    struct plugin_process proc;
+    struct exec_helper_call call;
+    char errmsg[CLIBCNI_BUFFER_SIZE];
+};
+
 int exec_plugin_with_result(const char *plugin_path, const char *cni_net_conf_json, const struct cni_args *cniargs,
-                            struct result **ret, char **err);
+                            int64_t deadline, struct result **ret, char **err);
+
+/* raw json of result is returned with the decoded result, both NULL for empty output */
+int exec_plugin_with_raw_result(const char *plugin_path, const char *cni_net_conf_json,
+                                const struct cni_args *cniargs, int64_t deadline, char **raw_result,
+                                struct result **result, char **err);
 
 int exec_plugin_without_result(const char *plugin_path, const char *cni_net_conf_json, const struct cni_args *cniargs,
-                               char **err);
+                               int64_t deadline, char **err);
 
 int raw_get_version_info(const char *plugin_path, struct plugin_info **result, char **err);
 
+int set_exec_backend(enum cni_exec_backend backend);
+
+int start_exec_helper(void);
+
+void set_plugin_output_limit(size_t limit);
+
+int plugin_process_start(const struct plugin_process_request *req, bool keep_stdout, struct plugin_process *proc,
+                         char *errmsg, size_t errmsg_len);
+
+/* move stdin and stdout data and reap the child without blocking, return true when all done */
+bool plugin_process_progress(struct plugin_process *proc);
+
+/* add fds of process to epfd, reap timer is added once armed; they are removed from it when closed */
+int plugin_process_watch(struct plugin_process *proc, int epfd);
+
+/* fill fds, at most PLUGIN_PROCESS_MAX_FDS, to wait on before next progress */
+size_t plugin_process_pollfds(const struct plugin_process *proc, struct pollfd *fds);
+
+/* milliseconds to wait before next progress, -1 means no limit */
+int plugin_process_timeout_ms(const struct plugin_process *proc);
+
+/* kill the whole process group of plugin */
+void plugin_process_kill(struct plugin_process *proc);
+
+/* release everything, kill and reap the child if it still runs; return the result of process */
+int plugin_process_finish(struct plugin_process *proc, struct plugin_process_status *pstatus, char **stdout_str);
+
+int run_plugin_process(const struct plugin_process_request *req, struct plugin_process_status *pstatus,
+                       char **stdout_str, char *errmsg, size_t errmsg_len);
+
+/* start plugin without waiting, fds of plugin are added to epfd if it is not -1 */
+int plugin_exec_start(struct plugin_exec *pexec, const char *plugin_path, const char *cni_net_conf_json,
+                      const struct cni_args *cniargs, int64_t deadline, bool with_result, int epfd, char **err);
+
+bool plugin_exec_progress(struct plugin_exec *pexec);
+
+/* same result as exec_plugin_with_raw_result or exec_plugin_without_result */
+int plugin_exec_finish(struct plugin_exec *pexec, char **raw_result, struct result **result, char **err);
+
+void plugin_exec_release(struct plugin_exec *pexec);
+
 #ifdef __cplusplus
 }
 #endif
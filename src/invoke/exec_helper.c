@@ -0,0 +1,862 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2019. All rights reserved.
+ * clibcni licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: tanyifeng
+ * Create: 2019-04-25
+ * Description: provide exec helper process, which forks plugin runners on behalf of the caller
+ *********************************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+
+#include "exec_helper.h"
+
+#include "utils.h"
+#include "isula_libutils/log.h"
+
+/*
+ * The helper is forked once by exec_helper_start, called early by the caller while it is
+ * still small and single-threaded. For every plugin call the caller sends one end of a
+ * private stream socket to the helper over the control socket, the helper forks a worker
+ * which reads the request from that socket, runs the plugin and writes the response back.
+ * Caller closing its end before the response kills the plugin.
+ *
+ * request:  path, env count, envs, stdin, output limit, deadline
+ * response: ret, reaped, timed out, wait status, rusage, errmsg, stdout
+ * strings are encoded as u32 length + bytes, HELPER_NULL_STRING means NULL.
+ * */
+#define HELPER_NULL_STRING UINT32_MAX
+#define HELPER_MAX_STRING_LEN (64 * MB)
+#define HELPER_MAX_ENVS 4096
+#define HELPER_MAX_REQUEST_LEN (2 * HELPER_MAX_STRING_LEN)
+/* room for status and errmsg of response, besides stdout */
+#define HELPER_RESPONSE_EXTRA (64 * 1024)
+
+static pthread_mutex_t g_helper_lock = PTHREAD_MUTEX_INITIALIZER;
+static pid_t g_helper_pid = -1;
+static int g_helper_sock = -1;
+
+struct helper_request {
+    char *plugin_path;
+    char **envs;
+    uint32_t envs_len;
+    char *stdin_data;
+    uint64_t output_limit;
+    int64_t deadline;
+};
+
+/* decode side of message, all data is in memory */
+struct msg_reader {
+    const char *data;
+    size_t len;
+    size_t off;
+};
+
+static void set_errmsg(char *errmsg, size_t errmsg_len, const char *format, ...)
+{
+    va_list args;
+    int nret = 0;
+
+    va_start(args, format);
+    nret = vsnprintf(errmsg, errmsg_len, format, args);
+    va_end(args);
+    if (nret < 0 || (size_t)nret >= errmsg_len) {
+        ERROR("Sprintf failed");
+    }
+}
+
+static int helper_write_all(int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+    ssize_t n = 0;
+
+    while (len > 0) {
+        n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* read fd until EOF or EAGAIN, return 1 on EOF, 0 on EAGAIN */
+static int read_to_buffer(int fd, struct clibcni_util_buffer *buf, size_t limit)
+{
+    char tmp[CLIBCNI_BUFFER_SIZE];
+    ssize_t n = 0;
+
+    for (;;) {
+        n = clibcni_util_read_nointr(fd, tmp, sizeof(tmp));
+        if (n == 0) {
+            return 1;
+        }
+        if (n < 0) {
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+        if ((size_t)n > limit - buf->len || clibcni_util_buffer_append(buf, tmp, (size_t)n) != 0) {
+            return -1;
+        }
+    }
+}
+
+static int msg_put(struct clibcni_util_buffer *msg, const void *data, size_t size)
+{
+    if (size > HELPER_MAX_STRING_LEN) {
+        return -1;
+    }
+    return clibcni_util_buffer_append(msg, data, size);
+}
+
+static int msg_put_string(struct clibcni_util_buffer *msg, const char *str)
+{
+    uint32_t len = HELPER_NULL_STRING;
+    size_t str_len = 0;
+
+    if (str == NULL) {
+        return msg_put(msg, &len, sizeof(len));
+    }
+    str_len = strlen(str);
+    if (str_len > HELPER_MAX_STRING_LEN) {
+        return -1;
+    }
+    len = (uint32_t)str_len;
+    if (msg_put(msg, &len, sizeof(len)) != 0) {
+        return -1;
+    }
+    return msg_put(msg, str, str_len);
+}
+
+static int msg_get(struct msg_reader *r, void *data, size_t size)
+{
+    if (size > r->len - r->off) {
+        return -1;
+    }
+    (void)memcpy(data, r->data + r->off, size);
+    r->off += size;
+    return 0;
+}
+
+static int msg_get_string(struct msg_reader *r, char **str)
+{
+    uint32_t len = 0;
+    char *tmp = NULL;
+
+    *str = NULL;
+    if (msg_get(r, &len, sizeof(len)) != 0) {
+        return -1;
+    }
+    if (len == HELPER_NULL_STRING) {
+        return 0;
+    }
+    if (len > HELPER_MAX_STRING_LEN) {
+        return -1;
+    }
+    tmp = clibcni_util_common_calloc_s((size_t)len + 1);
+    if (tmp == NULL) {
+        return -1;
+    }
+    if (msg_get(r, tmp, len) != 0) {
+        free(tmp);
+        return -1;
+    }
+    *str = tmp;
+    return 0;
+}
+
+static int encode_request(struct clibcni_util_buffer *msg, const struct plugin_process_request *req)
+{
+    uint32_t envs_len = 0;
+    uint32_t i = 0;
+    uint64_t output_limit = req->output_limit;
+    int64_t deadline = req->deadline;
+
+    while (req->environs != NULL && req->environs[envs_len] != NULL) {
+        envs_len++;
+        if (envs_len > HELPER_MAX_ENVS) {
+            return -1;
+        }
+    }
+
+    if (msg_put_string(msg, req->plugin_path) != 0 || msg_put(msg, &envs_len, sizeof(envs_len)) != 0) {
+        return -1;
+    }
+    for (i = 0; i < envs_len; i++) {
+        if (msg_put_string(msg, req->environs[i]) != 0) {
+            return -1;
+        }
+    }
+    if (msg_put_string(msg, req->stdin_data) != 0) {
+        return -1;
+    }
+    if (msg_put(msg, &output_limit, sizeof(output_limit)) != 0) {
+        return -1;
+    }
+    /* monotonic clock is shared by all processes, deadline can be sent as is */
+    return msg_put(msg, &deadline, sizeof(deadline));
+}
+
+static int decode_request(struct msg_reader *r, struct helper_request *hreq)
+{
+    uint32_t i = 0;
+
+    if (msg_get_string(r, &hreq->plugin_path) != 0 || hreq->plugin_path == NULL ||
+        msg_get(r, &hreq->envs_len, sizeof(hreq->envs_len)) != 0 || hreq->envs_len > HELPER_MAX_ENVS) {
+        hreq->envs_len = 0;
+        return -1;
+    }
+    hreq->envs = clibcni_util_smart_calloc_s((size_t)hreq->envs_len + 1, sizeof(char *));
+    if (hreq->envs == NULL) {
+        return -1;
+    }
+    for (i = 0; i < hreq->envs_len; i++) {
+        if (msg_get_string(r, &hreq->envs[i]) != 0 || hreq->envs[i] == NULL) {
+            return -1;
+        }
+    }
+    if (msg_get_string(r, &hreq->stdin_data) != 0 ||
+        msg_get(r, &hreq->output_limit, sizeof(hreq->output_limit)) != 0 ||
+        msg_get(r, &hreq->deadline, sizeof(hreq->deadline)) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static void free_request(struct helper_request *hreq)
+{
+    uint32_t i = 0;
+
+    free(hreq->plugin_path);
+    for (i = 0; hreq->envs != NULL && i < hreq->envs_len; i++) {
+        free(hreq->envs[i]);
+    }
+    free(hreq->envs);
+    free(hreq->stdin_data);
+}
+
+static int encode_response(struct clibcni_util_buffer *msg, int32_t ret, const struct plugin_process_status *pstatus,
+                           const char *errmsg, const char *stdout_str)
+{
+    uint32_t reaped = pstatus->reaped ? 1 : 0;
+    uint32_t timed_out = pstatus->timed_out ? 1 : 0;
+    int32_t wait_status = pstatus->wait_status;
+
+    if (msg_put(msg, &ret, sizeof(ret)) != 0 || msg_put(msg, &reaped, sizeof(reaped)) != 0 ||
+        msg_put(msg, &timed_out, sizeof(timed_out)) != 0 ||
+        msg_put(msg, &wait_status, sizeof(wait_status)) != 0 ||
+        msg_put(msg, &pstatus->usage, sizeof(pstatus->usage)) != 0) {
+        return -1;
+    }
+    if (msg_put_string(msg, errmsg) != 0) {
+        return -1;
+    }
+    return msg_put_string(msg, stdout_str);
+}
+
+static int decode_response(struct msg_reader *r, struct plugin_process_status *pstatus, char **stdout_str,
+                           char *errmsg, size_t errmsg_len)
+{
+    int32_t ret = 0;
+    uint32_t reaped = 0;
+    uint32_t timed_out = 0;
+    int32_t wait_status = 0;
+    char *child_errmsg = NULL;
+    char *child_stdout = NULL;
+
+    if (msg_get(r, &ret, sizeof(ret)) != 0 || msg_get(r, &reaped, sizeof(reaped)) != 0 ||
+        msg_get(r, &timed_out, sizeof(timed_out)) != 0 || msg_get(r, &wait_status, sizeof(wait_status)) != 0 ||
+        msg_get(r, &pstatus->usage, sizeof(pstatus->usage)) != 0 || msg_get_string(r, &child_errmsg) != 0 ||
+        msg_get_string(r, &child_stdout) != 0) {
+        set_errmsg(errmsg, errmsg_len, "Read response from exec helper failed");
+        free(child_errmsg);
+        return -1;
+    }
+
+    pstatus->reaped = (reaped != 0);
+    pstatus->timed_out = (timed_out != 0);
+    pstatus->wait_status = wait_status;
+    if (child_errmsg != NULL) {
+        set_errmsg(errmsg, errmsg_len, "%s", child_errmsg);
+        free(child_errmsg);
+    }
+    if (stdout_str != NULL) {
+        *stdout_str = child_stdout;
+    } else {
+        free(child_stdout);
+    }
+
+    return ret;
+}
+
+static int send_fd(int sock, int fd)
+{
+    struct msghdr msg = { 0 };
+    struct cmsghdr *cmsg = NULL;
+    char dummy = 0;
+    struct iovec iov = { .iov_base = &dummy, .iov_len = sizeof(dummy) };
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    ssize_t n = 0;
+
+    (void)memset(&control, 0, sizeof(control));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    (void)memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+    do {
+        n = sendmsg(sock, &msg, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+
+    return n == (ssize_t)sizeof(dummy) ? 0 : -1;
+}
+
+/* return -1 when the control socket is closed, -2 when the message carries no fd */
+static int recv_fd(int sock)
+{
+    struct msghdr msg = { 0 };
+    struct cmsghdr *cmsg = NULL;
+    char dummy = 0;
+    struct iovec iov = { .iov_base = &dummy, .iov_len = sizeof(dummy) };
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    ssize_t n = 0;
+    int fd = -1;
+
+    (void)memset(&control, 0, sizeof(control));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    do {
+        n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        return -1;
+    }
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(sizeof(int))) {
+        return -2;
+    }
+    (void)memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    return fd;
+}
+
+static bool parse_fd_name(const char *name, unsigned int *fd)
+{
+    unsigned int val = 0;
+
+    if (*name == '\0') {
+        return false;
+    }
+    for (; *name != '\0'; name++) {
+        if (*name < '0' || *name > '9' || val > (UINT_MAX - 9) / 10) {
+            return false;
+        }
+        val = val * 10 + (unsigned int)(*name - '0');
+    }
+    *fd = val;
+    return true;
+}
+
+/* walk /proc/self/fd with raw getdents64, nothing here may allocate */
+static int close_fds_by_proc(int keep_fd)
+{
+    struct linux_dirent64 {
+        uint64_t d_ino;
+        int64_t d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[];
+    } *entry = NULL;
+    union {
+        struct linux_dirent64 align;
+        char buf[CLIBCNI_BUFFER_SIZE];
+    } dents;
+    unsigned int fd = 0;
+    long n = 0;
+    long off = 0;
+    int dir_fd = -1;
+
+    dir_fd = open("/proc/self/fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0) {
+        return -1;
+    }
+    for (;;) {
+        n = syscall(SYS_getdents64, dir_fd, dents.buf, sizeof(dents.buf));
+        if (n <= 0) {
+            break;
+        }
+        for (off = 0; off < n; off += entry->d_reclen) {
+            entry = (struct linux_dirent64 *)(void *)(dents.buf + off);
+            if (!parse_fd_name(entry->d_name, &fd) || fd < 3 || (int)fd == keep_fd || (int)fd == dir_fd) {
+                continue;
+            }
+            (void)close((int)fd);
+        }
+    }
+    (void)close(dir_fd);
+    return n < 0 ? -1 : 0;
+}
+
+/* runs right after fork, caller may have had other threads, so only async-signal-safe calls */
+static void close_inherited_fds(int keep_fd)
+{
+    long max_fd = 0;
+    long i = 0;
+
+#ifdef SYS_close_range
+    if ((keep_fd <= 3 || syscall(SYS_close_range, 3, (unsigned int)keep_fd - 1, 0) == 0) &&
+        syscall(SYS_close_range, (unsigned int)keep_fd + 1, ~0U, 0) == 0) {
+        return;
+    }
+#endif
+    if (close_fds_by_proc(keep_fd) == 0) {
+        return;
+    }
+    max_fd = sysconf(_SC_OPEN_MAX);
+    for (i = 3; i < max_fd; i++) {
+        if (i != keep_fd) {
+            (void)close((int)i);
+        }
+    }
+}
+
+/* run plugin like run_plugin_process, but give up once caller closed its end of conn */
+static int worker_run_plugin(int conn, const struct plugin_process_request *req,
+                             struct plugin_process_status *pstatus, char **stdout_str, char *errmsg,
+                             size_t errmsg_len)
+{
+    struct plugin_process proc;
+    struct pollfd fds[PLUGIN_PROCESS_MAX_FDS + 1];
+    size_t nfds = 0;
+
+    if (plugin_process_start(req, true, &proc, errmsg, errmsg_len) != 0) {
+        return plugin_process_finish(&proc, pstatus, stdout_str);
+    }
+
+    while (!plugin_process_progress(&proc)) {
+        nfds = plugin_process_pollfds(&proc, fds);
+        /* no events asked, POLLHUP is reported once caller closed conn */
+        fds[nfds].fd = conn;
+        fds[nfds].events = 0;
+        fds[nfds].revents = 0;
+        if (poll(fds, (nfds_t)nfds + 1, plugin_process_timeout_ms(&proc)) < 0 && errno != EINTR) {
+            set_errmsg(errmsg, errmsg_len, "poll failed: %s", strerror(errno));
+            break;
+        }
+        if (fds[nfds].revents != 0) {
+            /* nobody waits for the result, finish kills the plugin */
+            break;
+        }
+    }
+
+    return plugin_process_finish(&proc, pstatus, stdout_str);
+}
+
+/* runs in the worker process, forked by helper for one plugin call */
+static void worker_main(int conn)
+{
+    struct clibcni_util_buffer msg = { 0 };
+    struct msg_reader reader = { 0 };
+    struct helper_request hreq = { 0 };
+    char *stdout_str = NULL;
+    char errmsg[CLIBCNI_BUFFER_SIZE] = { 0 };
+    struct plugin_process_request req = { 0 };
+    struct plugin_process_status pstatus = { 0 };
+    int ret = 0;
+
+    /* caller shuts down its write side after request */
+    if (read_to_buffer(conn, &msg, HELPER_MAX_REQUEST_LEN) != 1) {
+        goto out;
+    }
+    reader.data = msg.data;
+    reader.len = msg.len;
+    if (decode_request(&reader, &hreq) != 0) {
+        goto out;
+    }
+
+    req.plugin_path = hreq.plugin_path;
+    req.stdin_data = hreq.stdin_data;
+    req.environs = hreq.envs;
+    req.output_limit = (size_t)hreq.output_limit;
+    req.deadline = hreq.deadline;
+    ret = worker_run_plugin(conn, &req, &pstatus, &stdout_str, errmsg, sizeof(errmsg));
+
+    msg.len = 0;
+    if (encode_response(&msg, ret, &pstatus, errmsg, stdout_str) == 0) {
+        (void)helper_write_all(conn, msg.data, msg.len);
+    }
+
+out:
+    clibcni_util_buffer_free(&msg);
+    free(stdout_str);
+    free_request(&hreq);
+    (void)close(conn);
+}
+
+/* runs in the helper process, never returns */
+static void helper_main(int ctl_sock)
+{
+    sigset_t mask;
+    pid_t pid = 0;
+    int conn = -1;
+
+    close_inherited_fds(ctl_sock);
+
+    /* workers are never waited, let kernel reap them */
+    (void)signal(SIGCHLD, SIG_IGN);
+    (void)sigemptyset(&mask);
+    (void)sigprocmask(SIG_SETMASK, &mask, NULL);
+
+    for (;;) {
+        conn = recv_fd(ctl_sock);
+        if (conn == -1) {
+            /* caller closed control socket or exited */
+            _exit(0);
+        }
+        if (conn < 0) {
+            continue;
+        }
+
+        pid = fork();
+        if (pid == 0) {
+            (void)close(ctl_sock);
+            (void)signal(SIGCHLD, SIG_DFL);
+            worker_main(conn);
+            _exit(0);
+        }
+        (void)close(conn);
+    }
+}
+
+static int start_helper_locked(void)
+{
+    int sv[2] = { -1, -1 };
+    pid_t pid = 0;
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) != 0) {
+        ERROR("Create exec helper socket failed: %s", strerror(errno));
+        return -1;
+    }
+
+    pid = fork();
+    if (pid < 0) {
+        ERROR("Fork exec helper failed: %s", strerror(errno));
+        (void)close(sv[0]);
+        (void)close(sv[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        helper_main(sv[1]);
+    }
+
+    (void)close(sv[1]);
+    g_helper_pid = pid;
+    g_helper_sock = sv[0];
+    DEBUG("Exec helper started with pid: %d", (int)pid);
+    return 0;
+}
+
+static void stop_helper_locked(void)
+{
+    pid_t ret = 0;
+
+    if (g_helper_sock >= 0) {
+        (void)close(g_helper_sock);
+        g_helper_sock = -1;
+    }
+    if (g_helper_pid <= 0) {
+        return;
+    }
+    /* helper holds no state, in-flight workers keep running on their own */
+    (void)kill(g_helper_pid, SIGKILL);
+    do {
+        ret = waitpid(g_helper_pid, NULL, 0);
+    } while (ret < 0 && errno == EINTR);
+    DEBUG("Exec helper with pid: %d stopped", (int)g_helper_pid);
+    g_helper_pid = -1;
+}
+
+int exec_helper_start(void)
+{
+    int ret = 0;
+
+    (void)pthread_mutex_lock(&g_helper_lock);
+    if (g_helper_pid <= 0) {
+        ret = start_helper_locked();
+    }
+    (void)pthread_mutex_unlock(&g_helper_lock);
+
+    return ret;
+}
+
+bool exec_helper_started(void)
+{
+    bool started = false;
+
+    (void)pthread_mutex_lock(&g_helper_lock);
+    started = (g_helper_pid > 0);
+    (void)pthread_mutex_unlock(&g_helper_lock);
+
+    return started;
+}
+
+static int connect_helper(char *errmsg, size_t errmsg_len)
+{
+    int sv[2] = { -1, -1 };
+    int ret = 0;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0) {
+        set_errmsg(errmsg, errmsg_len, "Create exec helper connection failed: %s", strerror(errno));
+        return -1;
+    }
+    /* only our end, worker reads and writes its end blocking */
+    if (fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL) | O_NONBLOCK) != 0) {
+        set_errmsg(errmsg, errmsg_len, "Set exec helper connection nonblock failed: %s", strerror(errno));
+        (void)close(sv[0]);
+        (void)close(sv[1]);
+        return -1;
+    }
+
+    (void)pthread_mutex_lock(&g_helper_lock);
+    if (g_helper_pid <= 0) {
+        ret = -1;
+    } else if (send_fd(g_helper_sock, sv[1]) != 0) {
+        /* no longer forked from a small process, but better than failing all later calls */
+        WARN("Exec helper with pid: %d is gone, restart it", (int)g_helper_pid);
+        stop_helper_locked();
+        ret = start_helper_locked();
+        if (ret == 0) {
+            ret = send_fd(g_helper_sock, sv[1]);
+        }
+    }
+    (void)pthread_mutex_unlock(&g_helper_lock);
+
+    (void)close(sv[1]);
+    if (ret != 0) {
+        (void)close(sv[0]);
+        set_errmsg(errmsg, errmsg_len, "Send request to exec helper failed");
+        return -1;
+    }
+
+    return sv[0];
+}
+
+static void close_call_conn(struct exec_helper_call *call)
+{
+    if (call->conn < 0) {
+        return;
+    }
+    if (call->epfd >= 0) {
+        (void)epoll_ctl(call->epfd, EPOLL_CTL_DEL, call->conn, NULL);
+    }
+    (void)close(call->conn);
+    call->conn = -1;
+}
+
+static void call_fail(struct exec_helper_call *call, const char *what)
+{
+    set_errmsg(call->errmsg, call->errmsg_len, "%s exec helper failed: %s", what, strerror(errno));
+    call->ret = -1;
+    close_call_conn(call);
+}
+
+int exec_helper_call_start(const struct plugin_process_request *req, struct exec_helper_call *call, char *errmsg,
+                           size_t errmsg_len)
+{
+    (void)memset(call, 0, sizeof(*call));
+    call->conn = -1;
+    call->epfd = -1;
+    call->errmsg = errmsg;
+    call->errmsg_len = errmsg_len;
+    call->resp_limit = req->output_limit + HELPER_RESPONSE_EXTRA;
+    call->ret = -1;
+
+    if (encode_request(&call->msg, req) != 0) {
+        set_errmsg(errmsg, errmsg_len, "Encode exec helper request for %s failed", req->plugin_path);
+        return -1;
+    }
+
+    call->conn = connect_helper(errmsg, errmsg_len);
+    if (call->conn < 0) {
+        return -1;
+    }
+    call->sending = true;
+    call->ret = 0;
+    return 0;
+}
+
+int exec_helper_call_watch(struct exec_helper_call *call, int epfd)
+{
+    struct epoll_event ev = { 0 };
+
+    if (call->conn < 0) {
+        return 0;
+    }
+    ev.events = call->sending ? EPOLLOUT : EPOLLIN;
+    ev.data.fd = call->conn;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, call->conn, &ev) != 0) {
+        ERROR("Add fd to epoll failed: %s", strerror(errno));
+        return -1;
+    }
+    call->epfd = epfd;
+    return 0;
+}
+
+size_t exec_helper_call_pollfds(const struct exec_helper_call *call, struct pollfd *fds)
+{
+    if (call->conn < 0) {
+        return 0;
+    }
+    fds[0].fd = call->conn;
+    fds[0].events = call->sending ? POLLOUT : POLLIN;
+    fds[0].revents = 0;
+    return 1;
+}
+
+static void send_request(struct exec_helper_call *call)
+{
+    struct epoll_event ev = { 0 };
+    ssize_t n = 0;
+
+    while (call->msg_off < call->msg.len) {
+        n = send(call->conn, call->msg.data + call->msg_off, call->msg.len - call->msg_off, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (n < 0) {
+            call_fail(call, "Write request to");
+            return;
+        }
+        call->msg_off += (size_t)n;
+    }
+
+    (void)shutdown(call->conn, SHUT_WR);
+    call->sending = false;
+    /* buffer is reused for response */
+    call->msg.len = 0;
+    if (call->epfd >= 0) {
+        ev.events = EPOLLIN;
+        ev.data.fd = call->conn;
+        if (epoll_ctl(call->epfd, EPOLL_CTL_MOD, call->conn, &ev) != 0) {
+            call_fail(call, "Watch");
+        }
+    }
+}
+
+bool exec_helper_call_progress(struct exec_helper_call *call)
+{
+    int nret = 0;
+
+    if (call->conn >= 0 && call->sending) {
+        send_request(call);
+    }
+    if (call->conn < 0) {
+        return true;
+    }
+    if (call->sending) {
+        return false;
+    }
+
+    nret = read_to_buffer(call->conn, &call->msg, call->resp_limit);
+    if (nret == 0) {
+        return false;
+    }
+    if (nret < 0) {
+        call_fail(call, "Read response from");
+        return true;
+    }
+    close_call_conn(call);
+    return true;
+}
+
+int exec_helper_call_finish(struct exec_helper_call *call, struct plugin_process_status *pstatus, char **stdout_str)
+{
+    struct msg_reader reader = { 0 };
+    int ret = call->ret;
+
+    if (call->conn >= 0) {
+        /* worker kills the plugin once conn is closed */
+        set_errmsg(call->errmsg, call->errmsg_len, "Exec helper call canceled");
+        ret = -1;
+    } else if (ret == 0) {
+        reader.data = call->msg.data;
+        reader.len = call->msg.len;
+        ret = decode_response(&reader, pstatus, stdout_str, call->errmsg, call->errmsg_len);
+    }
+    close_call_conn(call);
+    clibcni_util_buffer_free(&call->msg);
+    call->ret = -1;
+    return ret;
+}
+
+int exec_helper_run(const struct plugin_process_request *req, struct plugin_process_status *pstatus,
+                    char **stdout_str, char *errmsg, size_t errmsg_len)
+{
+    struct exec_helper_call call;
+    struct pollfd fds[1];
+    size_t nfds = 0;
+
+    if (req == NULL || req->plugin_path == NULL || pstatus == NULL || errmsg == NULL) {
+        return -1;
+    }
+
+    if (exec_helper_call_start(req, &call, errmsg, errmsg_len) != 0) {
+        return exec_helper_call_finish(&call, pstatus, stdout_str);
+    }
+    /* worker enforces the deadline and always answers, so wait without timeout */
+    while (!exec_helper_call_progress(&call)) {
+        nfds = exec_helper_call_pollfds(&call, fds);
+        if (poll(fds, (nfds_t)nfds, -1) < 0 && errno != EINTR) {
+            call_fail(&call, "Poll");
+            break;
+        }
+    }
+
+    return exec_helper_call_finish(&call, pstatus, stdout_str);
+}
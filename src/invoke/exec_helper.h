@@ -0,0 +1,57 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2019. All rights reserved.
+ * clibcni licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: tanyifeng
+ * Create: 2019-04-25
+ * Description: provide exec helper process definition
+ ********************************************************************************/
+
+#ifndef CLIBCNI_INVOKE_EXEC_HELPER_H
+#define CLIBCNI_INVOKE_EXEC_HELPER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <poll.h>
+
+#include "exec.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* fork the helper, call it before the process grows and starts threads */
+int exec_helper_start(void);
+
+bool exec_helper_started(void);
+
+/* run one plugin by the helper, blocks until it is done */
+int exec_helper_run(const struct plugin_process_request *req, struct plugin_process_status *pstatus,
+                    char **stdout_str, char *errmsg, size_t errmsg_len);
+
+/* same as exec_helper_run, but driven without blocking like plugin_process */
+int exec_helper_call_start(const struct plugin_process_request *req, struct exec_helper_call *call, char *errmsg,
+                           size_t errmsg_len);
+
+int exec_helper_call_watch(struct exec_helper_call *call, int epfd);
+
+/* fill fds, at most one, to wait on before next progress */
+size_t exec_helper_call_pollfds(const struct exec_helper_call *call, struct pollfd *fds);
+
+/* return true when response is read or call failed */
+bool exec_helper_call_progress(struct exec_helper_call *call);
+
+/* release the call, plugin is killed by worker if call is not done yet */
+int exec_helper_call_finish(struct exec_helper_call *call, struct plugin_process_status *pstatus, char **stdout_str);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -21,7 +21,8 @@
  * [ 1 .... ] are errors return by call syscall.
  * */
 enum InvokeErrCode {
-    INK_ERR_MIN = -5,
+    INK_ERR_MIN = -6,
+    INK_ERR_TIMEOUT, // same as CNI_ERR_TIMEOUT of api
     INK_ERR_INVALID_ARG, // invalid arguments
     INK_ERR_SPRINT_FAILED,
     INK_ERR_TERM_BY_SIG,
@@ -20,10 +20,12 @@
 #include <string.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <pthread.h>
 #include <linux/limits.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <sys/inotify.h>
 
 #include "utils.h"
 #include "invoke_errno.h"
@@ -31,6 +33,7 @@
 
 const char * const g_CNI_INVOKE_ERR_MSGS[] = {
     "Invalid ERROR code",
+    "Plugin execution timeout",
     "Invalid invoke argument",
     "Call sprintf_s failed",
     "Terminal by signal",
@@ -78,6 +81,291 @@ static int do_check_file(const char *plugin, const char *path, char **find_path,
     }
 }
 
+#define PATH_CACHE_BUCKETS 64
+#define PATH_CACHE_MAX_ENTRIES 1024
+#define PATH_CACHE_WATCH_EVENTS (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | \
+                                 IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF)
+
+/* result of find_in_path for one plugin and one paths vector, find_path NULL is a miss */
+struct path_cache_entry {
+    char *key;
+    size_t key_len;
+    unsigned int hash;
+    char *find_path;
+    int save_errno;
+    struct path_cache_entry *next;
+};
+
+/*
+ * entries are dropped as soon as anything changes in one of the watched bin dirs;
+ * without inotify nothing is cached
+ * */
+struct path_cache {
+    pthread_mutex_t lock;
+    bool inited;
+    int inotify_fd;
+    /* bumped by every flush, a lookup started before it is not cached */
+    unsigned long generation;
+    size_t entries;
+    struct path_cache_entry *buckets[PATH_CACHE_BUCKETS];
+};
+
+static struct path_cache g_path_cache = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .inotify_fd = -1,
+};
+
+static unsigned int path_cache_hash(const char *key, size_t len)
+{
+    unsigned int hash = 2166136261U;
+    size_t i = 0;
+
+    for (i = 0; i < len; i++) {
+        hash ^= (unsigned char)key[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+/* plugin and all paths separated by '\0', so no path can be confused with another split */
+static char *path_cache_key(const char *plugin, const char * const *paths, size_t len, size_t *key_len)
+{
+    struct clibcni_util_buffer buf = { 0 };
+    size_t i = 0;
+
+    if (clibcni_util_buffer_append(&buf, plugin, strlen(plugin) + 1) != 0) {
+        goto err_out;
+    }
+    for (i = 0; i < len; i++) {
+        if (paths[i] == NULL || clibcni_util_buffer_append(&buf, paths[i], strlen(paths[i]) + 1) != 0) {
+            goto err_out;
+        }
+    }
+    *key_len = buf.len;
+    return clibcni_util_buffer_steal(&buf);
+
+err_out:
+    clibcni_util_buffer_free(&buf);
+    return NULL;
+}
+
+static void free_path_cache_entry(struct path_cache_entry *entry)
+{
+    free(entry->key);
+    free(entry->find_path);
+    free(entry);
+}
+
+static void path_cache_flush_locked(void)
+{
+    struct path_cache_entry *entry = NULL;
+    size_t i = 0;
+
+    for (i = 0; i < PATH_CACHE_BUCKETS; i++) {
+        while (g_path_cache.buckets[i] != NULL) {
+            entry = g_path_cache.buckets[i];
+            g_path_cache.buckets[i] = entry->next;
+            free_path_cache_entry(entry);
+        }
+    }
+    g_path_cache.entries = 0;
+    g_path_cache.generation++;
+}
+
+static bool path_cache_enabled_locked(void)
+{
+    if (!g_path_cache.inited) {
+        g_path_cache.inited = true;
+        g_path_cache.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (g_path_cache.inotify_fd < 0) {
+            WARN("Init inotify failed: %s, plugin paths will not be cached", strerror(errno));
+        }
+    }
+    return g_path_cache.inotify_fd >= 0;
+}
+
+/* any event of watched dirs, or lost events, flushes all entries */
+static void path_cache_drain_events_locked(void)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool changed = false;
+    ssize_t len = 0;
+
+    for (;;) {
+        len = read(g_path_cache.inotify_fd, buf, sizeof(buf));
+        if (len > 0) {
+            changed = true;
+            continue;
+        }
+        if (len < 0 && errno == EINTR) {
+            continue;
+        }
+        break;
+    }
+    if (changed) {
+        DEBUG("Plugin dirs changed, flush plugin path cache");
+        path_cache_flush_locked();
+    }
+}
+
+static bool path_cache_watch_locked(const char * const *paths, size_t len)
+{
+    size_t i = 0;
+
+    for (i = 0; i < len; i++) {
+        /* watch of same dir is reused by kernel */
+        if (inotify_add_watch(g_path_cache.inotify_fd, paths[i], PATH_CACHE_WATCH_EVENTS) < 0) {
+            DEBUG("Watch plugin dir %s failed: %s", paths[i], strerror(errno));
+            return false;
+        }
+    }
+    return true;
+}
+
+static struct path_cache_entry *path_cache_find_locked(const char *key, size_t key_len, unsigned int hash)
+{
+    struct path_cache_entry *entry = NULL;
+
+    for (entry = g_path_cache.buckets[hash % PATH_CACHE_BUCKETS]; entry != NULL; entry = entry->next) {
+        if (entry->hash == hash && entry->key_len == key_len && memcmp(entry->key, key, key_len) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void path_cache_insert_locked(char *key, size_t key_len, unsigned int hash, const char *find_path,
+                                     int save_errno)
+{
+    struct path_cache_entry *entry = NULL;
+    size_t idx = hash % PATH_CACHE_BUCKETS;
+
+    if (g_path_cache.entries >= PATH_CACHE_MAX_ENTRIES) {
+        path_cache_flush_locked();
+    }
+    entry = clibcni_util_common_calloc_s(sizeof(struct path_cache_entry));
+    if (entry == NULL) {
+        free(key);
+        return;
+    }
+    entry->key = key;
+    entry->key_len = key_len;
+    entry->hash = hash;
+    entry->find_path = clibcni_util_strdup_s(find_path);
+    entry->save_errno = save_errno;
+    entry->next = g_path_cache.buckets[idx];
+    g_path_cache.buckets[idx] = entry;
+    g_path_cache.entries++;
+}
+
+bool plugin_path_cache_watch(const char *dir)
+{
+    bool watched = false;
+
+    (void)pthread_mutex_lock(&g_path_cache.lock);
+    if (path_cache_enabled_locked()) {
+        watched = path_cache_watch_locked(&dir, 1);
+    }
+    (void)pthread_mutex_unlock(&g_path_cache.lock);
+    return watched;
+}
+
+unsigned long plugin_path_cache_generation(void)
+{
+    unsigned long generation = 0;
+
+    (void)pthread_mutex_lock(&g_path_cache.lock);
+    if (path_cache_enabled_locked()) {
+        path_cache_drain_events_locked();
+    }
+    generation = g_path_cache.generation;
+    (void)pthread_mutex_unlock(&g_path_cache.lock);
+    return generation;
+}
+
+static int do_find_in_path(const char *plugin, const char * const *paths, size_t len, char **find_path,
+                           int *save_errno)
+{
+    size_t i = 0;
+
+    for (i = 0; i < len; i++) {
+        if (do_check_file(plugin, paths[i], find_path, save_errno) == 0) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* return 0 when lookup is answered by cache, *ret is set to result of the cached lookup */
+static int path_cache_lookup(const char *key, size_t key_len, unsigned int hash, char **find_path,
+                             int *save_errno, int *ret)
+{
+    struct path_cache_entry *entry = NULL;
+
+    entry = path_cache_find_locked(key, key_len, hash);
+    if (entry == NULL) {
+        return -1;
+    }
+    *save_errno = entry->save_errno;
+    if (entry->find_path == NULL) {
+        *ret = -1;
+    } else {
+        *find_path = clibcni_util_strdup_s(entry->find_path);
+        *ret = 0;
+    }
+    return 0;
+}
+
+static int cached_find_in_path(const char *plugin, const char * const *paths, size_t len, char **find_path,
+                               int *save_errno)
+{
+    char *key = NULL;
+    size_t key_len = 0;
+    unsigned int hash = 0;
+    unsigned long generation = 0;
+    bool cacheable = false;
+    int ret = -1;
+
+    key = path_cache_key(plugin, paths, len, &key_len);
+    if (key == NULL) {
+        return do_find_in_path(plugin, paths, len, find_path, save_errno);
+    }
+    hash = path_cache_hash(key, key_len);
+
+    (void)pthread_mutex_lock(&g_path_cache.lock);
+    if (path_cache_enabled_locked()) {
+        path_cache_drain_events_locked();
+        if (path_cache_lookup(key, key_len, hash, find_path, save_errno, &ret) == 0) {
+            (void)pthread_mutex_unlock(&g_path_cache.lock);
+            free(key);
+            return ret;
+        }
+        /* watch before stat, so that a change during lookup is not lost */
+        cacheable = path_cache_watch_locked(paths, len);
+    }
+    generation = g_path_cache.generation;
+    (void)pthread_mutex_unlock(&g_path_cache.lock);
+
+    ret = do_find_in_path(plugin, paths, len, find_path, save_errno);
+    /* only a missing file is a stable result worth caching */
+    if (ret != 0 && *save_errno != ENOENT) {
+        cacheable = false;
+    }
+
+    if (cacheable) {
+        (void)pthread_mutex_lock(&g_path_cache.lock);
+        path_cache_drain_events_locked();
+        if (generation == g_path_cache.generation &&
+            path_cache_find_locked(key, key_len, hash) == NULL) {
+            path_cache_insert_locked(key, key_len, hash, ret == 0 ? *find_path : NULL, *save_errno);
+            key = NULL;
+        }
+        (void)pthread_mutex_unlock(&g_path_cache.lock);
+    }
+    free(key);
+    return ret;
+}
+
 static inline bool check_find_in_path_args(const char *plugin, const char * const *paths, size_t len,
                                            char * const *find_path)
 {
@@ -87,19 +375,12 @@ static inline bool check_find_in_path_args(const char *plugin, const char * cons
 int find_in_path(const char *plugin, const char * const *paths, size_t len, char **find_path, int *save_errno)
 {
     int ret = -1;
-    size_t i = 0;
 
     if (check_find_in_path_args(plugin, paths, len, find_path)) {
         ERROR("Invalid arguments");
         return -1;
     }
-    for (i = 0; i < len; i++) {
-        if (do_check_file(plugin, paths[i], find_path, save_errno) == 0) {
-            ret = 0;
-            break;
-        }
-    }
-
+    ret = cached_find_in_path(plugin, paths, len, find_path, save_errno);
     if (ret != 0) {
         ERROR("Can not find plugin: %s", plugin);
     }
@@ -107,3 +388,160 @@ int find_in_path(const char *plugin, const char * const *paths, size_t len, char
     return ret;
 }
 
+
+#define EXEC_FD_CACHE_MAX_ENTRIES 128
+
+/* opened plugin binary, valid while its dir has no change or its inode and mtime stay the same */
+struct exec_fd_entry {
+    char *path;
+    int fd;
+    /* scripts can not be started from a close-on-exec fd */
+    bool is_script;
+    /* dir is watched by path cache, so generation tells about changes */
+    bool watched;
+    unsigned long generation;
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;
+    struct exec_fd_entry *next;
+};
+
+static pthread_mutex_t g_exec_fd_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct exec_fd_entry *g_exec_fds = NULL;
+static size_t g_exec_fds_len = 0;
+
+static void free_exec_fd_entry(struct exec_fd_entry *entry)
+{
+    if (entry->fd >= 0) {
+        (void)close(entry->fd);
+    }
+    free(entry->path);
+    free(entry);
+}
+
+static void exec_fd_flush_locked(void)
+{
+    struct exec_fd_entry *entry = NULL;
+
+    while (g_exec_fds != NULL) {
+        entry = g_exec_fds;
+        g_exec_fds = entry->next;
+        free_exec_fd_entry(entry);
+    }
+    g_exec_fds_len = 0;
+}
+
+static bool same_file(const struct exec_fd_entry *entry, const struct stat *st)
+{
+    return entry->dev == st->st_dev && entry->ino == st->st_ino && entry->mtime.tv_sec == st->st_mtim.tv_sec &&
+           entry->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+static bool exec_fd_entry_valid(const struct exec_fd_entry *entry, unsigned long generation)
+{
+    struct stat st = { 0 };
+
+    if (entry->watched) {
+        return entry->generation == generation;
+    }
+    return stat(entry->path, &st) == 0 && same_file(entry, &st);
+}
+
+static bool is_script_fd(int fd)
+{
+    char magic[2] = { 0 };
+
+    return pread(fd, magic, sizeof(magic), 0) == (ssize_t)sizeof(magic) && magic[0] == '#' && magic[1] == '!';
+}
+
+static struct exec_fd_entry *new_exec_fd_entry(const char *plugin_path, unsigned long generation)
+{
+    struct exec_fd_entry *entry = NULL;
+    struct stat st = { 0 };
+    char *dir = NULL;
+    char *slash = NULL;
+
+    entry = clibcni_util_common_calloc_s(sizeof(struct exec_fd_entry));
+    if (entry == NULL) {
+        return NULL;
+    }
+    entry->path = clibcni_util_strdup_s(plugin_path);
+    entry->generation = generation;
+    /* watch before open, so that a replace after open is seen */
+    dir = clibcni_util_strdup_s(plugin_path);
+    slash = strrchr(dir, '/');
+    if (slash != NULL) {
+        *(slash == dir ? slash + 1 : slash) = '\0';
+        entry->watched = plugin_path_cache_watch(dir);
+    }
+    free(dir);
+
+    entry->fd = open(plugin_path, O_RDONLY | O_CLOEXEC);
+    if (entry->fd < 0 || fstat(entry->fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        DEBUG("Open plugin %s for exec failed: %s", plugin_path, strerror(errno));
+        free_exec_fd_entry(entry);
+        return NULL;
+    }
+    entry->dev = st.st_dev;
+    entry->ino = st.st_ino;
+    entry->mtime = st.st_mtim;
+    entry->is_script = is_script_fd(entry->fd);
+    return entry;
+}
+
+int get_plugin_exec_fd(const char *plugin_path)
+{
+    struct exec_fd_entry *entry = NULL;
+    struct exec_fd_entry **pos = NULL;
+    unsigned long generation = 0;
+    int fd = -1;
+
+    if (plugin_path == NULL) {
+        return -1;
+    }
+    generation = plugin_path_cache_generation();
+
+    (void)pthread_mutex_lock(&g_exec_fd_lock);
+    for (pos = &g_exec_fds; *pos != NULL; pos = &(*pos)->next) {
+        if (strcmp((*pos)->path, plugin_path) != 0) {
+            continue;
+        }
+        entry = *pos;
+        if (!exec_fd_entry_valid(entry, generation)) {
+            *pos = entry->next;
+            free_exec_fd_entry(entry);
+            g_exec_fds_len--;
+            entry = NULL;
+        }
+        break;
+    }
+    if (entry == NULL) {
+        if (g_exec_fds_len >= EXEC_FD_CACHE_MAX_ENTRIES) {
+            exec_fd_flush_locked();
+        }
+        entry = new_exec_fd_entry(plugin_path, generation);
+        if (entry != NULL) {
+            entry->next = g_exec_fds;
+            g_exec_fds = entry;
+            g_exec_fds_len++;
+        }
+    }
+    /* caller owns a dup, so that an entry dropped by other thread can not close fd in use */
+    if (entry != NULL && !entry->is_script) {
+        fd = fcntl(entry->fd, F_DUPFD_CLOEXEC, 0);
+    }
+    (void)pthread_mutex_unlock(&g_exec_fd_lock);
+
+    return fd;
+}
+
+void flush_plugin_path_cache(void)
+{
+    (void)pthread_mutex_lock(&g_path_cache.lock);
+    path_cache_flush_locked();
+    (void)pthread_mutex_unlock(&g_path_cache.lock);
+
+    (void)pthread_mutex_lock(&g_exec_fd_lock);
+    exec_fd_flush_locked();
+    (void)pthread_mutex_unlock(&g_exec_fd_lock);
+}
@@ -15,6 +15,9 @@
 #ifndef CLIBCNI_INVOKE_TOOLS_H
 #define CLIBCNI_INVOKE_TOOLS_H
 
+#include <stdbool.h>
+#include <stddef.h>
+
 #include "isula_libutils/cni_exec_error.h"
 
 #ifdef __cplusplus
@@ -23,6 +26,15 @@ extern "C" {
 
 int find_in_path(const char *plugin, const char * const *paths, size_t len, char **find_path, int *save_errno);
 
+void flush_plugin_path_cache(void);
+
+bool plugin_path_cache_watch(const char *dir);
+
+unsigned long plugin_path_cache_generation(void);
+
+/* dup of cached fd to exec plugin from, -1 when plugin must be started by its path */
+int get_plugin_exec_fd(const char *plugin_path);
+
 #ifdef __cplusplus
 }
 #endif
@@ -18,35 +18,15 @@
 #include "current.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <yajl/yajl_parse.h>
 
 #include "utils.h"
 #include "isula_libutils/log.h"
 
-static struct result *get_result(const cni_result_curr *curr_result, char **err);
-
-static cni_result_curr *new_curr_result_helper(const char *json_data, char **err)
-{
-    cni_result_curr *result = NULL;
-    parser_error errmsg = NULL;
-
-    if (json_data == NULL) {
-        ERROR("Json data is NULL");
-        return NULL;
-    }
-    result = cni_result_curr_parse_data(json_data, NULL, &errmsg);
-    if (result == NULL) {
-        if (asprintf(err, "parse json failed: %s", errmsg) < 0) {
-            *err = clibcni_util_strdup_s("Out of memory");
-        }
-        ERROR("Parse failed: %s", errmsg);
-        goto free_out;
-    }
-    return result;
-
-free_out:
-    free(errmsg);
-    return NULL;
-}
+static struct result *decode_curr_result(const char *json_data, char **err);
 
 static void do_append_result_errmsg(const struct result *ret, const char *save_err, char **err)
 {
@@ -69,306 +49,720 @@ static void do_append_result_errmsg(const struct result *ret, const char *save_e
 
 struct result *new_curr_result(const char *json_data, char **err)
 {
-    struct result *ret = NULL;
-    cni_result_curr *tmp_result = NULL;
-    char *save_err = NULL;
-
     if (err == NULL) {
         ERROR("Invalid argument");
         return NULL;
     }
-    tmp_result = new_curr_result_helper(json_data, err);
-    if (tmp_result == NULL) {
+    if (json_data == NULL) {
+        ERROR("Json data is NULL");
         return NULL;
     }
-    if (*err != NULL) {
-        save_err = *err;
-        *err = NULL;
-    }
-    ret = get_result(tmp_result, err);
-    do_append_result_errmsg(ret, save_err, err);
 
-    free_cni_result_curr(tmp_result);
-    free(save_err);
-    return ret;
+    return decode_curr_result(json_data, err);
 }
 
-static struct interface *convert_curr_interface(const cni_network_interface *curr_interface)
+/* same decoding and checks as new_curr_result, the decoded result is dropped */
+int check_curr_result(const char *json_data, char **err)
 {
-    struct interface *result = NULL;
+    struct result *tmp_result = NULL;
 
-    if (curr_interface == NULL) {
-        ERROR("Invalid argument");
-        return NULL;
+    tmp_result = new_curr_result(json_data, err);
+    if (tmp_result == NULL) {
+        return -1;
     }
+    free_result(tmp_result);
+    return 0;
+}
 
-    result = clibcni_util_common_calloc_s(sizeof(struct interface));
-    if (result == NULL) {
-        ERROR("Out of memory");
-        return NULL;
+enum result_decode_scope {
+    DECODE_NONE = 0,
+    DECODE_TOP,
+    DECODE_INTERFACES,
+    DECODE_INTERFACE,
+    DECODE_IPS,
+    DECODE_IP,
+    DECODE_ROUTES,
+    DECODE_ROUTE,
+    DECODE_DNS,
+    DECODE_DNS_LIST,
+    DECODE_DONE,
+};
+
+enum result_decode_member {
+    MEMBER_UNKNOWN = 0,
+    MEMBER_CNIVERSION,
+    MEMBER_INTERFACES,
+    MEMBER_IPS,
+    MEMBER_ROUTES,
+    MEMBER_DNS,
+    MEMBER_NAME,
+    MEMBER_MAC,
+    MEMBER_SANDBOX,
+    MEMBER_VERSION,
+    MEMBER_INTERFACE,
+    MEMBER_ADDRESS,
+    MEMBER_GATEWAY,
+    MEMBER_DST,
+    MEMBER_GW,
+    MEMBER_NAMESERVERS,
+    MEMBER_DOMAIN,
+    MEMBER_SEARCH,
+    MEMBER_OPTIONS,
+};
+
+static const struct {
+    int scope;
+    const char *key;
+    int member;
+} g_result_members[] = {
+    { DECODE_TOP, "cniVersion", MEMBER_CNIVERSION },
+    { DECODE_TOP, "interfaces", MEMBER_INTERFACES },
+    { DECODE_TOP, "ips", MEMBER_IPS },
+    { DECODE_TOP, "routes", MEMBER_ROUTES },
+    { DECODE_TOP, "dns", MEMBER_DNS },
+    { DECODE_INTERFACE, "name", MEMBER_NAME },
+    { DECODE_INTERFACE, "mac", MEMBER_MAC },
+    { DECODE_INTERFACE, "sandbox", MEMBER_SANDBOX },
+    { DECODE_IP, "version", MEMBER_VERSION },
+    { DECODE_IP, "interface", MEMBER_INTERFACE },
+    { DECODE_IP, "address", MEMBER_ADDRESS },
+    { DECODE_IP, "gateway", MEMBER_GATEWAY },
+    { DECODE_ROUTE, "dst", MEMBER_DST },
+    { DECODE_ROUTE, "gw", MEMBER_GW },
+    { DECODE_DNS, "nameservers", MEMBER_NAMESERVERS },
+    { DECODE_DNS, "domain", MEMBER_DOMAIN },
+    { DECODE_DNS, "search", MEMBER_SEARCH },
+    { DECODE_DNS, "options", MEMBER_OPTIONS },
+};
+
+/*
+ * decode result json of plugin straight into struct result by yajl callbacks: unknown
+ * members and members with unexpected type are skipped, the first of repeated keys wins,
+ * array items of unexpected type become empty items; value of skipped member is tracked
+ * by skip depth
+ * */
+struct result_decoder {
+    struct result *value;
+    size_t interfaces_cap;
+    size_t ips_cap;
+    size_t routes_cap;
+
+    int scope;
+    int member;
+    size_t skip;
+
+    /* bits of members already seen in the top object, current item and dns */
+    uint32_t top_seen;
+    uint32_t item_seen;
+    uint32_t dns_seen;
+
+    /* dns string list being filled */
+    char ***list;
+    size_t *list_len;
+    size_t list_cap;
+
+    char *err;
+};
+
+static int decoder_fail(struct result_decoder *d, const char *msg)
+{
+    if (d->err == NULL) {
+        d->err = clibcni_util_strdup_s(msg);
     }
-
-    result->name = clibcni_util_strdup_s(curr_interface->name);
-    result->mac = clibcni_util_strdup_s(curr_interface->mac);
-    result->sandbox = clibcni_util_strdup_s(curr_interface->sandbox);
-    return result;
+    ERROR("Decode result failed: %s", msg);
+    return 0;
 }
 
-static int do_parse_ipnet(const char *cidr_str, const char *ip_str, uint8_t **ip, size_t *ip_len,
-                          struct ipnet **ipnet_val, char **err)
+static void *grow_pointer_array(void *items, size_t len, size_t *cap)
 {
-    int ret = 0;
+    void *grown = NULL;
+    size_t new_cap = 0;
 
-    ret = parse_cidr(cidr_str, ipnet_val, err);
-    if (ret != 0) {
-        ERROR("Parse cidr failed: %s", *err != NULL ? *err : "");
-        return -1;
+    if (len < *cap) {
+        return items;
     }
-    if (ip_str == NULL) {
-        return 0;
+    if (*cap > (SIZE_MAX / sizeof(void *)) / 2) {
+        return NULL;
     }
-    ret = parse_ip_from_str(ip_str, ip, ip_len, err);
-    if (ret != 0) {
-        ERROR("Parse ip failed: %s", *err != NULL ? *err : "");
-        free_ipnet_type(*ipnet_val);
-        *ipnet_val = NULL;
-        return -1;
+    new_cap = *cap > 0 ? *cap * 2 : 4;
+    grown = clibcni_util_smart_calloc_s(new_cap, sizeof(void *));
+    if (grown == NULL) {
+        return NULL;
     }
-    return 0;
+    if (len > 0) {
+        (void)memcpy(grown, items, len * sizeof(void *));
+    }
+    free(items);
+    *cap = new_cap;
+    return grown;
 }
 
-static struct ipconfig *convert_curr_ipconfig(const cni_network_ipconfig *curr_ipconfig, char **err)
+static char *decoder_strdup(const unsigned char *str, size_t len)
 {
-    struct ipconfig *result = NULL;
-    struct ipnet *ipnet_val = NULL;
-    int ret = 0;
-    uint8_t *gateway = NULL;
-    size_t gateway_len = 0;
+    char *dst = NULL;
 
-    if (curr_ipconfig == NULL) {
-        ERROR("Invalid argument");
+    if (len == SIZE_MAX) {
         return NULL;
     }
-
-    result = clibcni_util_common_calloc_s(sizeof(struct ipconfig));
-    if (result == NULL) {
-        ERROR("Out of memory");
-        *err = clibcni_util_strdup_s("Out of memory");
+    dst = clibcni_util_common_calloc_s(len + 1);
+    if (dst == NULL) {
         return NULL;
     }
-    /* parse address to ipnet */
-    ret = do_parse_ipnet(curr_ipconfig->address, curr_ipconfig->gateway, &gateway, &gateway_len, &ipnet_val, err);
-    if (ret != 0) {
-        goto err_out;
+    (void)memcpy(dst, str, len);
+    return dst;
+}
+
+static int decoder_set_string(struct result_decoder *d, char **dst, const unsigned char *str, size_t len)
+{
+    char *tmp = decoder_strdup(str, len);
+
+    if (tmp == NULL) {
+        return decoder_fail(d, "Out of memory");
     }
-    result->address = ipnet_val;
-    result->gateway = gateway;
-    result->gateway_len = gateway_len;
-    result->version = clibcni_util_strdup_s(curr_ipconfig->version);
+    free(*dst);
+    *dst = tmp;
+    return 1;
+}
 
-    if (curr_ipconfig->interface != NULL) {
-        result->interface = clibcni_util_common_calloc_s(sizeof(int32_t));
-        if (result->interface == NULL) {
-            ERROR("Out of memory");
-            *err = clibcni_util_strdup_s("Out of memory");
-            goto err_out;
-        }
-        *(result->interface) = *(curr_ipconfig->interface);
+/* ip text is copied to a terminated stack buffer, longer text cannot be an address */
+static int decoder_set_ipnet(struct result_decoder *d, struct ipnet **dst, const unsigned char *str, size_t len)
+{
+    char buf[IPNET_STRING_BUF_LEN] = { 0 };
+    struct ipnet *tmp = NULL;
+    char *err = NULL;
+
+    if (len >= sizeof(buf)) {
+        return decoder_fail(d, "Parse cidr failed: too long address");
+    }
+    (void)memcpy(buf, str, len);
+    if (parse_cidr(buf, &tmp, &err) != 0) {
+        ERROR("Parse cidr failed: %s", err != NULL ? err : "");
+        free(d->err);
+        d->err = err != NULL ? err : clibcni_util_strdup_s("Parse cidr failed");
+        return 0;
     }
+    free_ipnet_type(*dst);
+    *dst = tmp;
+    return 1;
+}
 
-    return result;
+static int decoder_set_ip(struct result_decoder *d, uint8_t **dst, size_t *dst_len, const unsigned char *str,
+                          size_t len)
+{
+    char buf[IP_STRING_BUF_LEN * 2] = { 0 };
+    uint8_t *tmp = NULL;
+    size_t tmp_len = 0;
+    char *err = NULL;
+
+    if (len >= sizeof(buf)) {
+        return decoder_fail(d, "Parse ip failed: too long address");
+    }
+    (void)memcpy(buf, str, len);
+    if (parse_ip_from_str(buf, &tmp, &tmp_len, &err) != 0) {
+        ERROR("Parse ip failed: %s", err != NULL ? err : "");
+        free(d->err);
+        d->err = err != NULL ? err : clibcni_util_strdup_s("Parse ip failed");
+        return 0;
+    }
+    free(*dst);
+    *dst = tmp;
+    *dst_len = tmp_len;
+    return 1;
+}
 
-err_out:
-    free_ipconfig_type(result);
-    return NULL;
+static int decoder_append_string(struct result_decoder *d, const unsigned char *str, size_t len)
+{
+    char **grown = NULL;
+    char *tmp = NULL;
+
+    grown = grow_pointer_array(*d->list, *d->list_len, &d->list_cap);
+    tmp = decoder_strdup(str, len);
+    if (grown == NULL || tmp == NULL) {
+        free(tmp);
+        return decoder_fail(d, "Out of memory");
+    }
+    *d->list = grown;
+    (*d->list)[(*d->list_len)++] = tmp;
+    return 1;
 }
 
-static struct route *convert_curr_route(const cni_network_route *curr_route, char **err)
+/* scopes which are arrays, where only items of the expected type are allowed */
+static inline bool decoder_in_array(const struct result_decoder *d)
 {
-    struct route *result = NULL;
-    struct ipnet *dst = NULL;
-    int ret = 0;
-    uint8_t *gw = NULL;
-    size_t gw_len = 0;
+    return d->scope == DECODE_INTERFACES || d->scope == DECODE_IPS || d->scope == DECODE_ROUTES ||
+           d->scope == DECODE_DNS_LIST;
+}
 
-    if (curr_route == NULL) {
-        ERROR("Invalid argument");
-        return NULL;
+static int decode_new_item(struct result_decoder *d);
+
+static int decoder_end_item(struct result_decoder *d);
+
+/* array item with unexpected type becomes an empty item, or an empty string in dns lists */
+static int decoder_empty_item(struct result_decoder *d)
+{
+    if (d->scope == DECODE_DNS_LIST) {
+        return decoder_append_string(d, (const unsigned char *)"", 0);
     }
-    ret = do_parse_ipnet(curr_route->dst, curr_route->gw, &gw, &gw_len, &dst, err);
-    if (ret != 0) {
-        return NULL;
+    if (decode_new_item(d) == 0) {
+        return 0;
     }
+    return decoder_end_item(d);
+}
 
-    result = clibcni_util_common_calloc_s(sizeof(struct route));
-    if (result == NULL) {
-        ERROR("Out of memory");
-        free(gw);
-        free_ipnet_type(dst);
-        *err = clibcni_util_strdup_s("Out of memory");
-        return NULL;
+/* null, bool and double only appear as skipped values or array items of unexpected type */
+static int decoder_other_scalar(struct result_decoder *d)
+{
+    if (d->skip > 0) {
+        return 1;
     }
+    if (d->scope == DECODE_NONE) {
+        return decoder_fail(d, "Invalid value type in result");
+    }
+    if (decoder_in_array(d)) {
+        return decoder_empty_item(d);
+    }
+    return 1;
+}
 
-    result->dst = dst;
-    result->gw = gw;
-    result->gw_len = gw_len;
-
-    return result;
+static int decode_null(void *ctx)
+{
+    return decoder_other_scalar((struct result_decoder *)ctx);
 }
 
-static struct dns *convert_curr_dns(cni_network_dns *curr_dns, char **err)
+static int decode_boolean(void *ctx, int val)
 {
-    struct dns *result = NULL;
+    (void)val;
+    return decoder_other_scalar((struct result_decoder *)ctx);
+}
 
-    if (curr_dns == NULL) {
-        *err = clibcni_util_strdup_s("Empty dns argument");
-        ERROR("Empty dns argument");
-        return NULL;
+static int decode_number(void *ctx, const char *val, size_t len)
+{
+    struct result_decoder *d = (struct result_decoder *)ctx;
+    struct ipconfig *ipc = NULL;
+    char buf[32] = { 0 };
+    char *end = NULL;
+    long long num = 0;
+
+    if (d->skip > 0 || d->scope != DECODE_IP || d->member != MEMBER_INTERFACE) {
+        return decoder_other_scalar(d);
+    }
+
+    ipc = d->value->ips[d->value->ips_len - 1];
+    if (len >= sizeof(buf)) {
+        return decoder_fail(d, "Invalid value with type 'int32' for key 'interface'");
+    }
+    (void)memcpy(buf, val, len);
+    errno = 0;
+    num = strtoll(buf, &end, 10);
+    if (errno != 0 || end == buf || *end != '\0' || num < INT32_MIN || num > INT32_MAX) {
+        return decoder_fail(d, "Invalid value with type 'int32' for key 'interface'");
+    }
+    if (ipc->interface == NULL) {
+        ipc->interface = clibcni_util_common_calloc_s(sizeof(int32_t));
+        if (ipc->interface == NULL) {
+            return decoder_fail(d, "Out of memory");
+        }
     }
+    *(ipc->interface) = (int32_t)num;
+    return 1;
+}
 
-    result = clibcni_util_common_calloc_s(sizeof(struct dns));
-    if (result == NULL) {
-        ERROR("Out of memory");
-        *err = clibcni_util_strdup_s("Out of memory");
-        return NULL;
+static int decode_member_string(struct result_decoder *d, const unsigned char *val, size_t len)
+{
+    struct result *value = d->value;
+    struct interface *iface = NULL;
+    struct ipconfig *ipc = NULL;
+    struct route *rt = NULL;
+
+    switch (d->member) {
+        case MEMBER_CNIVERSION:
+            return decoder_set_string(d, &value->cniversion, val, len);
+        case MEMBER_NAME:
+        case MEMBER_MAC:
+        case MEMBER_SANDBOX:
+            iface = value->interfaces[value->interfaces_len - 1];
+            return decoder_set_string(d, d->member == MEMBER_NAME ? &iface->name :
+                                      (d->member == MEMBER_MAC ? &iface->mac : &iface->sandbox), val, len);
+        case MEMBER_VERSION:
+            ipc = value->ips[value->ips_len - 1];
+            return decoder_set_string(d, &ipc->version, val, len);
+        case MEMBER_ADDRESS:
+            ipc = value->ips[value->ips_len - 1];
+            return decoder_set_ipnet(d, &ipc->address, val, len);
+        case MEMBER_GATEWAY:
+            ipc = value->ips[value->ips_len - 1];
+            return decoder_set_ip(d, &ipc->gateway, &ipc->gateway_len, val, len);
+        case MEMBER_DST:
+            rt = value->routes[value->routes_len - 1];
+            return decoder_set_ipnet(d, &rt->dst, val, len);
+        case MEMBER_GW:
+            rt = value->routes[value->routes_len - 1];
+            return decoder_set_ip(d, &rt->gw, &rt->gw_len, val, len);
+        case MEMBER_DOMAIN:
+            return decoder_set_string(d, &value->my_dns->domain, val, len);
+        default:
+            /* unknown member, or a member of other type */
+            return 1;
     }
+}
 
-    result->name_servers = curr_dns->nameservers;
-    result->name_servers_len = curr_dns->nameservers_len;
-    result->domain = curr_dns->domain;
-    result->options = curr_dns->options;
-    result->options_len = curr_dns->options_len;
-    result->search = curr_dns->search;
-    result->search_len = curr_dns->search_len;
+static int decode_string(void *ctx, const unsigned char *val, size_t len)
+{
+    struct result_decoder *d = (struct result_decoder *)ctx;
 
-    (void)memset(curr_dns, 0, sizeof(cni_network_dns));
+    if (d->skip > 0) {
+        return 1;
+    }
+    if (d->scope == DECODE_DNS_LIST) {
+        return decoder_append_string(d, val, len);
+    }
+    if (d->scope == DECODE_NONE) {
+        return decoder_fail(d, "Invalid value type in result");
+    }
+    if (decoder_in_array(d)) {
+        return decoder_empty_item(d);
+    }
+    return decode_member_string(d, val, len);
+}
 
-    return result;
+static uint32_t *decoder_seen_members(struct result_decoder *d)
+{
+    switch (d->scope) {
+        case DECODE_TOP:
+            return &d->top_seen;
+        case DECODE_INTERFACE:
+        case DECODE_IP:
+        case DECODE_ROUTE:
+            return &d->item_seen;
+        case DECODE_DNS:
+            return &d->dns_seen;
+        default:
+            return NULL;
+    }
 }
 
-static int copy_result_interface(const cni_result_curr *curr_result, struct result *value, char **err)
+static int decode_map_key(void *ctx, const unsigned char *key, size_t len)
 {
-    value->interfaces_len = curr_result->interfaces_len;
-    if (value->interfaces_len > 0) {
-        value->interfaces = clibcni_util_smart_calloc_s(value->interfaces_len, sizeof(struct interface *));
-        if (value->interfaces == NULL) {
-            *err = clibcni_util_strdup_s("Out of memory");
-            value->interfaces_len = 0;
-            ERROR("Out of memory");
-            return -1;
-        }
-        size_t i;
-        for (i = 0; i < curr_result->interfaces_len; i++) {
-            value->interfaces[i] = convert_curr_interface(curr_result->interfaces[i]);
-            if (value->interfaces[i] == NULL) {
-                *err = clibcni_util_strdup_s("Convert interfaces failed");
-                value->interfaces_len = i;
-                ERROR("Convert interfaces failed");
-                return -1;
-            }
+    struct result_decoder *d = (struct result_decoder *)ctx;
+    uint32_t *seen = NULL;
+    uint32_t bit = 0;
+    size_t i = 0;
+
+    if (d->skip > 0) {
+        return 1;
+    }
+    d->member = MEMBER_UNKNOWN;
+    for (i = 0; i < sizeof(g_result_members) / sizeof(g_result_members[0]); i++) {
+        if (g_result_members[i].scope == d->scope && strlen(g_result_members[i].key) == len &&
+            memcmp(g_result_members[i].key, key, len) == 0) {
+            d->member = g_result_members[i].member;
+            break;
         }
     }
-    return 0;
+    seen = decoder_seen_members(d);
+    if (d->member == MEMBER_UNKNOWN || seen == NULL) {
+        return 1;
+    }
+    /* later value of a repeated key is skipped, even if the first one has unexpected type */
+    bit = (uint32_t)1 << d->member;
+    if ((*seen & bit) != 0) {
+        d->member = MEMBER_UNKNOWN;
+    }
+    *seen |= bit;
+    return 1;
 }
 
-static int copy_result_ips(const cni_result_curr *curr_result, struct result *value, char **err)
+static int decode_new_item(struct result_decoder *d)
 {
-    size_t i = 0;
-    value->ips_len = curr_result->ips_len;
+    struct result *value = d->value;
+    void *grown = NULL;
+    void *item = NULL;
+
+    d->item_seen = 0;
+    switch (d->scope) {
+        case DECODE_INTERFACES:
+            grown = grow_pointer_array(value->interfaces, value->interfaces_len, &d->interfaces_cap);
+            item = clibcni_util_common_calloc_s(sizeof(struct interface));
+            if (grown == NULL || item == NULL) {
+                break;
+            }
+            value->interfaces = grown;
+            value->interfaces[value->interfaces_len++] = item;
+            d->scope = DECODE_INTERFACE;
+            return 1;
+        case DECODE_IPS:
+            grown = grow_pointer_array(value->ips, value->ips_len, &d->ips_cap);
+            item = clibcni_util_common_calloc_s(sizeof(struct ipconfig));
+            if (grown == NULL || item == NULL) {
+                break;
+            }
+            value->ips = grown;
+            value->ips[value->ips_len++] = item;
+            d->scope = DECODE_IP;
+            return 1;
+        default:
+            grown = grow_pointer_array(value->routes, value->routes_len, &d->routes_cap);
+            item = clibcni_util_common_calloc_s(sizeof(struct route));
+            if (grown == NULL || item == NULL) {
+                break;
+            }
+            value->routes = grown;
+            value->routes[value->routes_len++] = item;
+            d->scope = DECODE_ROUTE;
+            return 1;
+    }
+    free(item);
+    return decoder_fail(d, "Out of memory");
+}
 
-    if (value->ips_len == 0) {
-        return 0;
+static int decode_start_map(void *ctx)
+{
+    struct result_decoder *d = (struct result_decoder *)ctx;
+
+    if (d->skip > 0) {
+        d->skip++;
+        return 1;
+    }
+    switch (d->scope) {
+        case DECODE_NONE:
+            d->scope = DECODE_TOP;
+            return 1;
+        case DECODE_INTERFACES:
+        case DECODE_IPS:
+        case DECODE_ROUTES:
+            d->member = MEMBER_UNKNOWN;
+            return decode_new_item(d);
+        case DECODE_DNS_LIST:
+            if (decoder_empty_item(d) == 0) {
+                return 0;
+            }
+            d->skip = 1;
+            return 1;
+        default:
+            break;
+    }
+    if (d->scope == DECODE_TOP && d->member == MEMBER_DNS) {
+        if (d->value->my_dns == NULL) {
+            d->value->my_dns = clibcni_util_common_calloc_s(sizeof(struct dns));
+            if (d->value->my_dns == NULL) {
+                return decoder_fail(d, "Out of memory");
+            }
+        }
+        d->scope = DECODE_DNS;
+        d->member = MEMBER_UNKNOWN;
+        return 1;
     }
+    d->skip = 1;
+    return 1;
+}
 
-    value->ips = clibcni_util_smart_calloc_s(value->ips_len, sizeof(struct ipconfig *));
-    if (value->ips == NULL) {
-        *err = clibcni_util_strdup_s("Out of memory");
-        ERROR("Out of memory");
-        value->ips_len = 0;
-        return -1;
+static int decoder_end_item(struct result_decoder *d)
+{
+    switch (d->scope) {
+        case DECODE_INTERFACE:
+            d->scope = DECODE_INTERFACES;
+            break;
+        case DECODE_IP:
+            if (d->value->ips[d->value->ips_len - 1]->address == NULL) {
+                return decoder_fail(d, "Parse cidr failed: empty address");
+            }
+            d->scope = DECODE_IPS;
+            break;
+        default:
+            if (d->value->routes[d->value->routes_len - 1]->dst == NULL) {
+                return decoder_fail(d, "Parse cidr failed: empty dst");
+            }
+            d->scope = DECODE_ROUTES;
+            break;
     }
+    d->member = MEMBER_UNKNOWN;
+    return 1;
+}
 
-    for (i = 0; i < value->ips_len; i++) {
-        value->ips[i] = convert_curr_ipconfig(curr_result->ips[i], err);
-        if (value->ips[i] == NULL) {
-            ERROR("Convert ips failed: %s", *err != NULL ? *err : "");
-            value->ips_len = i;
-            return -1;
+static int decode_end_map(void *ctx)
+{
+    struct result_decoder *d = (struct result_decoder *)ctx;
+
+    if (d->skip > 0) {
+        d->skip--;
+        return 1;
+    }
+    switch (d->scope) {
+        case DECODE_INTERFACE:
+        case DECODE_IP:
+        case DECODE_ROUTE:
+            return decoder_end_item(d);
+        case DECODE_DNS:
+            d->scope = DECODE_TOP;
+            break;
+        default:
+            d->scope = DECODE_DONE;
+            break;
+    }
+    d->member = MEMBER_UNKNOWN;
+    return 1;
+}
+
+static int decode_start_dns_list(struct result_decoder *d)
+{
+    struct dns *dns = d->value->my_dns;
+
+    switch (d->member) {
+        case MEMBER_NAMESERVERS:
+            d->list = &dns->name_servers;
+            d->list_len = &dns->name_servers_len;
+            break;
+        case MEMBER_SEARCH:
+            d->list = &dns->search;
+            d->list_len = &dns->search_len;
+            break;
+        case MEMBER_OPTIONS:
+            d->list = &dns->options;
+            d->list_len = &dns->options_len;
+            break;
+        default:
+            d->skip = 1;
+            return 1;
+    }
+    d->list_cap = 0;
+    d->scope = DECODE_DNS_LIST;
+    return 1;
+}
+
+static int decode_start_array(void *ctx)
+{
+    struct result_decoder *d = (struct result_decoder *)ctx;
+
+    if (d->skip > 0) {
+        d->skip++;
+        return 1;
+    }
+    if (d->scope == DECODE_NONE) {
+        return decoder_fail(d, "Invalid value type in result");
+    }
+    if (decoder_in_array(d)) {
+        if (decoder_empty_item(d) == 0) {
+            return 0;
+        }
+        d->skip = 1;
+        return 1;
+    }
+    if (d->scope == DECODE_DNS) {
+        return decode_start_dns_list(d);
+    }
+    if (d->scope == DECODE_TOP) {
+        switch (d->member) {
+            case MEMBER_INTERFACES:
+                d->scope = DECODE_INTERFACES;
+                return 1;
+            case MEMBER_IPS:
+                d->scope = DECODE_IPS;
+                return 1;
+            case MEMBER_ROUTES:
+                d->scope = DECODE_ROUTES;
+                return 1;
+            default:
+                break;
         }
     }
-    return 0;
+    d->skip = 1;
+    return 1;
 }
 
-static int copy_result_routes(const cni_result_curr *curr_result, struct result *value, char **err)
+static int decode_end_array(void *ctx)
 {
-    size_t i = 0;
+    struct result_decoder *d = (struct result_decoder *)ctx;
 
-    value->routes_len = curr_result->routes_len;
-    if (value->routes_len == 0) {
-        return 0;
+    if (d->skip > 0) {
+        d->skip--;
+        return 1;
     }
+    d->scope = d->scope == DECODE_DNS_LIST ? DECODE_DNS : DECODE_TOP;
+    d->member = MEMBER_UNKNOWN;
+    return 1;
+}
+
+static const yajl_callbacks g_result_decode_callbacks = {
+    .yajl_null = decode_null,
+    .yajl_boolean = decode_boolean,
+    .yajl_number = decode_number,
+    .yajl_string = decode_string,
+    .yajl_start_map = decode_start_map,
+    .yajl_map_key = decode_map_key,
+    .yajl_end_map = decode_end_map,
+    .yajl_start_array = decode_start_array,
+    .yajl_end_array = decode_end_array,
+};
+
+static void set_decode_parse_error(yajl_handle handle, const char *json_data, size_t len, char **err)
+{
+    unsigned char *msg = NULL;
 
-    value->routes = clibcni_util_smart_calloc_s(value->routes_len, sizeof(struct route *));
-    if (value->routes == NULL) {
+    msg = yajl_get_error(handle, 0, (const unsigned char *)json_data, len);
+    if (asprintf(err, "parse json failed: %s", msg != NULL ? (const char *)msg : "") < 0) {
         *err = clibcni_util_strdup_s("Out of memory");
-        ERROR("Out of memory");
-        value->routes_len = 0;
-        return -1;
     }
-
-    for (i = 0; i < value->routes_len; i++) {
-        value->routes[i] = convert_curr_route(curr_result->routes[i], err);
-        if (value->routes[i] == NULL) {
-            ERROR("Convert routes failed: %s", *err != NULL ? *err : "");
-            value->routes_len = i;
-            return -1;
-        }
+    ERROR("Parse failed: %s", msg != NULL ? (const char *)msg : "");
+    if (msg != NULL) {
+        yajl_free_error(handle, msg);
     }
-    return 0;
 }
 
-static struct result *get_result(const cni_result_curr *curr_result, char **err)
+static struct result *decode_curr_result(const char *json_data, char **err)
 {
-    struct result *value = NULL;
-    bool invalid_arg = (curr_result == NULL || err == NULL);
+    struct result_decoder d = { 0 };
+    yajl_handle handle = NULL;
+    yajl_status status = yajl_status_ok;
+    size_t len = 0;
 
-    if (invalid_arg) {
+    d.value = clibcni_util_common_calloc_s(sizeof(struct result));
+    if (d.value == NULL) {
+        *err = clibcni_util_strdup_s("Out of memory");
+        ERROR("Out of memory");
         return NULL;
     }
-    value = clibcni_util_common_calloc_s(sizeof(struct result));
-    if (value == NULL) {
+    handle = yajl_alloc(&g_result_decode_callbacks, NULL, &d);
+    if (handle == NULL) {
         *err = clibcni_util_strdup_s("Out of memory");
         ERROR("Out of memory");
-        return NULL;
+        goto err_out;
     }
+    /* comments are allowed, as by yajl_tree_parse */
+    (void)yajl_config(handle, yajl_allow_comments, 1);
 
-    /* copy cni version */
-    value->cniversion = clibcni_util_strdup_s(curr_result->cni_version);
-
-    /* copy interfaces */
-    if (copy_result_interface(curr_result, value, err) != 0) {
-        goto free_out;
+    len = strlen(json_data);
+    status = yajl_parse(handle, (const unsigned char *)json_data, len);
+    if (status == yajl_status_ok) {
+        status = yajl_complete_parse(handle);
     }
-
-    /* copy ips */
-    if (copy_result_ips(curr_result, value, err) != 0) {
-        goto free_out;
+    if (status == yajl_status_client_canceled) {
+        /* same format as errors of converting parsed result */
+        *err = d.err;
+        d.err = NULL;
+        do_append_result_errmsg(NULL, NULL, err);
+        goto err_out;
     }
-
-    /* copy routes */
-    if (copy_result_routes(curr_result, value, err) != 0) {
-        goto free_out;
+    if (status != yajl_status_ok) {
+        set_decode_parse_error(handle, json_data, len, err);
+        goto err_out;
     }
-
-    /* copy dns */
-    value->my_dns = convert_curr_dns(curr_result->dns, err);
-    if (value->my_dns == NULL) {
-        goto free_out;
+    if (d.value->my_dns == NULL) {
+        /* dns is required */
+        *err = clibcni_util_strdup_s("Empty dns argument");
+        ERROR("Empty dns argument");
+        do_append_result_errmsg(NULL, NULL, err);
+        goto err_out;
     }
 
-    return value;
-free_out:
-    free_result(value);
+    yajl_free(handle);
+    return d.value;
+
+err_out:
+    if (handle != NULL) {
+        yajl_free(handle);
+    }
+    free(d.err);
+    free_result(d.value);
     return NULL;
 }
 
@@ -636,12 +1030,13 @@ static bool copy_interfaces_from_result_to_json(const struct result *src, cni_re
         ERROR("Out of memory");
         return false;
     }
+    /* empty entries are skipped, same for ips and routes */
     for (i = 0; i < src->interfaces_len; i++) {
         if (src->interfaces[i] == NULL) {
             continue;
         }
-        res->interfaces[i] = interface_to_json_interface(src->interfaces[i]);
-        if (res->interfaces[i] == NULL) {
+        res->interfaces[res->interfaces_len] = interface_to_json_interface(src->interfaces[i]);
+        if (res->interfaces[res->interfaces_len] == NULL) {
             *err = clibcni_util_strdup_s("interface to json struct failed");
             ERROR("interface to json struct failed");
             return false;
@@ -665,8 +1060,11 @@ static bool copy_ips_from_result_to_json(const struct result *src, cni_result_cu
         }
         size_t i = 0;
         for (i = 0; i < src->ips_len; i++) {
-            res->ips[i] = ipconfig_to_json_ipconfig(src->ips[i], err);
-            if (res->ips[i] == NULL) {
+            if (src->ips[i] == NULL) {
+                continue;
+            }
+            res->ips[res->ips_len] = ipconfig_to_json_ipconfig(src->ips[i], err);
+            if (res->ips[res->ips_len] == NULL) {
                 ERROR("parse ip failed: %s", *err != NULL ? *err : "");
                 return false;
             }
@@ -690,8 +1088,11 @@ static bool copy_routes_from_result_to_json(const struct result *src, cni_result
         }
         size_t i = 0;
         for (i = 0; i < src->routes_len; i++) {
-            res->routes[i] = route_to_json_route(src->routes[i], err);
-            if (res->routes[i] == NULL) {
+            if (src->routes[i] == NULL) {
+                continue;
+            }
+            res->routes[res->routes_len] = route_to_json_route(src->routes[i], err);
+            if (res->routes[res->routes_len] == NULL) {
                 ERROR("Parse route failed: %s", *err != NULL ? *err : "");
                 return false;
             }
@@ -761,3 +1162,729 @@ out:
     return res;
 }
 
+
+/*
+ * streaming writer of result in format of cni_result_curr_generate_json with
+ * OPT_GEN_SIMPLIFY: same keys, key order and string escapes, members which the
+ * json tree would leave unset are left out
+ * */
+static inline int json_put(struct clibcni_util_buffer *buf, const char *str, size_t len)
+{
+    return clibcni_util_buffer_append(buf, str, len);
+}
+
+static inline int json_put_str(struct clibcni_util_buffer *buf, const char *str)
+{
+    return clibcni_util_buffer_append(buf, str, strlen(str));
+}
+
+/* same rules as the utf8 check of yajl generator */
+static bool json_valid_utf8(const unsigned char *str)
+{
+    const unsigned char *pos = str;
+    size_t follow = 0;
+
+    while (*pos != '\0') {
+        if (*pos <= 0x7f) {
+            follow = 0;
+        } else if ((*pos >> 5) == 0x6) {
+            follow = 1;
+        } else if ((*pos >> 4) == 0x0e) {
+            follow = 2;
+        } else if ((*pos >> 3) == 0x1e) {
+            follow = 3;
+        } else {
+            return false;
+        }
+        for (pos++; follow > 0; follow--, pos++) {
+            if ((*pos >> 6) != 0x2) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static int json_put_string(struct clibcni_util_buffer *buf, const char *str)
+{
+    const char hex[] = "0123456789ABCDEF";
+    char esc[6] = { '\\', 'u', '0', '0', '0', '0' };
+    const char *run = str;
+    const char *pos = NULL;
+    const char *rep = NULL;
+    size_t rep_len = 0;
+
+    if (!json_valid_utf8((const unsigned char *)str)) {
+        return -1;
+    }
+    if (json_put(buf, "\"", 1) != 0) {
+        return -1;
+    }
+    for (pos = str; *pos != '\0'; pos++) {
+        rep_len = 2;
+        switch (*pos) {
+            case '"':
+                rep = "\\\"";
+                break;
+            case '\\':
+                rep = "\\\\";
+                break;
+            case '\b':
+                rep = "\\b";
+                break;
+            case '\f':
+                rep = "\\f";
+                break;
+            case '\n':
+                rep = "\\n";
+                break;
+            case '\r':
+                rep = "\\r";
+                break;
+            case '\t':
+                rep = "\\t";
+                break;
+            default:
+                if ((unsigned char)*pos >= 0x20) {
+                    continue;
+                }
+                esc[4] = hex[(unsigned char)*pos >> 4];
+                esc[5] = hex[(unsigned char)*pos & 0x0f];
+                rep = esc;
+                rep_len = sizeof(esc);
+                break;
+        }
+        if (json_put(buf, run, (size_t)(pos - run)) != 0 || json_put(buf, rep, rep_len) != 0) {
+            return -1;
+        }
+        run = pos + 1;
+    }
+    return json_put(buf, run, (size_t)(pos - run)) != 0 || json_put(buf, "\"", 1) != 0 ? -1 : 0;
+}
+
+/* key is a plain literal, no need to escape */
+static int json_put_key(struct clibcni_util_buffer *buf, bool *first, const char *key)
+{
+    if (!*first && json_put(buf, ",", 1) != 0) {
+        return -1;
+    }
+    *first = false;
+    if (json_put(buf, "\"", 1) != 0 || json_put_str(buf, key) != 0 || json_put(buf, "\":", 2) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static int json_put_string_member(struct clibcni_util_buffer *buf, bool *first, const char *key, const char *value)
+{
+    if (value == NULL) {
+        return 0;
+    }
+    if (json_put_key(buf, first, key) != 0) {
+        return -1;
+    }
+    return json_put_string(buf, value);
+}
+
+static int json_put_string_array_member(struct clibcni_util_buffer *buf, bool *first, const char *key,
+                                        char * const *values, size_t len)
+{
+    size_t i = 0;
+
+    if (values == NULL || len == 0) {
+        return 0;
+    }
+    if (json_put_key(buf, first, key) != 0 || json_put(buf, "[", 1) != 0) {
+        return -1;
+    }
+    for (i = 0; i < len; i++) {
+        if (values[i] == NULL) {
+            return -1;
+        }
+        if ((i > 0 && json_put(buf, ",", 1) != 0) || json_put_string(buf, values[i]) != 0) {
+            return -1;
+        }
+    }
+    return json_put(buf, "]", 1);
+}
+
+static int write_json_interfaces(const struct result *src, struct clibcni_util_buffer *buf, bool *first)
+{
+    size_t i = 0;
+    bool first_item = true;
+    bool first_member = true;
+
+    if (src->interfaces == NULL || src->interfaces_len == 0) {
+        return 0;
+    }
+    if (json_put_key(buf, first, "interfaces") != 0 || json_put(buf, "[", 1) != 0) {
+        return -1;
+    }
+    for (i = 0; i < src->interfaces_len; i++) {
+        if (src->interfaces[i] == NULL) {
+            continue;
+        }
+        if ((!first_item && json_put(buf, ",", 1) != 0) || json_put(buf, "{", 1) != 0) {
+            return -1;
+        }
+        first_item = false;
+        first_member = true;
+        if (json_put_string_member(buf, &first_member, "name", src->interfaces[i]->name) != 0 ||
+            json_put_string_member(buf, &first_member, "mac", src->interfaces[i]->mac) != 0 ||
+            json_put_string_member(buf, &first_member, "sandbox", src->interfaces[i]->sandbox) != 0 ||
+            json_put(buf, "}", 1) != 0) {
+            return -1;
+        }
+    }
+    return json_put(buf, "]", 1);
+}
+
+static int write_json_ipconfig(const struct ipconfig *ipc, struct clibcni_util_buffer *buf, char **err)
+{
+    char ip_buf[IPNET_STRING_BUF_LEN] = { 0 };
+    char num[16] = { 0 };
+    bool first = true;
+
+    if (json_put(buf, "{", 1) != 0 || json_put_string_member(buf, &first, "version", ipc->version) != 0) {
+        return -1;
+    }
+    if (ipc->interface != NULL) {
+        (void)snprintf(num, sizeof(num), "%d", *(ipc->interface));
+        if (json_put_key(buf, &first, "interface") != 0 || json_put_str(buf, num) != 0) {
+            return -1;
+        }
+    }
+    if (ipc->address != NULL) {
+        if (ipnet_to_buffer(ipc->address, ip_buf, sizeof(ip_buf), err) != 0) {
+            ERROR("Covert ipnet failed: %s", *err != NULL ? *err : "");
+            return -1;
+        }
+        if (json_put_string_member(buf, &first, "address", ip_buf) != 0) {
+            return -1;
+        }
+    }
+    if (ipc->gateway != NULL && ipc->gateway_len > 0) {
+        if (ip_to_buffer(ipc->gateway, ipc->gateway_len, ip_buf, sizeof(ip_buf)) != 0) {
+            *err = clibcni_util_strdup_s("ip to string failed");
+            ERROR("ip to string failed");
+            return -1;
+        }
+        if (json_put_string_member(buf, &first, "gateway", ip_buf) != 0) {
+            return -1;
+        }
+    }
+    return json_put(buf, "}", 1);
+}
+
+static int write_json_route(const struct route *rt, struct clibcni_util_buffer *buf, char **err)
+{
+    char ip_buf[IPNET_STRING_BUF_LEN] = { 0 };
+    bool first = true;
+
+    if (json_put(buf, "{", 1) != 0) {
+        return -1;
+    }
+    if (rt->dst != NULL) {
+        if (ipnet_to_buffer(rt->dst, ip_buf, sizeof(ip_buf), err) != 0) {
+            ERROR("Covert ipnet failed: %s", *err != NULL ? *err : "");
+            return -1;
+        }
+        if (json_put_string_member(buf, &first, "dst", ip_buf) != 0) {
+            return -1;
+        }
+    }
+    if (rt->gw != NULL && rt->gw_len > 0) {
+        if (ip_to_buffer(rt->gw, rt->gw_len, ip_buf, sizeof(ip_buf)) != 0) {
+            *err = clibcni_util_strdup_s("ip to string failed");
+            ERROR("ip to string failed");
+            return -1;
+        }
+        if (json_put_string_member(buf, &first, "gw", ip_buf) != 0) {
+            return -1;
+        }
+    }
+    return json_put(buf, "}", 1);
+}
+
+/* empty entries are skipped, as by write_json_interfaces */
+static int write_json_ips_and_routes(const struct result *src, struct clibcni_util_buffer *buf, bool *first,
+                                     char **err)
+{
+    size_t i = 0;
+    bool first_item = true;
+
+    if (src->ips != NULL && src->ips_len > 0) {
+        if (json_put_key(buf, first, "ips") != 0 || json_put(buf, "[", 1) != 0) {
+            return -1;
+        }
+        for (i = 0; i < src->ips_len; i++) {
+            if (src->ips[i] == NULL) {
+                continue;
+            }
+            if ((!first_item && json_put(buf, ",", 1) != 0) || write_json_ipconfig(src->ips[i], buf, err) != 0) {
+                return -1;
+            }
+            first_item = false;
+        }
+        if (json_put(buf, "]", 1) != 0) {
+            return -1;
+        }
+    }
+
+    if (src->routes != NULL && src->routes_len > 0) {
+        if (json_put_key(buf, first, "routes") != 0 || json_put(buf, "[", 1) != 0) {
+            return -1;
+        }
+        first_item = true;
+        for (i = 0; i < src->routes_len; i++) {
+            if (src->routes[i] == NULL) {
+                continue;
+            }
+            if ((!first_item && json_put(buf, ",", 1) != 0) || write_json_route(src->routes[i], buf, err) != 0) {
+                return -1;
+            }
+            first_item = false;
+        }
+        if (json_put(buf, "]", 1) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int write_json_dns(const struct dns *dns, struct clibcni_util_buffer *buf, bool *first)
+{
+    bool first_member = true;
+
+    if (dns == NULL) {
+        return 0;
+    }
+    if (json_put_key(buf, first, "dns") != 0 || json_put(buf, "{", 1) != 0) {
+        return -1;
+    }
+    if (json_put_string_array_member(buf, &first_member, "nameservers", dns->name_servers,
+                                     dns->name_servers_len) != 0 ||
+        json_put_string_member(buf, &first_member, "domain", dns->domain) != 0 ||
+        json_put_string_array_member(buf, &first_member, "search", dns->search, dns->search_len) != 0 ||
+        json_put_string_array_member(buf, &first_member, "options", dns->options, dns->options_len) != 0) {
+        return -1;
+    }
+    return json_put(buf, "}", 1);
+}
+
+char *curr_result_to_json(const struct result *src, char **err)
+{
+    struct clibcni_util_buffer buf = { 0 };
+    bool first = true;
+
+    if (src == NULL || err == NULL) {
+        ERROR("Invalid arguments");
+        return NULL;
+    }
+
+    if (clibcni_util_buffer_reserve(&buf, 512) != 0 || json_put(&buf, "{", 1) != 0 ||
+        json_put_string_member(&buf, &first, "cniVersion", src->cniversion) != 0 ||
+        write_json_interfaces(src, &buf, &first) != 0 || write_json_ips_and_routes(src, &buf, &first, err) != 0 ||
+        write_json_dns(src->my_dns, &buf, &first) != 0 || json_put(&buf, "}", 1) != 0) {
+        if (*err == NULL) {
+            *err = clibcni_util_strdup_s("Generate result json failed");
+        }
+        ERROR("Generate result json failed: %s", *err);
+        clibcni_util_buffer_free(&buf);
+        return NULL;
+    }
+
+    return clibcni_util_buffer_steal(&buf);
+}
+
+#define COMPACT_RESULT_ALIGN 16
+
+struct compact_result {
+    const char *cniversion;
+
+    struct compact_interface *interfaces;
+    size_t interfaces_len;
+
+    struct compact_ipconfig *ips;
+    size_t ips_len;
+
+    struct compact_route *routes;
+    size_t routes_len;
+
+    struct compact_dns dns;
+};
+
+/* hand out pieces of one block, its size is counted by compact_result_size */
+struct compact_builder {
+    char *base;
+    size_t off;
+};
+
+static void *builder_reserve(struct compact_builder *b, size_t size, bool aligned)
+{
+    void *ret = NULL;
+
+    if (aligned) {
+        b->off = (b->off + COMPACT_RESULT_ALIGN - 1) & ~((size_t)COMPACT_RESULT_ALIGN - 1);
+    }
+    ret = b->base + b->off;
+    b->off += size;
+    return ret;
+}
+
+static const char *builder_strdup(struct compact_builder *b, const char *src)
+{
+    size_t len = 0;
+    char *dst = NULL;
+
+    if (src == NULL) {
+        return NULL;
+    }
+    len = strlen(src) + 1;
+    dst = builder_reserve(b, len, false);
+    (void)memcpy(dst, src, len);
+    return dst;
+}
+
+static const char * const *builder_strarray(struct compact_builder *b, char * const *src, size_t len)
+{
+    const char **dst = NULL;
+    size_t i = 0;
+
+    if (len == 0) {
+        return NULL;
+    }
+    dst = builder_reserve(b, len * sizeof(char *), true);
+    for (i = 0; i < len; i++) {
+        dst[i] = builder_strdup(b, src[i]);
+    }
+    return dst;
+}
+
+static bool size_add(size_t *total, size_t size, bool aligned)
+{
+    size_t need = aligned ? (size + COMPACT_RESULT_ALIGN - 1) : size;
+
+    if (need < size || need > SIZE_MAX - *total) {
+        return false;
+    }
+    *total += need;
+    return true;
+}
+
+static bool size_add_str(size_t *total, const char *str)
+{
+    return str == NULL || size_add(total, strlen(str) + 1, false);
+}
+
+static bool size_add_array(size_t *total, size_t len, size_t elem_size)
+{
+    return len <= SIZE_MAX / elem_size && size_add(total, len * elem_size, true);
+}
+
+static bool size_add_strarray(size_t *total, char * const *strs, size_t len)
+{
+    size_t i = 0;
+
+    if (!size_add_array(total, len, sizeof(char *))) {
+        return false;
+    }
+    for (i = 0; i < len; i++) {
+        if (!size_add_str(total, strs[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* upper bound of block size, every aligned piece is counted with worst padding */
+static bool compact_result_size(const struct result *src, size_t *total)
+{
+    size_t i = 0;
+    const struct dns *dns = src->my_dns;
+
+    *total = 0;
+    if (!size_add(total, sizeof(struct compact_result), true) || !size_add_str(total, src->cniversion)) {
+        return false;
+    }
+
+    if (!size_add_array(total, src->interfaces_len, sizeof(struct compact_interface))) {
+        return false;
+    }
+    for (i = 0; i < src->interfaces_len; i++) {
+        if (src->interfaces[i] == NULL) {
+            continue;
+        }
+        if (!size_add_str(total, src->interfaces[i]->name) || !size_add_str(total, src->interfaces[i]->mac) ||
+            !size_add_str(total, src->interfaces[i]->sandbox)) {
+            return false;
+        }
+    }
+
+    if (!size_add_array(total, src->ips_len, sizeof(struct compact_ipconfig))) {
+        return false;
+    }
+    for (i = 0; i < src->ips_len; i++) {
+        if (src->ips[i] != NULL && !size_add_str(total, src->ips[i]->version)) {
+            return false;
+        }
+    }
+
+    if (!size_add_array(total, src->routes_len, sizeof(struct compact_route))) {
+        return false;
+    }
+
+    if (dns != NULL) {
+        if (!size_add_strarray(total, dns->name_servers, dns->name_servers_len) ||
+            !size_add_str(total, dns->domain) || !size_add_strarray(total, dns->search, dns->search_len) ||
+            !size_add_strarray(total, dns->options, dns->options_len)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int fill_compact_ip(const uint8_t *ip, size_t ip_len, uint8_t *dst, size_t *dst_len, char **err)
+{
+    if (ip_len > IPV6LEN) {
+        *err = clibcni_util_strdup_s("Invalid ip length");
+        ERROR("Invalid ip length: %zu", ip_len);
+        return -1;
+    }
+    if (ip_len > 0) {
+        (void)memcpy(dst, ip, ip_len);
+    }
+    *dst_len = ip_len;
+    return 0;
+}
+
+/* ip and gw are already parsed by decoder, they are copied inline */
+static int fill_compact_ipnet(const struct ipnet *src, const uint8_t *ip, size_t ip_len,
+                              struct compact_ipnet *ipnet_val, uint8_t *dst_ip, size_t *dst_ip_len, char **err)
+{
+    if (src == NULL) {
+        *err = clibcni_util_strdup_s("Parse cidr failed: empty address");
+        ERROR("Empty address");
+        return -1;
+    }
+    if (fill_compact_ip(src->ip, src->ip_len, ipnet_val->ip, &ipnet_val->ip_len, err) != 0 ||
+        fill_compact_ip(src->ip_mask, src->ip_mask_len, ipnet_val->ip_mask, &ipnet_val->ip_mask_len, err) != 0) {
+        return -1;
+    }
+    if (ip == NULL) {
+        return 0;
+    }
+    return fill_compact_ip(ip, ip_len, dst_ip, dst_ip_len, err);
+}
+
+static int fill_compact_ips(const struct result *src, struct compact_builder *b, struct compact_result *value,
+                            char **err)
+{
+    size_t i = 0;
+    struct compact_ipconfig *ipc = NULL;
+
+    for (i = 0; i < src->ips_len; i++) {
+        if (src->ips[i] == NULL) {
+            *err = clibcni_util_strdup_s("Convert ips failed");
+            ERROR("Invalid ip config");
+            return -1;
+        }
+        ipc = &value->ips[i];
+        if (fill_compact_ipnet(src->ips[i]->address, src->ips[i]->gateway, src->ips[i]->gateway_len, &ipc->address,
+                               ipc->gateway, &ipc->gateway_len, err) != 0) {
+            ERROR("Convert ips failed: %s", *err != NULL ? *err : "");
+            return -1;
+        }
+        ipc->version = builder_strdup(b, src->ips[i]->version);
+        if (src->ips[i]->interface != NULL) {
+            ipc->has_interface = true;
+            ipc->interface = *(src->ips[i]->interface);
+        }
+    }
+    return 0;
+}
+
+static int fill_compact_routes(const struct result *src, struct compact_result *value, char **err)
+{
+    size_t i = 0;
+    struct compact_route *rt = NULL;
+
+    for (i = 0; i < src->routes_len; i++) {
+        if (src->routes[i] == NULL) {
+            *err = clibcni_util_strdup_s("Convert routes failed");
+            ERROR("Invalid route");
+            return -1;
+        }
+        rt = &value->routes[i];
+        if (fill_compact_ipnet(src->routes[i]->dst, src->routes[i]->gw, src->routes[i]->gw_len, &rt->dst, rt->gw,
+                               &rt->gw_len, err) != 0) {
+            ERROR("Convert routes failed: %s", *err != NULL ? *err : "");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int fill_compact_result(const struct result *src, struct compact_builder *b, struct compact_result *value,
+                               char **err)
+{
+    size_t i = 0;
+    const struct dns *dns = src->my_dns;
+
+    /* same as new_curr_result, dns is required */
+    if (dns == NULL) {
+        *err = clibcni_util_strdup_s("Empty dns argument");
+        ERROR("Empty dns argument");
+        return -1;
+    }
+
+    value->cniversion = builder_strdup(b, src->cniversion);
+
+    value->interfaces_len = src->interfaces_len;
+    if (src->interfaces_len > 0) {
+        value->interfaces = builder_reserve(b, src->interfaces_len * sizeof(struct compact_interface), true);
+    }
+    for (i = 0; i < src->interfaces_len; i++) {
+        if (src->interfaces[i] == NULL) {
+            *err = clibcni_util_strdup_s("Convert interfaces failed");
+            ERROR("Convert interfaces failed");
+            return -1;
+        }
+        value->interfaces[i].name = builder_strdup(b, src->interfaces[i]->name);
+        value->interfaces[i].mac = builder_strdup(b, src->interfaces[i]->mac);
+        value->interfaces[i].sandbox = builder_strdup(b, src->interfaces[i]->sandbox);
+    }
+
+    value->ips_len = src->ips_len;
+    if (src->ips_len > 0) {
+        value->ips = builder_reserve(b, src->ips_len * sizeof(struct compact_ipconfig), true);
+    }
+    if (fill_compact_ips(src, b, value, err) != 0) {
+        return -1;
+    }
+
+    value->routes_len = src->routes_len;
+    if (src->routes_len > 0) {
+        value->routes = builder_reserve(b, src->routes_len * sizeof(struct compact_route), true);
+    }
+    if (fill_compact_routes(src, value, err) != 0) {
+        return -1;
+    }
+
+    value->dns.name_servers = builder_strarray(b, dns->name_servers, dns->name_servers_len);
+    value->dns.name_servers_len = dns->name_servers_len;
+    value->dns.domain = builder_strdup(b, dns->domain);
+    value->dns.search = builder_strarray(b, dns->search, dns->search_len);
+    value->dns.search_len = dns->search_len;
+    value->dns.options = builder_strarray(b, dns->options, dns->options_len);
+    value->dns.options_len = dns->options_len;
+    return 0;
+}
+
+static struct compact_result *get_compact_result(const struct result *src, char **err)
+{
+    struct compact_builder b = { 0 };
+    struct compact_result *value = NULL;
+    size_t size = 0;
+
+    if (!compact_result_size(src, &size)) {
+        *err = clibcni_util_strdup_s("Result too large");
+        ERROR("Result too large");
+        return NULL;
+    }
+    /* calloc returns memory aligned for any type, so is the block */
+    b.base = clibcni_util_common_calloc_s(size);
+    if (b.base == NULL) {
+        *err = clibcni_util_strdup_s("Out of memory");
+        ERROR("Out of memory");
+        return NULL;
+    }
+    value = builder_reserve(&b, sizeof(struct compact_result), true);
+    if (fill_compact_result(src, &b, value, err) != 0) {
+        free(b.base);
+        return NULL;
+    }
+    return value;
+}
+
+/* decoded by the same decoder as new_curr_result, then copied into one block */
+struct compact_result *new_curr_compact_result(const char *json_data, char **err)
+{
+    struct compact_result *ret = NULL;
+    struct result *tmp_result = NULL;
+
+    if (err == NULL) {
+        ERROR("Invalid argument");
+        return NULL;
+    }
+    if (json_data == NULL) {
+        ERROR("Json data is NULL");
+        return NULL;
+    }
+    tmp_result = decode_curr_result(json_data, err);
+    if (tmp_result == NULL) {
+        return NULL;
+    }
+    ret = get_compact_result(tmp_result, err);
+    if (ret == NULL) {
+        do_append_result_errmsg(NULL, NULL, err);
+    }
+
+    free_result(tmp_result);
+    return ret;
+}
+
+const char *compact_result_cniversion(const struct compact_result *val)
+{
+    return val != NULL ? val->cniversion : NULL;
+}
+
+size_t compact_result_interfaces_len(const struct compact_result *val)
+{
+    return val != NULL ? val->interfaces_len : 0;
+}
+
+const struct compact_interface *compact_result_interface(const struct compact_result *val, size_t i)
+{
+    if (val == NULL || i >= val->interfaces_len) {
+        return NULL;
+    }
+    return &val->interfaces[i];
+}
+
+size_t compact_result_ips_len(const struct compact_result *val)
+{
+    return val != NULL ? val->ips_len : 0;
+}
+
+const struct compact_ipconfig *compact_result_ip(const struct compact_result *val, size_t i)
+{
+    if (val == NULL || i >= val->ips_len) {
+        return NULL;
+    }
+    return &val->ips[i];
+}
+
+size_t compact_result_routes_len(const struct compact_result *val)
+{
+    return val != NULL ? val->routes_len : 0;
+}
+
+const struct compact_route *compact_result_route(const struct compact_result *val, size_t i)
+{
+    if (val == NULL || i >= val->routes_len) {
+        return NULL;
+    }
+    return &val->routes[i];
+}
+
+const struct compact_dns *compact_result_dns(const struct compact_result *val)
+{
+    return val != NULL ? &val->dns : NULL;
+}
+
+/* compact result is the start of its block */
+void free_compact_result(struct compact_result *val)
+{
+    free(val);
+}
@@ -18,10 +18,24 @@
 #include "types.h"
 #include "isula_libutils/cni_result_curr.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #define curr_implemented_spec_version "0.3.1"
 
 struct result *new_curr_result(const char *json_data, char **err);
 
+struct compact_result *new_curr_compact_result(const char *json_data, char **err);
+
+int check_curr_result(const char *json_data, char **err);
+
 cni_result_curr *cni_result_curr_to_json_result(const struct result *src, char **err);
 
+char *curr_result_to_json(const struct result *src, char **err);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -18,8 +18,6 @@
 #include <stdbool.h>
 #include <string.h>
 #include <errno.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
 
 #include "types.h"
 #include "utils.h"
@@ -192,621 +190,627 @@ static int simple_mask_len(const uint8_t *mask, size_t len)
     return ret;
 }
 
-static size_t to_ipv4(const uint8_t *src, size_t src_len, uint8_t **ipv4)
+/* ipv4 or ipv4-mapped ipv6 address, return the 4 bytes of ipv4 in it */
+static const uint8_t *as_ipv4(const uint8_t *ip, size_t len)
 {
-    uint8_t *ip = NULL;
-    bool invalid_arg = (src == NULL || ipv4 == NULL);
-
-    if (invalid_arg) {
-        return 0;
+    if (ip == NULL) {
+        return NULL;
     }
-    if (src_len == IPV4LEN) {
-        ip = clibcni_util_smart_calloc_s(IPV4LEN, sizeof(uint8_t));
-        if (ip == NULL) {
-            return 0;
-        }
-        (void)memcpy(ip, src, IPV4LEN);
-        *ipv4 = ip;
-        return IPV4LEN;
+    if (len == IPV4LEN) {
+        return ip;
     }
-
-    if (src_len == IPV6LEN && is_ipv4(src, src_len) && src[10] == 0xff && src[11] == 0xff) {
-        ip = clibcni_util_smart_calloc_s(IPV4LEN, sizeof(uint8_t));
-        if (ip == NULL) {
-            return 0;
-        }
-        size_t i = 0;
-        for (i = 0; i < IPV4LEN; i++) {
-            ip[i] = src[i + 12];
-        }
-        *ipv4 = ip;
-        return IPV4LEN;
+    if (len == IPV6LEN && is_ipv4(ip, len) && ip[10] == 0xff && ip[11] == 0xff) {
+        return ip + IPV4_TO_V6_EMPTY_PREFIX_BYTES;
     }
-    return 0;
+    return NULL;
 }
 
-// IPV6 max address "ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff"
-#define IPV6_MAX_ADDR_LEN 40
 const char g_HEX_DICT[16] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
 
-/*
- * return:
- *    0 means continue to find ip
- *    1 means get right ip
- *    -1 means something wrong
- * */
-static int do_parse_ip_to_string(const uint8_t *ip, size_t len, char **result)
-{
-    char *tmp = NULL;
-    int ret = 0;
-    int nret = 0;
-    size_t res_len = 0;
-
-    tmp = clibcni_util_uint8_join("", "%x", ip, len);
-    if (tmp == NULL) {
-        return -1;
-    }
-
-    if (strlen(tmp) > (SIZE_MAX - 2)) {
-        ret = -1;
-        goto free_out;
-    }
-
-    res_len = 1 + strlen(tmp) + 1;
-    *result = clibcni_util_common_calloc_s(res_len);
-    if (*result == NULL) {
-        ret = -1;
-        goto free_out;
-    }
-    nret = snprintf(*result, res_len, "%s%s", "?", tmp);
-    if (nret < 0 || (size_t)nret >= res_len) {
-        free(*result);
-        *result = NULL;
-        ret = -1;
-    } else {
-        ret = 1;
-    }
-
-free_out:
-    free(tmp);
-    return ret;
-}
-
-static int get_ip_string(const uint8_t *ip, size_t len, char **result)
-{
-    size_t work_ip_len = 0;
-    uint8_t *work_ip = NULL;
-    int ret = 0;
-
-    work_ip_len = to_ipv4(ip, len, &work_ip);
-    if (work_ip_len == IPV4LEN) {
-        *result = clibcni_util_uint8_join(".", "%u", work_ip, work_ip_len);
-        ret = 1; // get right result
-        goto free_out;
-    }
-    if (len != IPV6LEN) {
-        ret = do_parse_ip_to_string(ip, len, result);
-    }
-
-free_out:
-    free(work_ip);
-    return ret;
-}
-
-static void generate_ip_string(const uint8_t *ip, int e0, int e1, char **result)
+/* write digits of val without terminator, return count of written chars */
+static size_t put_uint(char *buf, unsigned int val, unsigned int base)
 {
-    int i = 0;
-    int j = 0;
+    char tmp[sizeof(unsigned int) * 8] = { 0 };
+    size_t n = 0;
+    size_t i = 0;
 
-    *result = clibcni_util_common_calloc_s(IPV6_MAX_ADDR_LEN);
-    if (*result == NULL) {
-        return;
-    }
-    for (i = 0, j = 0; i < IPV6LEN; i += 2) {
-        if (i == e0) {
-            (*result)[j++] = ':';
-            (*result)[j++] = ':';
-            i = e1;
-            if (i >= IPV6LEN) {
-                break;
-            }
-        } else if (i > 0) {
-            (*result)[j++] = ':';
-        }
-        uint32_t nret = (ip[i] << 8) | ip[i + 1];
-        if (sprintf((*result) + j, "%x", nret) < 0) {
-            ERROR("sprint ip failed");
-            free(*result);
-            *result = NULL;
-            return;
-        }
-        j = strlen(*result);
+    do {
+        tmp[n++] = g_HEX_DICT[val % base];
+        val /= base;
+    } while (val != 0);
+    for (i = 0; i < n; i++) {
+        buf[i] = tmp[n - 1 - i];
     }
-    return;
+    return n;
 }
 
-char *ip_to_string(const uint8_t *ip, size_t len)
+/* the longest run of at least two zero groups, compressed as "::" */
+static void find_zero_groups(const uint8_t *ip, int *e0, int *e1)
 {
-    char *result = NULL;
     int i = 0;
     int j = 0;
-    int e0 = 0;
-    int e1 = 0;
 
-    if (len == 0) {
-        return clibcni_util_strdup_s("<nil>");
-    }
-
-    if (get_ip_string(ip, len, &result) != 0) {
-        goto free_out;
-    }
-
-    /* find zeros */
-    e0 = e1 = -1;
+    *e0 = *e1 = -1;
     for (i = 0; i < IPV6LEN; i += 2) {
         j = i;
         while (j < IPV6LEN && ip[j] == 0 && ip[j + 1] == 0) {
             j += 2;
         }
-        if (j > i && (j - i) > (e1 - e0)) {
-            e0 = i;
-            e1 = j;
+        if (j > i && (j - i) > (*e1 - *e0)) {
+            *e0 = i;
+            *e1 = j;
             i = j;
         }
     }
 
-    if (e1 - e0 <= 2) {
-        e1 = -1;
-        e0 = -1;
+    if (*e1 - *e0 <= 2) {
+        *e1 = -1;
+        *e0 = -1;
     }
-
-    generate_ip_string(ip, e0, e1, &result);
-
-free_out:
-    return result;
 }
 
-static char *mask_hex_string(const uint8_t *mask, size_t len)
+/* buf must hold IP_STRING_BUF_LEN, return length of text or 0 for invalid ip */
+static size_t format_ip(const uint8_t *ip, size_t len, char *buf)
 {
-    char *result = NULL;
-    size_t res_len = 0;
-    size_t i = 0;
-    size_t j = 0;
+    const uint8_t *ipv4 = NULL;
+    size_t pos = 0;
+    int i = 0;
+    int e0 = 0;
+    int e1 = 0;
 
     if (len == 0) {
-        return clibcni_util_strdup_s("<nil>");
+        (void)memcpy(buf, "<nil>", sizeof("<nil>"));
+        return sizeof("<nil>") - 1;
     }
 
-    if (len > ((SIZE_MAX - 1) / 2)) {
-        return NULL;
-    }
-    res_len = (len * 2) + 1;
-
-    result = clibcni_util_common_calloc_s(res_len);
-    if (result == NULL) {
-        return NULL;
+    ipv4 = as_ipv4(ip, len);
+    if (ipv4 != NULL) {
+        for (i = 0; i < IPV4LEN; i++) {
+            if (i > 0) {
+                buf[pos++] = '.';
+            }
+            pos += put_uint(buf + pos, ipv4[i], 10);
+        }
+        buf[pos] = '\0';
+        return pos;
     }
-    for (i = 0, j = 0; i < len; i++) {
-        int tmp = (mask[i] >> 4);
-        result[j++] = g_HEX_DICT[tmp];
-        tmp = (mask[i] & 0x0f);
-        result[j++] = g_HEX_DICT[tmp];
+    if (ip == NULL || len != IPV6LEN) {
+        return 0;
     }
-    return result;
-}
 
-static size_t try_to_ipv4(const struct ipnet *value, uint8_t **pip, char **err)
-{
-    size_t iplen = 0;
-
-    iplen = to_ipv4(value->ip, value->ip_len, pip);
-    if (iplen == 0) {
-        if (value->ip_len == IPV6LEN) {
-            *pip = clibcni_util_smart_calloc_s(IPV6LEN, sizeof(uint8_t));
-            if (*pip == NULL) {
-                ERROR("Out of memory");
-                *err = clibcni_util_strdup_s("Out of memory");
-                return 0;
-            }
-            (void)memcpy(*pip, value->ip, IPV6LEN);
-            iplen = IPV6LEN;
-        } else {
-            if (asprintf(err, "Invalid ip, len=%lu", iplen) < 0) {
-                ERROR("Out of memory");
-                *err = clibcni_util_strdup_s("Out of memory");
+    find_zero_groups(ip, &e0, &e1);
+    for (i = 0; i < IPV6LEN; i += 2) {
+        if (i == e0) {
+            buf[pos++] = ':';
+            buf[pos++] = ':';
+            i = e1;
+            if (i >= IPV6LEN) {
+                break;
             }
-            return 0;
+        } else if (i > 0) {
+            buf[pos++] = ':';
         }
+        pos += put_uint(buf + pos, ((unsigned int)ip[i] << 8) | ip[i + 1], 16);
     }
-    return iplen;
+    buf[pos] = '\0';
+    return pos;
 }
 
-static int get_ipv4_mask(const struct ipnet *value, size_t iplen, uint8_t **mask, char **err)
+int ip_to_buffer(const uint8_t *ip, size_t len, char *buf, size_t buf_len)
 {
-    if (iplen != IPV4LEN) {
-        int nret = asprintf(err, "len of IP: %lu diffrent to len of mask: %lu", iplen, value->ip_mask_len);
-        if (nret < 0) {
-            *err = clibcni_util_strdup_s("Out of memory");
-            ERROR("Out of memory");
-        }
-        return 0;
-    }
-    *mask = clibcni_util_smart_calloc_s(IPV4LEN, sizeof(uint8_t));
-    if (*mask == NULL) {
-        *err = clibcni_util_strdup_s("Out of memory");
-        ERROR("Out of memory");
+    if (buf == NULL || buf_len < IP_STRING_BUF_LEN) {
+        ERROR("Invalid arguments");
         return -1;
     }
-    (void)memcpy(*mask, value->ip_mask, IPV4LEN);
-    return IPV4LEN;
+
+    return format_ip(ip, len, buf) > 0 ? 0 : -1;
 }
 
-static int get_ipv6_mask(const struct ipnet *value, size_t iplen, uint8_t **mask, char **err)
+char *ip_to_string(const uint8_t *ip, size_t len)
 {
-    if (iplen == IPV4LEN) {
-        *mask = clibcni_util_smart_calloc_s(IPV4LEN, sizeof(uint8_t));
-        if (*mask == NULL) {
-            *err = clibcni_util_strdup_s("Out of memory");
-            ERROR("Out of memory");
-            return 0;
-        }
-        (void)memcpy(*mask, (value->ip_mask + IPV4_TO_V6_EMPTY_PREFIX_BYTES), IPV4LEN);
-        return IPV4LEN;
-    } else {
-        (void)memcpy(*mask, value->ip_mask, IPV6LEN);
-        return IPV6LEN;
+    char buf[IP_STRING_BUF_LEN] = { 0 };
+
+    if (format_ip(ip, len, buf) == 0) {
+        return NULL;
     }
+    return clibcni_util_strdup_s(buf);
 }
 
-static size_t try_get_mask(const struct ipnet *value, size_t iplen, uint8_t **mask, char **err)
+/* ipv4 is printed with the last 4 bytes of a 16 bytes mask, as go net.IPNet */
+static int get_ipnet_mask(const uint8_t *mask, size_t mask_len, size_t ip_len, const uint8_t **work_mask,
+                          size_t *work_mask_len, char **err)
 {
-    size_t masklen = 0;
-    int nret = 0;
-
-    switch (value->ip_mask_len) {
+    switch (mask_len) {
         case IPV4LEN:
-            nret = get_ipv4_mask(value, iplen, mask, err);
-            if (nret == 0) {
-                return 0;
-            } else if (nret < 0) {
-                goto free_out;
+            if (ip_len != IPV4LEN) {
+                if (asprintf(err, "len of IP: %zu diffrent to len of mask: %zu", ip_len, mask_len) < 0) {
+                    *err = clibcni_util_strdup_s("Out of memory");
+                    ERROR("Out of memory");
+                }
+                return -1;
             }
-            masklen = (size_t)nret;
+            *work_mask = mask;
+            *work_mask_len = IPV4LEN;
             break;
         case IPV6LEN:
-            nret = get_ipv6_mask(value, iplen, mask, err);
-            if (nret == 0) {
-                return 0;
-            } else if (nret < 0) {
-                goto free_out;
+            if (ip_len == IPV4LEN) {
+                *work_mask = mask + IPV4_TO_V6_EMPTY_PREFIX_BYTES;
+                *work_mask_len = IPV4LEN;
+            } else {
+                *work_mask = mask;
+                *work_mask_len = IPV6LEN;
             }
-            masklen = (size_t)nret;
             break;
         default:
-            nret = asprintf(err, "Invalid mask len: %lu", value->ip_mask_len);
-            if (nret < 0) {
+            if (asprintf(err, "Invalid mask len: %zu", mask_len) < 0) {
                 *err = clibcni_util_strdup_s("Out of memory");
                 ERROR("Out of memory");
             }
-            goto free_out;
+            return -1;
     }
-    return masklen;
-free_out:
-    free(*mask);
-    *mask = NULL;
     return 0;
 }
 
-static char *do_generate_ip_with_mask(const uint8_t *mask, size_t masklen, const char *ip, char **err)
+/* buf must hold IPNET_STRING_BUF_LEN */
+static int format_ipnet(const uint8_t *ip, size_t ip_len, const uint8_t *mask, size_t mask_len, char *buf,
+                        char **err)
 {
-    char *tmp_mask = NULL;
-    char *result = NULL;
-    int nret = 0;
-    size_t res_len = 0;
+    const uint8_t *work_ip = NULL;
+    size_t work_ip_len = IPV4LEN;
+    const uint8_t *work_mask = NULL;
+    size_t work_mask_len = 0;
+    size_t pos = 0;
+    size_t i = 0;
+    int slen = 0;
 
-    if (ip == NULL) {
-        return NULL;
+    work_ip = as_ipv4(ip, ip_len);
+    if (work_ip == NULL) {
+        if (ip == NULL || ip_len != IPV6LEN) {
+            if (asprintf(err, "Invalid ip, len=%zu", ip_len) < 0) {
+                ERROR("Out of memory");
+                *err = clibcni_util_strdup_s("Out of memory");
+            }
+            return -1;
+        }
+        work_ip = ip;
+        work_ip_len = IPV6LEN;
     }
-    tmp_mask = mask_hex_string(mask, masklen);
-    if (tmp_mask == NULL) {
-        *err = clibcni_util_strdup_s("Mask toString failed");
-        ERROR("Mask toString failed");
-        goto free_out;
+
+    if (mask == NULL || get_ipnet_mask(mask, mask_len, work_ip_len, &work_mask, &work_mask_len, err) != 0) {
+        if (*err == NULL) {
+            *err = clibcni_util_strdup_s("Invalid mask");
+        }
+        return -1;
     }
 
-    if (strlen(ip) > ((SIZE_MAX - 2) - strlen(tmp_mask))) {
-        *err = clibcni_util_strdup_s("Too long ips");
-        ERROR("Too long ips");
-        goto free_out;
+    pos = format_ip(work_ip, work_ip_len, buf);
+    buf[pos++] = '/';
+    slen = simple_mask_len(work_mask, work_mask_len);
+    if (slen >= 0) {
+        pos += put_uint(buf + pos, (unsigned int)slen, 10);
+    } else {
+        for (i = 0; i < work_mask_len; i++) {
+            buf[pos++] = g_HEX_DICT[work_mask[i] >> 4];
+            buf[pos++] = g_HEX_DICT[work_mask[i] & 0x0f];
+        }
     }
+    buf[pos] = '\0';
+    return 0;
+}
 
-    res_len = strlen(ip) + 1 + strlen(tmp_mask) + 1;
-    result = clibcni_util_common_calloc_s(res_len);
-    if (result == NULL) {
-        *err = clibcni_util_strdup_s("Out of memory");
-        ERROR("Out of memory");
-        goto free_out;
+int ipnet_to_buffer(const struct ipnet *value, char *buf, size_t buf_len, char **err)
+{
+    if (value == NULL || buf == NULL || buf_len < IPNET_STRING_BUF_LEN || err == NULL) {
+        ERROR("Invalid arguments");
+        return -1;
     }
-    nret = snprintf(result, res_len, "%s/%s", ip, tmp_mask);
-    if (nret < 0 || (size_t)nret >= res_len) {
-        *err = clibcni_util_strdup_s("Sprintf first type failed");
-        ERROR("Sprintf failed");
-        free(result);
-        result = NULL;
+
+    return format_ipnet(value->ip, value->ip_len, value->ip_mask, value->ip_mask_len, buf, err);
+}
+
+int compact_ipnet_to_buffer(const struct compact_ipnet *value, char *buf, size_t buf_len, char **err)
+{
+    if (value == NULL || buf == NULL || buf_len < IPNET_STRING_BUF_LEN || err == NULL) {
+        ERROR("Invalid arguments");
+        return -1;
     }
-free_out:
-    free(tmp_mask);
-    return result;
+
+    return format_ipnet(value->ip, value->ip_len, value->ip_mask, value->ip_mask_len, buf, err);
 }
 
 char *ipnet_to_string(const struct ipnet *value, char **err)
 {
-    char *result = NULL;
-    char *tmp_ip = NULL;
-    uint8_t *ip = NULL;
-    uint8_t *mask = NULL;
-    size_t iplen = 0;
-    size_t masklen = 0;
-    int slen = 0;
-    int nret = 0;
-    size_t res_len = 0;
+    char buf[IPNET_STRING_BUF_LEN] = { 0 };
 
-    iplen = try_to_ipv4(value, &ip, err);
-    if (iplen == 0) {
-        goto free_out;
+    if (ipnet_to_buffer(value, buf, sizeof(buf), err) != 0) {
+        return NULL;
     }
+    return clibcni_util_strdup_s(buf);
+}
+
+static bool result_ip_strings_size(const struct result *value, size_t *slots, size_t *total)
+{
+    size_t ptrs = 0;
 
-    masklen = try_get_mask(value, iplen, &mask, err);
-    if (masklen == 0) {
-        goto free_out;
+    if (value->ips_len > SIZE_MAX / 2 || value->routes_len > SIZE_MAX / 2 ||
+        value->ips_len * 2 > SIZE_MAX - value->routes_len * 2) {
+        return false;
     }
+    *slots = value->ips_len * 2 + value->routes_len * 2;
+    if (*slots > (SIZE_MAX - sizeof(struct result_ip_strings)) / (sizeof(char *) + IPNET_STRING_BUF_LEN)) {
+        return false;
+    }
+    ptrs = *slots * sizeof(char *);
+    *total = sizeof(struct result_ip_strings) + ptrs + *slots * IPNET_STRING_BUF_LEN;
+    return true;
+}
 
-    slen = simple_mask_len(mask, masklen);
-    tmp_ip = ip_to_string(ip, iplen);
-    if (tmp_ip == NULL) {
-        *err = clibcni_util_strdup_s("IP toString failed");
-        ERROR("IP toString failed");
-        goto free_out;
+static int fill_result_ip_strings(const struct result *value, struct result_ip_strings *strs, char *slot, char **err)
+{
+    size_t i = 0;
+
+    for (i = 0; i < value->ips_len; i++, slot += 2 * IPNET_STRING_BUF_LEN) {
+        if (value->ips[i] == NULL) {
+            *err = clibcni_util_strdup_s("Invalid ip config");
+            ERROR("Invalid ip config");
+            return -1;
+        }
+        if (value->ips[i]->address != NULL) {
+            if (ipnet_to_buffer(value->ips[i]->address, slot, IPNET_STRING_BUF_LEN, err) != 0) {
+                return -1;
+            }
+            strs->ip_addresses[i] = slot;
+        }
+        if (value->ips[i]->gateway_len > 0) {
+            if (format_ip(value->ips[i]->gateway, value->ips[i]->gateway_len, slot + IPNET_STRING_BUF_LEN) == 0) {
+                *err = clibcni_util_strdup_s("ip to string failed");
+                ERROR("ip to string failed");
+                return -1;
+            }
+            strs->ip_gateways[i] = slot + IPNET_STRING_BUF_LEN;
+        }
     }
-    if (slen == -1) {
-        result = do_generate_ip_with_mask(mask, masklen, tmp_ip, err);
-        goto free_out;
+
+    for (i = 0; i < value->routes_len; i++, slot += 2 * IPNET_STRING_BUF_LEN) {
+        if (value->routes[i] == NULL) {
+            *err = clibcni_util_strdup_s("Invalid route");
+            ERROR("Invalid route");
+            return -1;
+        }
+        if (value->routes[i]->dst != NULL) {
+            if (ipnet_to_buffer(value->routes[i]->dst, slot, IPNET_STRING_BUF_LEN, err) != 0) {
+                return -1;
+            }
+            strs->route_dsts[i] = slot;
+        }
+        if (value->routes[i]->gw_len > 0) {
+            if (format_ip(value->routes[i]->gw, value->routes[i]->gw_len, slot + IPNET_STRING_BUF_LEN) == 0) {
+                *err = clibcni_util_strdup_s("ip to string failed");
+                ERROR("ip to string failed");
+                return -1;
+            }
+            strs->route_gws[i] = slot + IPNET_STRING_BUF_LEN;
+        }
     }
+    return 0;
+}
 
-    if (strlen(tmp_ip) > (SIZE_MAX - 5)) {
-        *err = clibcni_util_strdup_s("Too long ips");
-        goto free_out;
+struct result_ip_strings *result_ip_strings(const struct result *value, char **err)
+{
+    struct result_ip_strings *strs = NULL;
+    const char **ptrs = NULL;
+    size_t slots = 0;
+    size_t total = 0;
+
+    if (value == NULL || err == NULL) {
+        ERROR("Invalid arguments");
+        return NULL;
+    }
+    if (!result_ip_strings_size(value, &slots, &total)) {
+        *err = clibcni_util_strdup_s("Too many ips and routes");
+        ERROR("Too many ips and routes");
+        return NULL;
     }
 
-    res_len = strlen(tmp_ip) + 1 + 3 + 1;
-    result = clibcni_util_common_calloc_s(res_len);
-    if (result == NULL) {
+    strs = clibcni_util_common_calloc_s(total);
+    if (strs == NULL) {
         *err = clibcni_util_strdup_s("Out of memory");
         ERROR("Out of memory");
-        goto free_out;
+        return NULL;
     }
-    nret = snprintf(result, res_len, "%s/%d", tmp_ip, slen);
-    if (nret < 0 || (size_t)nret >= res_len) {
-        ERROR("Sprintf failed");
-        *err = clibcni_util_strdup_s("Sprintf second type failed");
-        free(result);
-        result = NULL;
+    ptrs = (const char **)(strs + 1);
+    strs->ips_len = value->ips_len;
+    strs->ip_addresses = ptrs;
+    strs->ip_gateways = ptrs + value->ips_len;
+    strs->routes_len = value->routes_len;
+    strs->route_dsts = ptrs + value->ips_len * 2;
+    strs->route_gws = ptrs + value->ips_len * 2 + value->routes_len;
+
+    if (fill_result_ip_strings(value, strs, (char *)(ptrs + slots), err) != 0) {
+        free(strs);
+        return NULL;
     }
+    return strs;
+}
 
-free_out:
-    free(tmp_ip);
-    free(mask);
-    free(ip);
-    return result;
+void free_result_ip_strings(struct result_ip_strings *val)
+{
+    free(val);
 }
 
-static int get_ip_from_in6_addr(const struct in6_addr *ipv6, uint8_t **ip, size_t *len)
+static inline int hex_digit_value(char c)
 {
-    uint8_t *result = NULL;
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
 
-    if (ipv6 == NULL) {
-        return 0;
+/* dotted decimal as inet_pton(AF_INET): four parts of 0-255 without leading zero */
+static const char *scan_ipv4(const char *str, const char *end, uint8_t *ip)
+{
+    const char *pos = str;
+    size_t part = 0;
+    unsigned int val = 0;
+    size_t digits = 0;
+
+    for (part = 0; part < IPV4LEN; part++) {
+        if (part > 0) {
+            if (pos >= end || *pos != '.') {
+                return NULL;
+            }
+            pos++;
+        }
+        val = 0;
+        for (digits = 0; pos < end && *pos >= '0' && *pos <= '9'; digits++, pos++) {
+            if (digits > 0 && val == 0) {
+                return NULL;
+            }
+            val = val * 10 + (unsigned int)(*pos - '0');
+            if (val > 255) {
+                return NULL;
+            }
+        }
+        if (digits == 0) {
+            return NULL;
+        }
+        ip[part] = (uint8_t)val;
     }
-    result = clibcni_util_smart_calloc_s(IPV6LEN, sizeof(uint8_t));
-    if (result == NULL) {
-        ERROR("Out of memory");
-        return -1;
+    return pos;
+}
+
+/* as inet_pton(AF_INET6), the last 32 bits may be written as dotted decimal */
+static const char *scan_ipv6(const char *str, const char *end, uint8_t *ip)
+{
+    const char *pos = str;
+    const char *group = NULL;
+    size_t filled = 0;
+    size_t gap = IPV6LEN + 1;
+    unsigned int val = 0;
+    int digit = 0;
+    size_t digits = 0;
+
+    if (pos + 1 < end && pos[0] == ':' && pos[1] == ':') {
+        gap = 0;
+        pos += 2;
+    }
+    while (pos < end && filled < IPV6LEN) {
+        group = pos;
+        val = 0;
+        for (digits = 0; pos < end && (digit = hex_digit_value(*pos)) >= 0; digits++, pos++) {
+            val = (val << 4) | (unsigned int)digit;
+        }
+        if (pos < end && *pos == '.' && filled + IPV4LEN <= IPV6LEN) {
+            pos = scan_ipv4(group, end, ip + filled);
+            if (pos == NULL) {
+                return NULL;
+            }
+            filled += IPV4LEN;
+            break;
+        }
+        if (digits == 0 || digits > 4) {
+            return NULL;
+        }
+        ip[filled++] = (uint8_t)(val >> 8);
+        ip[filled++] = (uint8_t)(val & 0xff);
+        if (pos >= end || *pos != ':') {
+            break;
+        }
+        pos++;
+        if (pos < end && *pos == ':') {
+            if (gap <= IPV6LEN) {
+                return NULL;
+            }
+            gap = filled;
+            pos++;
+        } else if (pos >= end) {
+            /* trailing single colon */
+            return NULL;
+        }
     }
-    (void)memcpy(result, ipv6->s6_addr, IPV6LEN * sizeof(uint8_t));
 
-    *ip = result;
-    *len = IPV6LEN;
-    return 0;
+    if (gap <= IPV6LEN) {
+        if (filled == IPV6LEN) {
+            return NULL;
+        }
+        (void)memmove(ip + gap + (IPV6LEN - filled), ip + gap, filled - gap);
+        (void)memset(ip + gap, 0, IPV6LEN - filled);
+        filled = IPV6LEN;
+    }
+    return filled == IPV6LEN ? pos : NULL;
 }
 
-static int get_ip_from_in_addr(const struct in_addr *ipv4, uint8_t **ip, size_t *len)
+static int parse_ip_range(const char *str, const char *end, uint8_t *ip, size_t *len)
 {
-    uint8_t *result = NULL;
-    size_t i = 0;
-    uint32_t work = 0;
+    const char *pos = NULL;
 
-    if (ipv4 == NULL) {
+    pos = scan_ipv4(str, end, ip);
+    if (pos == end) {
+        *len = IPV4LEN;
         return 0;
     }
-    result = clibcni_util_smart_calloc_s(IPV4LEN, sizeof(uint8_t));
-    if (result == NULL) {
-        ERROR("Out of memory");
-        return -1;
-    }
-    work = ipv4->s_addr;
-    for (i = 0; i < IPV4LEN; i++) {
-        result[i] = (uint8_t)(work & 0x0ff);
-        work >>= 8;
+    pos = scan_ipv6(str, end, ip);
+    if (pos == end) {
+        *len = IPV6LEN;
+        return 0;
     }
-
-    *ip = result;
-    *len = IPV4LEN;
-    return 0;
+    return -1;
 }
 
-static int do_parse_ipv6_from_str(const char *addr, struct in6_addr *ipv6, uint8_t **ips, size_t *len, int *ret,
-                                  char **err)
+int parse_ip_into(const char *addr, uint8_t *ip, size_t *len, char **err)
 {
-    int nret = 0;
-
-    if (addr == NULL) {
+    if (addr == NULL || ip == NULL || len == NULL) {
         ERROR("Empty address");
         return -1;
     }
-    nret = inet_pton(AF_INET6, addr, ipv6);
-    if (nret < 0) {
-        nret = asprintf(err, "ipv6 inet_pton %s", strerror(errno));
-        if (nret < 0) {
-            ERROR("Sprintf failed");
-            *ret = 1;
-        }
-        return -1;
-    } else if (nret == 0) {
-        nret = asprintf(err, "Invalid ip address: %s", addr);
-        if (nret < 0) {
+
+    if (parse_ip_range(addr, addr + strlen(addr), ip, len) != 0) {
+        if (asprintf(err, "Invalid ip address: %s", addr) < 0) {
             ERROR("Sprintf failed");
-            *ret = 1;
+            return 1;
         }
         return -1;
     }
-
-    *ret = get_ip_from_in6_addr(ipv6, ips, len);
-
-    return *ret;
+    return 0;
 }
 
 int parse_ip_from_str(const char *addr, uint8_t **ips, size_t *len, char **err)
 {
-    int nret = 0;
-    struct in_addr ipv4;
-    struct in6_addr ipv6;
-    int ret = -1;
+    uint8_t buf[IPV6LEN] = { 0 };
+    size_t buf_len = 0;
+    int ret = 0;
 
-    if (addr == NULL) {
-        ERROR("Empty address");
-        return -1;
+    ret = parse_ip_into(addr, buf, &buf_len, err);
+    if (ret != 0) {
+        return ret;
     }
-    nret = inet_pton(AF_INET, addr, &ipv4);
-    if (nret < 0) {
-        nret = asprintf(err, "ipv4 inet_pton %s", strerror(errno));
-        if (nret < 0) {
-            ERROR("Sprintf failed");
-            ret = 1;
-        }
-        goto free_out;
-    } else if (nret == 0) {
-        /* check ipv6 */
-        nret = do_parse_ipv6_from_str(addr, &ipv6, ips, len, &ret, err);
-        if (nret != 0) {
-            goto free_out;
-        }
-    } else {
-        nret = get_ip_from_in_addr(&ipv4, ips, len);
-        if (nret != 0) {
-            goto free_out;
-        }
+    *ips = clibcni_util_smart_calloc_s(buf_len, sizeof(uint8_t));
+    if (*ips == NULL) {
+        *err = clibcni_util_strdup_s("Out of memory");
+        ERROR("Out of memory");
+        return -1;
     }
-    ret = 0;
-free_out:
-    return ret;
+    (void)memcpy(*ips, buf, buf_len);
+    *len = buf_len;
+    return 0;
 }
 
-static int do_parse_mask_in_cidr(unsigned int mask_num, struct ipnet *result, char **err)
+static void fill_mask_in_cidr(unsigned int mask_num, uint8_t *mask, size_t len)
 {
     uint8_t full_mask = 0xff;
-    size_t j = 0;
     size_t i = 0;
     unsigned int mask_cnt = mask_num;
 
-    j = result->ip_len;
-
-    result->ip_mask = clibcni_util_smart_calloc_s(j, sizeof(uint8_t));
-    if (result->ip_mask == NULL) {
-        *err = clibcni_util_strdup_s("Out of memory");
-        ERROR("Out of memory");
-        return -1;
-    }
-    result->ip_mask_len = j;
-    for (i = 0; i < j; i++) {
+    for (i = 0; i < len; i++) {
         if (mask_cnt >= 8) {
-            result->ip_mask[i] = full_mask;
+            mask[i] = full_mask;
             mask_cnt -= 8;
             continue;
         }
-        result->ip_mask[i] = ~(full_mask >> mask_cnt);
+        mask[i] = (uint8_t)~(full_mask >> mask_cnt);
         mask_cnt = 0;
     }
-    return 0;
 }
 
-int parse_cidr(const char *cidr_str, struct ipnet **ipnet_val, char **err)
+/* prefix length is plain decimal, at most the bits of address */
+static int parse_cidr_mask(const char *str, size_t ip_len, unsigned int *mask_num)
 {
-    char *pos = NULL;
-    char *addr = NULL;
-    char *mask = NULL;
-    char *work_cidr = NULL;
-    int nret = 0;
-    unsigned int mask_num = 0;
-    int ret = -1;
-    struct ipnet *result = NULL;
+    const char *pos = str;
+    unsigned int val = 0;
 
-    if (cidr_str == NULL) {
+    if (*pos == '\0') {
         return -1;
     }
+    for (; *pos != '\0'; pos++) {
+        if (*pos < '0' || *pos > '9') {
+            return -1;
+        }
+        val = val * 10 + (unsigned int)(*pos - '0');
+        if (val > ip_len * 8) {
+            return -1;
+        }
+    }
+    *mask_num = val;
+    return 0;
+}
 
-    work_cidr = clibcni_util_strdup_s(cidr_str);
+int parse_cidr_into(const char *cidr_str, struct compact_ipnet *ipnet_val, char **err)
+{
+    const char *pos = NULL;
+    unsigned int mask_num = 0;
 
-    result = clibcni_util_common_calloc_s(sizeof(struct ipnet));
-    if (result == NULL) {
-        ERROR("Out of memory");
-        goto free_out;
+    if (cidr_str == NULL || ipnet_val == NULL) {
+        return -1;
     }
-    pos = strchr(work_cidr, '/');
+
+    pos = strchr(cidr_str, '/');
     if (pos == NULL) {
-        nret = asprintf(err, "CIDR address %s", work_cidr);
-        if (nret < 0) {
+        if (asprintf(err, "CIDR address %s", cidr_str) < 0) {
             ERROR("Sprintf failed");
-            ret = 1;
+            return 1;
         }
-        goto free_out;
+        return -1;
     }
-    *pos = '\0';
-    addr = work_cidr;
-    mask = pos + 1;
 
-    nret = parse_ip_from_str(addr, &(result->ip), &(result->ip_len), err);
-    if (nret != 0) {
-        ret = -1;
-        goto free_out;
+    if (parse_ip_range(cidr_str, pos, ipnet_val->ip, &ipnet_val->ip_len) != 0) {
+        if (asprintf(err, "Invalid ip address: %.*s", (int)(pos - cidr_str), cidr_str) < 0) {
+            ERROR("Sprintf failed");
+            return 1;
+        }
+        return -1;
     }
 
-    nret = clibcni_util_safe_uint(mask, &mask_num);
-    if (nret != 0 || (size_t)(mask_num >> 3) > result->ip_len) {
-        nret = asprintf(err, "Invalid CIDR address %s", cidr_str);
-        if (nret < 0) {
+    if (parse_cidr_mask(pos + 1, ipnet_val->ip_len, &mask_num) != 0) {
+        if (asprintf(err, "Invalid CIDR address %s", cidr_str) < 0) {
             ERROR("Sprintf failed");
             *err = clibcni_util_strdup_s("Asprintf cidr failed");
-            ret = 1;
+            return 1;
         }
-        goto free_out;
+        return -1;
     }
 
-    /* parse mask */
-    if (do_parse_mask_in_cidr(mask_num, result, err) != 0) {
-        ret = -1;
-        goto free_out;
+    ipnet_val->ip_mask_len = ipnet_val->ip_len;
+    fill_mask_in_cidr(mask_num, ipnet_val->ip_mask, ipnet_val->ip_mask_len);
+    return 0;
+}
+
+int parse_cidr(const char *cidr_str, struct ipnet **ipnet_val, char **err)
+{
+    struct compact_ipnet buf = { 0 };
+    struct ipnet *result = NULL;
+    int ret = 0;
+
+    ret = parse_cidr_into(cidr_str, &buf, err);
+    if (ret != 0) {
+        return ret;
     }
-    *ipnet_val = result;
-    result = NULL;
-    ret = 0;
 
-free_out:
-    free(work_cidr);
-    if (result != NULL) {
-        free(result->ip);
-        free(result->ip_mask);
-        free(result);
+    result = clibcni_util_common_calloc_s(sizeof(struct ipnet));
+    if (result == NULL) {
+        *err = clibcni_util_strdup_s("Out of memory");
+        ERROR("Out of memory");
+        return -1;
     }
-    return ret;
+    result->ip = clibcni_util_smart_calloc_s(buf.ip_len, sizeof(uint8_t));
+    result->ip_mask = clibcni_util_smart_calloc_s(buf.ip_mask_len, sizeof(uint8_t));
+    if (result->ip == NULL || result->ip_mask == NULL) {
+        *err = clibcni_util_strdup_s("Out of memory");
+        ERROR("Out of memory");
+        free_ipnet_type(result);
+        return -1;
+    }
+    (void)memcpy(result->ip, buf.ip, buf.ip_len);
+    result->ip_len = buf.ip_len;
+    (void)memcpy(result->ip_mask, buf.ip_mask, buf.ip_mask_len);
+    result->ip_mask_len = buf.ip_mask_len;
+
+    *ipnet_val = result;
+    return 0;
 }
 
@@ -15,6 +15,7 @@
 #ifndef CLIBCNI_TYPES_TYPES_H
 #define CLIBCNI_TYPES_TYPES_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <sys/types.h>
 
@@ -26,6 +27,12 @@ extern "C" {
 
 #define IPV6LEN 16
 
+/* longest ip text "ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff" and terminator */
+#define IP_STRING_BUF_LEN 40
+
+/* ip text, '/', and prefix length or hex of a non-canonical ipv6 mask */
+#define IPNET_STRING_BUF_LEN (IP_STRING_BUF_LEN + 1 + IPV6LEN * 2)
+
 /* define types for version */
 struct interface {
     char *name;
@@ -84,6 +91,74 @@ struct result {
     struct dns *my_dns;
 };
 
+/*
+ * compact result: whole result lives in one allocation, ip and mask are stored
+ * inline, use accessor functions to read it and free_compact_result to release it
+ * */
+struct compact_ipnet {
+    uint8_t ip[IPV6LEN];
+    size_t ip_len;
+
+    uint8_t ip_mask[IPV6LEN];
+    size_t ip_mask_len;
+};
+
+struct compact_interface {
+    const char *name;
+    const char *mac;
+    const char *sandbox;
+};
+
+struct compact_ipconfig {
+    const char *version;
+    bool has_interface;
+    int32_t interface;
+    struct compact_ipnet address;
+
+    uint8_t gateway[IPV6LEN];
+    size_t gateway_len;
+};
+
+struct compact_route {
+    struct compact_ipnet dst;
+
+    uint8_t gw[IPV6LEN];
+    size_t gw_len;
+};
+
+struct compact_dns {
+    const char * const *name_servers;
+    size_t name_servers_len;
+
+    const char *domain;
+
+    const char * const *search;
+    size_t search_len;
+
+    const char * const *options;
+    size_t options_len;
+};
+
+struct compact_result;
+
+const char *compact_result_cniversion(const struct compact_result *val);
+
+size_t compact_result_interfaces_len(const struct compact_result *val);
+
+const struct compact_interface *compact_result_interface(const struct compact_result *val, size_t i);
+
+size_t compact_result_ips_len(const struct compact_result *val);
+
+const struct compact_ipconfig *compact_result_ip(const struct compact_result *val, size_t i);
+
+size_t compact_result_routes_len(const struct compact_result *val);
+
+const struct compact_route *compact_result_route(const struct compact_result *val, size_t i);
+
+const struct compact_dns *compact_result_dns(const struct compact_result *val);
+
+void free_compact_result(struct compact_result *val);
+
 void free_ipnet_type(struct ipnet *val);
 
 void free_ipconfig_type(struct ipconfig *ipc);
@@ -100,12 +175,43 @@ int parse_ip_from_str(const char *addr, uint8_t **ips, size_t *len, char **err);
 
 int parse_cidr(const char *cidr_str, struct ipnet **ipnet_val, char **err);
 
+/* parse into caller buffers without allocation, ip must hold IPV6LEN bytes */
+int parse_ip_into(const char *addr, uint8_t *ip, size_t *len, char **err);
+
+int parse_cidr_into(const char *cidr_str, struct compact_ipnet *ipnet_val, char **err);
+
 /* common tool functions */
 
 char *ipnet_to_string(const struct ipnet *value, char **err);
 
 char *ip_to_string(const uint8_t *ip, size_t len);
 
+/* format into caller buffers without allocation, buf_len must be at least IP_STRING_BUF_LEN
+ * or IPNET_STRING_BUF_LEN */
+int ip_to_buffer(const uint8_t *ip, size_t len, char *buf, size_t buf_len);
+
+int ipnet_to_buffer(const struct ipnet *value, char *buf, size_t buf_len, char **err);
+
+int compact_ipnet_to_buffer(const struct compact_ipnet *value, char *buf, size_t buf_len, char **err);
+
+/*
+ * text of all addresses of a result, formatted in one pass into one allocation.
+ * item i of each array belongs to ips[i] or routes[i], NULL if that field is not set.
+ * */
+struct result_ip_strings {
+    size_t ips_len;
+    const char **ip_addresses;
+    const char **ip_gateways;
+
+    size_t routes_len;
+    const char **route_dsts;
+    const char **route_gws;
+};
+
+struct result_ip_strings *result_ip_strings(const struct result *value, char **err);
+
+void free_result_ip_strings(struct result_ip_strings *val);
+
 #ifdef __cplusplus
 }
 #endif
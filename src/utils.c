@@ -17,7 +17,7 @@
 #include <unistd.h>
 #include <errno.h>
 #include <limits.h>
-#include <regex.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -488,59 +488,36 @@ int clibcni_util_grow_array(char ***orig_array, size_t *orig_capacity, size_t si
     return do_clibcni_util_grow_array(orig_array, orig_capacity, size, increment);
 }
 
-static int do_clibcni_util_validate_absolute_path(const char *path, regmatch_t *pregmatch)
-{
-    regex_t preg;
-    int nret = 0;
-    int status = 0;
-
-    if (regcomp(&preg, "^(/[^/ ]*)+/?$", REG_NOSUB | REG_EXTENDED) != 0) {
-        nret = -1;
-        goto err_out;
-    }
-
-    status = regexec(&preg, path, 1, pregmatch, 0);
-    regfree(&preg);
-    if (status != 0) {
-        nret = -1;
-        goto err_out;
-    }
-err_out:
-    return nret;
-}
-
+/* same as matching "^(/[^/ ]*)+/?$": starts with '/' and has no space */
 int clibcni_util_validate_absolute_path(const char *path)
 {
-    regmatch_t regmatch;
-
-    if (path == NULL) {
+    if (path == NULL || path[0] != '/') {
         return -1;
     }
 
-    (void)memset(&regmatch, 0, sizeof(regmatch_t));
+    return strchr(path, ' ') == NULL ? 0 : -1;
+}
 
-    return do_clibcni_util_validate_absolute_path(path, &regmatch);
+static inline bool is_name_alnum(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9');
 }
 
-static int do_clibcni_util_validate_name(const char *name, regmatch_t *pregmatch)
+/* same as matching "^([a-z0-9][-a-z0-9.]*)?[a-z0-9]$" */
+static int do_clibcni_util_validate_name(const char *name, size_t len)
 {
-    int nret = 0;
-    int status = 0;
-    regex_t preg;
+    size_t i = 0;
 
-    if (regcomp(&preg, "^([a-z0-9][-a-z0-9.]*)?[a-z0-9]$", REG_NOSUB | REG_EXTENDED) != 0) {
-        nret = -1;
-        goto err_out;
+    if (len == 0 || !is_name_alnum(name[0]) || !is_name_alnum(name[len - 1])) {
+        return -1;
     }
-
-    status = regexec(&preg, name, 1, pregmatch, 0);
-    regfree(&preg);
-    if (status != 0) {
-        nret = -1;
-        goto err_out;
+    for (i = 1; i + 1 < len; i++) {
+        if (!is_name_alnum(name[i]) && name[i] != '-' && name[i] != '.') {
+            return -1;
+        }
     }
-err_out:
-    return nret;
+
+    return 0;
 }
 
 static inline bool check_clibcni_util_validate_name_args(const char *name)
@@ -551,15 +528,11 @@ static inline bool check_clibcni_util_validate_name_args(const char *name)
 
 int clibcni_util_validate_name(const char *name)
 {
-    regmatch_t regmatch;
-
     if (check_clibcni_util_validate_name_args(name)) {
         return -1;
     }
 
-    (void)memset(&regmatch, 0, sizeof(regmatch_t));
-
-    return do_clibcni_util_validate_name(name, &regmatch);
+    return do_clibcni_util_validate_name(name, strlen(name));
 }
 
 static void set_char_to_terminator(char *p)
@@ -653,63 +626,320 @@ FILE *clibcni_util_fopen(const char *filename, const char *mode)
     return fp;
 }
 
+static int read_fd_full(int fd, char *buf, size_t len)
+{
+    size_t off = 0;
+    ssize_t nret = 0;
+
+    while (off < len) {
+        nret = read(fd, buf + off, len - off);
+        if (nret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (nret < 0) {
+            return -1;
+        }
+        if (nret == 0) {
+            /* file shrank since fstat, keep what we got */
+            break;
+        }
+        off += (size_t)nret;
+    }
+    buf[off] = '\0';
+    return 0;
+}
+
 /* note: This function can only read small text file. */
 char *clibcni_util_read_text_file(const char *path)
 {
     char *buf = NULL;
-    long len = 0;
-    size_t readlen = 0;
-    FILE *filp = NULL;
-    const long max_size = 10 * 1024 * 1024; /* 10M */
+    int fd = -1;
+    int saved_errno = 0;
+    struct stat st = { 0 };
+    const off_t max_size = 10 * 1024 * 1024; /* 10M */
 
     if (path == NULL) {
         ERROR("invalid NULL param");
         return NULL;
     }
 
-    filp = clibcni_util_fopen(path, "r");
-    if (filp == NULL) {
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
         ERROR("open file %s failed", path);
-        goto err_out;
+        return NULL;
     }
 
-    if (fseek(filp, 0, SEEK_END)) {
-        ERROR("Seek end failed");
+    if (fstat(fd, &st) != 0) {
+        saved_errno = errno;
+        ERROR("Stat file %s failed", path);
         goto err_out;
     }
 
-    len = ftell(filp);
-    if (len > max_size) {
-        ERROR("File to large!");
+    if (!S_ISREG(st.st_mode)) {
+        saved_errno = EINVAL;
+        ERROR("File %s is not regular file", path);
         goto err_out;
     }
 
-    if (fseek(filp, 0, SEEK_SET)) {
-        ERROR("Seek set failed");
+    if (st.st_size > max_size) {
+        saved_errno = EFBIG;
+        ERROR("File to large!");
         goto err_out;
     }
 
-    buf = clibcni_util_common_calloc_s((size_t)(len + 1));
+    buf = clibcni_util_common_calloc_s((size_t)st.st_size + 1);
     if (buf == NULL) {
+        saved_errno = ENOMEM;
         ERROR("out of memroy");
         goto err_out;
     }
 
-    readlen = fread(buf, 1, (size_t)len, filp);
-    if (((readlen < (size_t)len) && (!feof(filp))) || (readlen > (size_t)len)) {
+    if (read_fd_full(fd, buf, (size_t)st.st_size) != 0) {
+        saved_errno = errno;
         ERROR("Failed to read file %s, error: %s\n", path, strerror(errno));
         free(buf);
         buf = NULL;
         goto err_out;
     }
 
-    buf[(size_t)len] = 0;
-
 err_out:
-
-    if (filp != NULL) {
-        fclose(filp);
+    close(fd);
+    if (buf == NULL) {
+        errno = saved_errno;
     }
 
     return buf;
 }
+
+int64_t clibcni_util_monotonic_ms(void)
+{
+    struct timespec ts = { 0 };
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+        return 0;
+    }
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int clibcni_util_buffer_reserve(struct clibcni_util_buffer *buf, size_t extra)
+{
+    size_t new_cap = 0;
+    char *tmp = NULL;
+
+    if (buf == NULL) {
+        return -1;
+    }
+    /* keep one byte for the terminator */
+    if (extra > CLIBCNI_MAX_MEMORY_SIZE - 1 - buf->len) {
+        ERROR("Buffer size overflow");
+        return -1;
+    }
+    if (buf->len + extra + 1 <= buf->cap) {
+        return 0;
+    }
+
+    new_cap = buf->cap > 0 ? buf->cap : CLIBCNI_BUFFER_SIZE;
+    while (new_cap < buf->len + extra + 1) {
+        new_cap *= 2;
+    }
+    tmp = realloc(buf->data, new_cap);
+    if (tmp == NULL) {
+        ERROR("Out of memory");
+        return -1;
+    }
+    buf->data = tmp;
+    buf->cap = new_cap;
+    buf->data[buf->len] = '\0';
+    return 0;
+}
+
+int clibcni_util_buffer_append(struct clibcni_util_buffer *buf, const void *data, size_t len)
+{
+    if (buf == NULL || (data == NULL && len > 0)) {
+        return -1;
+    }
+    if (clibcni_util_buffer_reserve(buf, len) != 0) {
+        return -1;
+    }
+    if (len > 0) {
+        (void)memcpy(buf->data + buf->len, data, len);
+    }
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+    return 0;
+}
+
+char *clibcni_util_buffer_steal(struct clibcni_util_buffer *buf)
+{
+    char *data = NULL;
+
+    if (buf == NULL) {
+        return NULL;
+    }
+    data = buf->data;
+    buf->data = NULL;
+    buf->len = 0;
+    buf->cap = 0;
+    return data;
+}
+
+void clibcni_util_buffer_free(struct clibcni_util_buffer *buf)
+{
+    if (buf == NULL) {
+        return;
+    }
+    free(buf->data);
+    buf->data = NULL;
+    buf->len = 0;
+    buf->cap = 0;
+}
+
+#define ARENA_CHUNK_SIZE 4096
+#define ARENA_ALIGN 16
+
+struct clibcni_util_arena_chunk {
+    struct clibcni_util_arena_chunk *next;
+    size_t used;
+    size_t cap;
+    /* keep data aligned for any type */
+    long double data[];
+};
+
+static inline size_t arena_align(size_t size)
+{
+    return (size + ARENA_ALIGN - 1) & ~((size_t)ARENA_ALIGN - 1);
+}
+
+void *clibcni_util_arena_alloc(struct clibcni_util_arena *arena, size_t size)
+{
+    struct clibcni_util_arena_chunk *chunk = NULL;
+    size_t cap = ARENA_CHUNK_SIZE - sizeof(struct clibcni_util_arena_chunk);
+    void *ret = NULL;
+
+    if (arena == NULL || size == 0 || size > SIZE_MAX - ARENA_CHUNK_SIZE) {
+        return NULL;
+    }
+    size = arena_align(size);
+
+    chunk = arena->chunks;
+    if (chunk == NULL || chunk->cap - chunk->used < size) {
+        /* large block gets a chunk of its own */
+        if (size > cap) {
+            cap = size;
+        }
+        chunk = clibcni_util_common_calloc_s(sizeof(struct clibcni_util_arena_chunk) + cap);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        chunk->cap = cap;
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+    }
+
+    ret = (char *)chunk->data + chunk->used;
+    chunk->used += size;
+    return ret;
+}
+
+char *clibcni_util_arena_strdup(struct clibcni_util_arena *arena, const char *src)
+{
+    size_t len = 0;
+    char *dst = NULL;
+
+    if (src == NULL) {
+        return NULL;
+    }
+    len = strlen(src);
+    dst = clibcni_util_arena_alloc(arena, len + 1);
+    if (dst == NULL) {
+        return NULL;
+    }
+    (void)memcpy(dst, src, len);
+    return dst;
+}
+
+char *clibcni_util_arena_join(struct clibcni_util_arena *arena, const char *sep, const char * const *parts,
+                              size_t len)
+{
+    size_t sep_len = 0;
+    size_t total = 1;
+    size_t plen = 0;
+    size_t i = 0;
+    char *result = NULL;
+    char *pos = NULL;
+
+    if (sep == NULL || (parts == NULL && len > 0)) {
+        return NULL;
+    }
+    sep_len = strlen(sep);
+    for (i = 0; i < len; i++) {
+        if (parts[i] == NULL) {
+            return NULL;
+        }
+        plen = strlen(parts[i]);
+        if (plen > SIZE_MAX - ARENA_CHUNK_SIZE - total - sep_len) {
+            return NULL;
+        }
+        total += plen + sep_len;
+    }
+
+    result = clibcni_util_arena_alloc(arena, total);
+    if (result == NULL) {
+        return NULL;
+    }
+    pos = result;
+    for (i = 0; i < len; i++) {
+        if (i > 0) {
+            (void)memcpy(pos, sep, sep_len);
+            pos += sep_len;
+        }
+        plen = strlen(parts[i]);
+        (void)memcpy(pos, parts[i], plen);
+        pos += plen;
+    }
+    return result;
+}
+
+/* keep the largest chunk for next allocations, so a reused arena stops calling malloc once it is big enough */
+void clibcni_util_arena_reset(struct clibcni_util_arena *arena)
+{
+    struct clibcni_util_arena_chunk *chunk = NULL;
+    struct clibcni_util_arena_chunk *keep = NULL;
+
+    if (arena == NULL) {
+        return;
+    }
+    for (chunk = arena->chunks; chunk != NULL; chunk = chunk->next) {
+        if (keep == NULL || chunk->cap > keep->cap) {
+            keep = chunk;
+        }
+    }
+    while (arena->chunks != NULL) {
+        chunk = arena->chunks;
+        arena->chunks = chunk->next;
+        if (chunk != keep) {
+            free(chunk);
+        }
+    }
+    if (keep != NULL) {
+        /* memory from arena is zeroed */
+        (void)memset(keep->data, 0, keep->used);
+        keep->used = 0;
+        keep->next = NULL;
+        arena->chunks = keep;
+    }
+}
+
+void clibcni_util_arena_free(struct clibcni_util_arena *arena)
+{
+    struct clibcni_util_arena_chunk *chunk = NULL;
+
+    if (arena == NULL) {
+        return;
+    }
+    while (arena->chunks != NULL) {
+        chunk = arena->chunks;
+        arena->chunks = chunk->next;
+        free(chunk);
+    }
+}
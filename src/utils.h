@@ -20,6 +20,10 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #define CLIBCNI_BUFFER_SIZE 4096
 #define MB (1 * 1024 * 1024)
 
@@ -73,4 +77,46 @@ FILE *clibcni_util_fopen(const char *filename, const char *mode);
 
 char *clibcni_util_read_text_file(const char *path);
 
+int64_t clibcni_util_monotonic_ms(void);
+
+/* growable byte buffer, data is always NUL terminated once allocated */
+struct clibcni_util_buffer {
+    char *data;
+    size_t len;
+    size_t cap;
+};
+
+int clibcni_util_buffer_reserve(struct clibcni_util_buffer *buf, size_t extra);
+
+int clibcni_util_buffer_append(struct clibcni_util_buffer *buf, const void *data, size_t len);
+
+/* hand the data over to caller, buffer is reset to empty */
+char *clibcni_util_buffer_steal(struct clibcni_util_buffer *buf);
+
+void clibcni_util_buffer_free(struct clibcni_util_buffer *buf);
+
+struct clibcni_util_arena_chunk;
+
+/* bump allocator for short lived data, everything is released at once by clibcni_util_arena_free */
+struct clibcni_util_arena {
+    struct clibcni_util_arena_chunk *chunks;
+};
+
+/* zeroed memory, valid until the arena is reset or freed */
+void *clibcni_util_arena_alloc(struct clibcni_util_arena *arena, size_t size);
+
+char *clibcni_util_arena_strdup(struct clibcni_util_arena *arena, const char *src);
+
+char *clibcni_util_arena_join(struct clibcni_util_arena *arena, const char *sep, const char * const *parts,
+                              size_t len);
+
+/* release all allocations, but keep memory of arena for reuse */
+void clibcni_util_arena_reset(struct clibcni_util_arena *arena);
+
+void clibcni_util_arena_free(struct clibcni_util_arena *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -209,21 +209,20 @@ static bool check_raw(const char *version, const char **supports)
 struct result_factories g_factories[1] = {
     {
         .supported_versions = g_curr_support_versions,
-        .new_result_op = &new_curr_result
+        .new_result_op = &new_curr_result,
+        .new_compact_result_op = &new_curr_compact_result,
+        .check_result_op = &check_curr_result
     }
 };
 
-struct result *new_result(const char *version, const char *jsonstr, char **err)
+static const struct result_factories *find_result_factory(const char *version, char **err)
 {
     size_t i = 0;
     int ret = 0;
 
-    if (err == NULL) {
-        return NULL;
-    }
     for (i = 0; i < sizeof(g_factories) / sizeof(struct result_factories); i++) {
         if (check_raw(version, g_factories[i].supported_versions)) {
-            return g_factories[i].new_result_op(jsonstr, err);
+            return &g_factories[i];
         }
     }
     ret = asprintf(err, "unsupported CNI result version \"%s\"", version);
@@ -233,3 +232,50 @@ struct result *new_result(const char *version, const char *jsonstr, char **err)
     ERROR("unsupported CNI result version \"%s\"", version);
     return NULL;
 }
+
+struct result *new_result(const char *version, const char *jsonstr, char **err)
+{
+    const struct result_factories *factory = NULL;
+
+    if (err == NULL) {
+        return NULL;
+    }
+    factory = find_result_factory(version, err);
+    if (factory == NULL) {
+        return NULL;
+    }
+    return factory->new_result_op(jsonstr, err);
+}
+
+struct compact_result *new_compact_result(const char *version, const char *jsonstr, char **err)
+{
+    const struct result_factories *factory = NULL;
+
+    if (err == NULL) {
+        return NULL;
+    }
+    factory = find_result_factory(version, err);
+    if (factory == NULL) {
+        return NULL;
+    }
+    return factory->new_compact_result_op(jsonstr, err);
+}
+
+int check_result(const char *version, const char *jsonstr, char **err)
+{
+    const struct result_factories *factory = NULL;
+
+    if (err == NULL) {
+        return -1;
+    }
+    factory = find_result_factory(version, err);
+    if (factory == NULL) {
+        return -1;
+    }
+    return factory->check_result_op(jsonstr, err);
+}
+
+char *cni_result_to_json(const struct result *src, char **err)
+{
+    return curr_result_to_json(src, err);
+}
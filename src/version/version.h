@@ -45,13 +45,27 @@ static inline const char *current()
 
 typedef struct result *(*new_result_t)(const char *json_data, char **err);
 
+typedef struct compact_result *(*new_compact_result_t)(const char *json_data, char **err);
+
+typedef int (*check_result_t)(const char *json_data, char **err);
+
 struct result_factories {
     const char **supported_versions;
     new_result_t new_result_op;
+    new_compact_result_t new_compact_result_op;
+    check_result_t check_result_op;
 };
 
 struct result *new_result(const char *version, const char *jsonstr, char **err);
 
+struct compact_result *new_compact_result(const char *version, const char *jsonstr, char **err);
+
+/* check jsonstr is a valid result of version, with the same checks as new_result */
+int check_result(const char *version, const char *jsonstr, char **err);
+
+/* json of result in format of current version, written straight from struct result */
+char *cni_result_to_json(const struct result *src, char **err);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,388 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2019. All rights reserved.
+ * clibcni licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: haozi007
+ * Create: 2021-09-16
+ * Description: provide benchmarks of cni api and util functions, run by hand, not by ctest
+ */
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+#include <time.h>
+#include <regex.h>
+#include <sys/mman.h>
+
+#include "api.h"
+#include "utils.h"
+#include "version.h"
+#include "current.h"
+#include "constants.h"
+
+#define BENCH_LAUNCH_LIST "{\"cniVersion\":\"0.3.1\",\"name\":\"bench\",\"plugins\":[{\"type\":\"loopback\"}]}"
+
+static double elapsed_ns(const struct timespec *start, const struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) * 1e9 + (double)(end->tv_nsec - start->tv_nsec);
+}
+
+#define OLD_PATH_REGEX "^(/[^/ ]*)+/?$"
+#define OLD_NAME_REGEX "^([a-z0-9][-a-z0-9.]*)?[a-z0-9]$"
+
+/* the validators used to compile one of these per call */
+static int old_regex_validate(const char *pattern, const char *str)
+{
+    regex_t preg;
+    int status = 0;
+
+    if (regcomp(&preg, pattern, REG_NOSUB | REG_EXTENDED) != 0) {
+        return -1;
+    }
+    status = regexec(&preg, str, 0, nullptr, 0);
+    regfree(&preg);
+    return status == 0 ? 0 : -1;
+}
+
+static void bench_validate_path_and_name()
+{
+    const char *paths[] = { "/opt/cni/bin/bridge", "/usr/libexec/cni/host-local", "/opt/cni/bin/" };
+    const char *names[] = { "mynet", "cni0", "default-network.v1" };
+    const size_t loops = 20000;
+    struct timespec start;
+    struct timespec end;
+    double old_ns = 0;
+    double new_ns = 0;
+    size_t i = 0;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < loops; i++) {
+        (void)old_regex_validate(OLD_PATH_REGEX, paths[i % 3]);
+        (void)old_regex_validate(OLD_NAME_REGEX, names[i % 3]);
+    }
+    (void)clock_gettime(CLOCK_MONOTONIC, &end);
+    old_ns = elapsed_ns(&start, &end);
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < loops; i++) {
+        (void)clibcni_util_validate_absolute_path(paths[i % 3]);
+        (void)clibcni_util_validate_name(names[i % 3]);
+    }
+    (void)clock_gettime(CLOCK_MONOTONIC, &end);
+    new_ns = elapsed_ns(&start, &end);
+
+    std::cout << "validate path+name, regex: " << old_ns / loops << " ns, scan: " << new_ns / loops << " ns"
+              << std::endl;
+}
+
+static void bench_parse_cidr()
+{
+    const char *cidrs[] = { "10.88.0.5/16", "fd00:1234:5678::a/64", "0.0.0.0/0", "2001:db8::ff00:42:8329/128" };
+    const size_t loops = 200000;
+    struct compact_ipnet net;
+    struct ipnet *old = nullptr;
+    struct timespec start;
+    struct timespec end;
+    char *err = nullptr;
+    double alloc_ns = 0;
+    double fixed_ns = 0;
+    size_t i = 0;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < loops; i++) {
+        if (parse_cidr(cidrs[i % 4], &old, &err) == 0) {
+            free_ipnet_type(old);
+        }
+    }
+    (void)clock_gettime(CLOCK_MONOTONIC, &end);
+    alloc_ns = elapsed_ns(&start, &end);
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < loops; i++) {
+        (void)parse_cidr_into(cidrs[i % 4], &net, &err);
+    }
+    (void)clock_gettime(CLOCK_MONOTONIC, &end);
+    fixed_ns = elapsed_ns(&start, &end);
+
+    std::cout << "parse cidr, heap: " << alloc_ns / loops << " ns, fixed buffer: " << fixed_ns / loops << " ns"
+              << std::endl;
+}
+
+/* json of result through the cni_result_curr tree, as it was generated before cni_result_to_json */
+static char *tree_result_to_json(const struct result *res)
+{
+    struct parser_context ctx = { OPT_PARSE_FULLKEY | OPT_GEN_SIMPLIFY, 0 };
+    parser_error jerr = nullptr;
+    cni_result_curr *tree = nullptr;
+    char *err = nullptr;
+    char *json = nullptr;
+
+    tree = cni_result_curr_to_json_result(res, &err);
+    if (tree == nullptr) {
+        free(err);
+        return nullptr;
+    }
+    json = cni_result_curr_generate_json(tree, &ctx, &jerr);
+    free(jerr);
+    free_cni_result_curr(tree);
+    return json;
+}
+
+static void bench_result_to_json()
+{
+    const char *json = "{\"cniVersion\":\"0.3.1\",\"interfaces\":[{\"name\":\"eth0\",\"mac\":\"aa:bb:cc:dd:ee:ff\","
+                       "\"sandbox\":\"/var/run/netns/cni-1\"}],\"ips\":[{\"version\":\"4\",\"interface\":0,"
+                       "\"address\":\"10.1.0.5/24\",\"gateway\":\"10.1.0.1\"},{\"version\":\"6\",\"interface\":0,"
+                       "\"address\":\"fd00::5/64\",\"gateway\":\"fd00::1\"}],\"routes\":[{\"dst\":\"0.0.0.0/0\"},"
+                       "{\"dst\":\"::/0\",\"gw\":\"fd00::1\"}],\"dns\":{\"nameservers\":[\"8.8.8.8\",\"1.1.1.1\"],"
+                       "\"domain\":\"example.com\",\"search\":[\"a.example.com\"],\"options\":[\"ndots:5\"]}}";
+    const size_t loops = 20000;
+    struct result *res = nullptr;
+    struct timespec start;
+    struct timespec end;
+    char *err = nullptr;
+    double tree_ns = 0;
+    double stream_ns = 0;
+    size_t i = 0;
+
+    res = new_result("0.3.1", json, &err);
+    if (res == nullptr) {
+        std::cout << "parse result failed: " << (err != nullptr ? err : "") << std::endl;
+        free(err);
+        return;
+    }
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < loops; i++) {
+        free(tree_result_to_json(res));
+    }
+    (void)clock_gettime(CLOCK_MONOTONIC, &end);
+    tree_ns = elapsed_ns(&start, &end);
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < loops; i++) {
+        free(cni_result_to_json(res, &err));
+    }
+    (void)clock_gettime(CLOCK_MONOTONIC, &end);
+    stream_ns = elapsed_ns(&start, &end);
+    free_result(res);
+
+    std::cout << "result to json, tree: " << tree_ns / loops << " ns, stream: " << stream_ns / loops << " ns"
+              << std::endl;
+}
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t nmemb, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+}
+
+static bool g_count_allocs = false;
+static size_t g_alloc_count = 0;
+
+static inline void count_alloc()
+{
+    if (__atomic_load_n(&g_count_allocs, __ATOMIC_RELAXED)) {
+        (void)__atomic_fetch_add(&g_alloc_count, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/* allocators of the whole process, libclibcni and libc included, are counted here, then forwarded to glibc */
+extern "C" void *malloc(size_t size) noexcept
+{
+    count_alloc();
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t nmemb, size_t size) noexcept
+{
+    count_alloc();
+    return __libc_calloc(nmemb, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) noexcept
+{
+    count_alloc();
+    return __libc_realloc(ptr, size);
+}
+
+static void start_count_allocs()
+{
+    __atomic_store_n(&g_alloc_count, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_count_allocs, true, __ATOMIC_RELAXED);
+}
+
+static size_t stop_count_allocs()
+{
+    __atomic_store_n(&g_count_allocs, false, __ATOMIC_RELAXED);
+    return __atomic_load_n(&g_alloc_count, __ATOMIC_RELAXED);
+}
+
+/*
+ * heap allocations of one ADD of a two plugin chain: from bytes parses the list and
+ * generates every plugin config, by handle builds configs from templates in arenas
+ * */
+static void bench_chain_allocs(char **paths)
+{
+    const int loops = 20;
+    char netns[PATH_MAX] = {0x0};
+    struct runtime_conf rc = {
+        .container_id = (char *)"bench",
+        .netns = netns,
+        .ifname = (char *)"eth0",
+    };
+    struct cni_network_list_handle *handle = nullptr;
+    struct result *pret = nullptr;
+    char *err = nullptr;
+    size_t bytes_allocs = 0;
+    size_t handle_allocs = 0;
+    int i = 0;
+
+    (void)sprintf(netns, "/proc/%d/ns/net", getpid());
+    if (cni_network_list_handle_from_bytes(COMMON_CONF_LIST, paths, &handle, &err) != 0) {
+        std::cout << "create handle failed: " << (err != nullptr ? err : "") << std::endl;
+        free(err);
+        return;
+    }
+    /* fill caches of plugin paths and environs first, they are not part of a chain */
+    (void)cni_add_network_list(COMMON_CONF_LIST, &rc, paths, &pret, &err);
+    free_result(pret);
+    pret = nullptr;
+    free(err);
+    err = nullptr;
+
+    for (i = 0; i < loops; i++) {
+        start_count_allocs();
+        (void)cni_add_network_list(COMMON_CONF_LIST, &rc, paths, &pret, &err);
+        bytes_allocs += stop_count_allocs();
+        free_result(pret);
+        pret = nullptr;
+        free(err);
+        err = nullptr;
+
+        start_count_allocs();
+        (void)cni_add_network_list_by_handle(handle, &rc, nullptr, &pret, &err);
+        handle_allocs += stop_count_allocs();
+        free_result(pret);
+        pret = nullptr;
+        free(err);
+        err = nullptr;
+    }
+    cni_network_list_handle_free(handle);
+
+    std::cout << "allocs of chain add, from bytes: " << bytes_allocs / loops << ", by handle: " << handle_allocs / loops
+              << std::endl;
+}
+
+/* touch memory page by page, so that fork has to copy page tables of it */
+static bool grow_rss(size_t mb)
+{
+    size_t len = mb * MB;
+    char *mem = nullptr;
+
+    if (len == 0) {
+        return true;
+    }
+    mem = (char *)mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        return false;
+    }
+    (void)madvise(mem, len, MADV_NOHUGEPAGE);
+    (void)memset(mem, 1, len);
+    return true;
+}
+
+/* ADD of a one plugin list, the plugin only prints a result */
+static void bench_plugin_launch(char **paths, size_t rss_mb)
+{
+    const struct {
+        enum cni_exec_backend backend;
+        const char *name;
+    } backends[] = {
+        { CNI_EXEC_BACKEND_SPAWN, "spawn" },
+        { CNI_EXEC_BACKEND_FORK, "fork" },
+        { CNI_EXEC_BACKEND_HELPER, "helper" },
+    };
+    const int loops = 100;
+    char netns[PATH_MAX] = {0x0};
+    struct runtime_conf rc = {
+        .container_id = (char *)"bench",
+        .netns = netns,
+        .ifname = (char *)"eth0",
+    };
+    struct timespec start;
+    struct timespec end;
+    size_t i = 0;
+    int j = 0;
+
+    (void)sprintf(netns, "/proc/%d/ns/net", getpid());
+    for (i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+        std::vector<double> costs;
+
+        if (cni_set_exec_backend(backends[i].backend) != 0) {
+            std::cout << "set exec backend " << backends[i].name << " failed" << std::endl;
+            continue;
+        }
+        for (j = 0; j < loops; j++) {
+            struct result *pret = nullptr;
+            char *err = nullptr;
+
+            (void)clock_gettime(CLOCK_MONOTONIC, &start);
+            (void)cni_add_network_list(BENCH_LAUNCH_LIST, &rc, paths, &pret, &err);
+            (void)clock_gettime(CLOCK_MONOTONIC, &end);
+            costs.push_back(elapsed_ns(&start, &end));
+            free_result(pret);
+            free(err);
+        }
+        std::sort(costs.begin(), costs.end());
+        std::cout << "plugin launch, rss " << rss_mb << " MB, " << backends[i].name << ": median "
+                  << costs[costs.size() / 2] / 1000 << " us, p90 " << costs[costs.size() * 9 / 10] / 1000 << " us"
+                  << std::endl;
+    }
+    (void)cni_set_exec_backend(CNI_EXEC_BACKEND_SPAWN);
+}
+
+int main()
+{
+    char pwd_buf[PATH_MAX] = {0X0};
+    char *paths[] = {pwd_buf, nullptr};
+    const size_t rss_steps[] = { 0, 1024, 3072 };
+    size_t rss_mb = 0;
+    size_t i = 0;
+
+    /* before memory of process grows, as callers are told to */
+    if (cni_exec_helper_init() != 0) {
+        std::cout << "start exec helper failed" << std::endl;
+        return 1;
+    }
+    if (getcwd(pwd_buf, PATH_MAX) == nullptr) {
+        return 1;
+    }
+    (void)strcat(pwd_buf, "/utils");
+
+    bench_validate_path_and_name();
+    bench_parse_cidr();
+    bench_result_to_json();
+    bench_chain_allocs(paths);
+
+    for (i = 0; i < sizeof(rss_steps) / sizeof(rss_steps[0]); i++) {
+        if (!grow_rss(rss_steps[i] - rss_mb)) {
+            std::cout << "grow rss to " << rss_steps[i] << " MB failed" << std::endl;
+            break;
+        }
+        rss_mb = rss_steps[i];
+        bench_plugin_launch(paths, rss_mb);
+    }
+
+    return 0;
+}
@@ -15,17 +15,38 @@
 #include <gtest/gtest.h>
 
 #include <iostream>
+#include <string>
+#include <vector>
 
 #include <string.h>
 #include <unistd.h>
 #include <dirent.h>
+#include <pthread.h>
+#include <regex.h>
+#include <arpa/inet.h>
+#include <time.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 
 #include "api.h"
 #include "version.h"
 #include "conf.h"
 #include "constants.h"
+#include "utils.h"
+#include "current.h"
 
 
+static void write_test_file(const char *path, const char *content)
+{
+    FILE *fp = fopen(path, "w");
+
+    ASSERT_NE(fp, nullptr);
+    ASSERT_GE(fputs(content, fp), 0);
+    ASSERT_EQ(fclose(fp), 0);
+}
+
 void api_check_network_config_list(struct cni_network_list_conf *conf, const char *target_name, bool check_plugin_name)
 {
     /* check network_config_list */
@@ -203,6 +224,47 @@ TEST(api_testcases, get_version_info)
     paths[0] = nullptr;
 }
 
+TEST(api_testcases, new_compact_result)
+{
+    const char *json = "{\"cniVersion\":\"0.3.1\",\"interfaces\":[{\"name\":\"eth0\",\"mac\":\"aa:bb:cc:dd:ee:ff\"}],"
+                       "\"ips\":[{\"version\":\"4\",\"interface\":0,\"address\":\"10.1.0.5/24\","
+                       "\"gateway\":\"10.1.0.1\"}],\"routes\":[{\"dst\":\"0.0.0.0/0\"}],"
+                       "\"dns\":{\"nameservers\":[\"8.8.8.8\"],\"domain\":\"example.com\"}}";
+    char *err = nullptr;
+    struct compact_result *res = nullptr;
+    const struct compact_ipconfig *ipc = nullptr;
+    char *ip_str = nullptr;
+
+    res = new_compact_result("0.3.1", json, &err);
+    ASSERT_NE(res, nullptr);
+    ASSERT_EQ(err, nullptr);
+
+    EXPECT_STREQ("0.3.1", compact_result_cniversion(res));
+    ASSERT_EQ(compact_result_interfaces_len(res), 1);
+    EXPECT_STREQ("eth0", compact_result_interface(res, 0)->name);
+    EXPECT_EQ(compact_result_interface(res, 1), nullptr);
+
+    ASSERT_EQ(compact_result_ips_len(res), 1);
+    ipc = compact_result_ip(res, 0);
+    EXPECT_TRUE(ipc->has_interface);
+    EXPECT_EQ(ipc->interface, 0);
+    ip_str = ip_to_string(ipc->gateway, ipc->gateway_len);
+    EXPECT_STREQ("10.1.0.1", ip_str);
+    free(ip_str);
+
+    ASSERT_EQ(compact_result_routes_len(res), 1);
+    EXPECT_EQ(compact_result_route(res, 0)->gw_len, 0);
+    ASSERT_EQ(compact_result_dns(res)->name_servers_len, 1);
+    EXPECT_STREQ("8.8.8.8", compact_result_dns(res)->name_servers[0]);
+    EXPECT_STREQ("example.com", compact_result_dns(res)->domain);
+    free_compact_result(res);
+
+    res = new_compact_result("0.0.1", json, &err);
+    EXPECT_EQ(res, nullptr);
+    EXPECT_NE(err, nullptr);
+    free(err);
+}
+
 TEST(api_testcases, cni_log_ops)
 {
     int ret = 0;
@@ -380,7 +442,13 @@ TEST(api_testcases, cni_delete_network_list)
     free(err);
 }
 
-TEST(api_testcases, cni_delete_network)
+static void api_count_done_op(struct cni_op *op, void *data)
+{
+    (void)op;
+    (*(int *)data)++;
+}
+
+TEST(api_testcases, cni_network_list_async)
 {
     int ret = 0;
     char pwd_buf[PATH_MAX] = {0X0};
@@ -394,6 +462,9 @@ TEST(api_testcases, cni_delete_network)
         .netns = netns,
         .ifname = (char *)"eth0",
     };
+    struct result *pret = nullptr;
+    struct cni_op *op = nullptr;
+    int done = 0;
 
     (void)sprintf(netns, "/proc/%d/ns/net", cpid);
 
@@ -403,101 +474,994 @@ TEST(api_testcases, cni_delete_network)
     pwd = strcat(pwd_buf, "/utils");
     ASSERT_NE(pwd, nullptr);
 
-    std::cout << "cni bin path: " << pwd_buf << std::endl;
+    ret = cni_add_network_list_async(COMMON_CONF_LIST, &rc, nullptr, paths, api_count_done_op, &done, &op, &err);
+    ASSERT_EQ(ret, 0);
+    ASSERT_GE(cni_op_get_fd(op), 0);
+    ASSERT_EQ(cni_op_wait(op, -1), 0);
+    ASSERT_EQ(done, 1);
+    ret = cni_op_result(op, &pret, &err);
+    ASSERT_EQ(ret, 0);
+    ASSERT_EQ(err, nullptr);
+    ASSERT_NE(pret, nullptr);
+    free_result(pret);
+    pret = nullptr;
+    cni_op_free(op);
+    op = nullptr;
 
-    ret = cni_del_network(COMMON_CONF, &rc, paths, &err);
+    std::cout << "async add with bad config list" << std::endl;
+    ret = cni_add_network_list_async(BAD_COMMON_CONF_LIST, &rc, nullptr, paths, api_count_done_op, &done, &op, &err);
     ASSERT_EQ(ret, 0);
+    ASSERT_EQ(cni_op_wait(op, -1), 0);
+    ASSERT_EQ(done, 2);
+    ret = cni_op_result(op, &pret, &err);
+    ASSERT_NE(ret, 0);
+    ASSERT_EQ(pret, nullptr);
+    free(err);
+    err = nullptr;
+    cni_op_free(op);
+    op = nullptr;
 
-    ret = cni_del_network(INVALID_COMMON_CONF, &rc, paths, &err);
+    ret = cni_del_network_list_async(COMMON_CONF_LIST, &rc, nullptr, paths, nullptr, nullptr, &op, &err);
+    ASSERT_EQ(ret, 0);
+    ASSERT_EQ(cni_op_wait(op, -1), 0);
+    ret = cni_op_result(op, nullptr, &err);
+    ASSERT_EQ(ret, 0);
+    cni_op_free(op);
+    op = nullptr;
+
+    std::cout << "async delete with invlaid config list" << std::endl;
+    ret = cni_del_network_list_async(INVALID_COMMON_CONF_LIST, &rc, nullptr, paths, nullptr, nullptr, &op, &err);
+    ASSERT_EQ(ret, 0);
+    ASSERT_EQ(cni_op_wait(op, -1), 0);
+    ret = cni_op_result(op, nullptr, &err);
     ASSERT_NE(ret, 0);
+    cni_op_free(op);
 
     free(err);
 }
 
-TEST(api_testcases, cni_conf_files)
+#define MISSING_PLUGIN_CONF_LIST "{\"cniVersion\":\"0.3.1\",\"name\":\"missing\",\"plugins\":[{\"type\":\"missing\"}]}"
+
+struct api_free_op_data {
+    int done;
+    int ret;
+};
+
+/* take the output and free the operation from its own callback */
+static void api_free_done_op(struct cni_op *op, void *data)
+{
+    struct api_free_op_data *fdata = (struct api_free_op_data *)data;
+    struct result *pret = nullptr;
+    char *err = nullptr;
+
+    fdata->done++;
+    fdata->ret = cni_op_result(op, &pret, &err);
+    free_result(pret);
+    free(err);
+    cni_op_free(op);
+}
+
+TEST(api_testcases, cni_network_list_async_free_in_callback)
 {
-    int ret = 0;
     char pwd_buf[PATH_MAX] = {0X0};
-    char *pwd = nullptr;
-    char *err = NULL;
-    const char *exts[] = {"json", "conf", "conflist"};
-    char **result = nullptr;
+    char *paths[] = {pwd_buf, nullptr};
+    char netns[PATH_MAX] = {0x0};
+    char *err = nullptr;
+    struct runtime_conf rc = {
+        .container_id = (char *)"abcd",
+        .netns = netns,
+        .ifname = (char *)"eth0",
+    };
+    struct api_free_op_data data = { 0 };
+    struct cni_op *op = nullptr;
+    struct pollfd pfd = { 0 };
+
+    (void)sprintf(netns, "/proc/%d/ns/net", getpid());
+    ASSERT_NE(getcwd(pwd_buf, PATH_MAX), nullptr);
+    (void)strcat(pwd_buf, "/utils");
+
+    std::cout << "async add failed when first plugin starts" << std::endl;
+    ASSERT_EQ(cni_add_network_list_async(MISSING_PLUGIN_CONF_LIST, &rc, nullptr, paths, api_free_done_op, &data, &op,
+                                         &err), 0);
+    ASSERT_NE(op, nullptr);
+    /* finished already, but callback is left to the caller's cni_op_process */
+    EXPECT_EQ(data.done, 0);
+    pfd.fd = cni_op_get_fd(op);
+    pfd.events = POLLIN;
+    ASSERT_EQ(poll(&pfd, 1, 5000), 1);
+    ASSERT_EQ(cni_op_process(op), 1);
+    EXPECT_EQ(data.done, 1);
+    EXPECT_NE(data.ret, 0);
+
+    std::cout << "async add finished normally" << std::endl;
+    data.done = 0;
+    op = nullptr;
+    ASSERT_EQ(cni_add_network_list_async(COMMON_CONF_LIST, &rc, nullptr, paths, api_free_done_op, &data, &op, &err), 0);
+    ASSERT_NE(op, nullptr);
+    ASSERT_EQ(cni_op_wait(op, -1), 0);
+    EXPECT_EQ(data.done, 1);
+    EXPECT_EQ(data.ret, 0);
+
+    data.done = 0;
+    op = nullptr;
+    ASSERT_EQ(cni_del_network_list_async(COMMON_CONF_LIST, &rc, nullptr, paths, api_free_done_op, &data, &op, &err), 0);
+    ASSERT_EQ(cni_op_wait(op, -1), 0);
+    EXPECT_EQ(data.done, 1);
+    EXPECT_EQ(data.ret, 0);
+    free(err);
+}
 
-    pwd = getcwd(pwd_buf, PATH_MAX);
-    ASSERT_NE(pwd, nullptr);
+#define SLOW_CONF_LIST "{\"cniVersion\":\"0.3.1\",\"name\":\"slow\",\"plugins\":[{\"type\":\"slow\"}]}"
 
-    pwd = strcat(pwd_buf, "/confs");
-    ASSERT_NE(pwd, nullptr);
+static void write_test_plugin(const char *dir, const char *name, const char *script)
+{
+    char fname[PATH_MAX] = {0X0};
 
-    std::cout << "cni conf path: " << pwd_buf << std::endl;
+    (void)snprintf(fname, sizeof(fname), "%s/%s", dir, name);
+    write_test_file(fname, script);
+    ASSERT_EQ(chmod(fname, 0700), 0);
+}
 
-    ret = cni_conf_files(pwd_buf, exts, 3, &result, &err);
-    ASSERT_EQ(ret, 0);
+static void remove_test_plugin(const char *dir, const char *name)
+{
+    char fname[PATH_MAX] = {0X0};
+
+    (void)snprintf(fname, sizeof(fname), "%s/%s", dir, name);
+    (void)unlink(fname);
+}
+
+static void api_check_slow_plugin_timeout(char **paths, struct runtime_conf *rc)
+{
+    struct cni_exec_opts opts = {
+        .size = sizeof(struct cni_exec_opts),
+        .timeout_ms = 200,
+    };
+    struct result *pret = nullptr;
+    struct cni_op *op = nullptr;
+    char *err = nullptr;
+    time_t start = time(nullptr);
+
+    EXPECT_EQ(cni_add_network_list_with_opts(SLOW_CONF_LIST, rc, &opts, paths, &pret, &err), CNI_ERR_TIMEOUT);
+    EXPECT_EQ(pret, nullptr);
     free(err);
     err = nullptr;
 
-    ret = cni_conf_files("xxxx", exts, 3, &result, &err);
-    ASSERT_EQ(ret, 0);
+    ASSERT_EQ(cni_add_network_list_async(SLOW_CONF_LIST, rc, &opts, paths, nullptr, nullptr, &op, &err), 0);
+    ASSERT_EQ(cni_op_wait(op, -1), 0);
+    EXPECT_EQ(cni_op_result(op, &pret, &err), CNI_ERR_TIMEOUT);
+    EXPECT_EQ(pret, nullptr);
     free(err);
-    err = nullptr;
+    cni_op_free(op);
 
-    ret = cni_conf_files(pwd_buf, exts, 3, &result, nullptr);
-    ASSERT_NE(ret, 0);
+    /* plugins sleep 10 seconds, they must be killed at the deadline */
+    EXPECT_LT(time(nullptr) - start, 5);
+}
+
+TEST(api_testcases, cni_network_list_timeout)
+{
+    char tmp_dir[] = "/tmp/clibcni-timeout-XXXXXX";
+    char *paths[] = {tmp_dir, nullptr};
+    char netns[PATH_MAX] = {0x0};
+    struct runtime_conf rc = {
+        .container_id = (char *)"abcd",
+        .netns = netns,
+        .ifname = (char *)"eth0",
+    };
+
+    (void)sprintf(netns, "/proc/%d/ns/net", getpid());
+    ASSERT_NE(mkdtemp(tmp_dir), nullptr);
+
+    std::cout << "plugin sleeps past timeout" << std::endl;
+    write_test_plugin(tmp_dir, "slow", "#!/bin/sh\ncat >/dev/null\nsleep 10\n");
+    api_check_slow_plugin_timeout(paths, &rc);
+    remove_test_plugin(tmp_dir, "slow");
+
+    std::cout << "plugin closes stdout, then sleeps past timeout" << std::endl;
+    write_test_plugin(tmp_dir, "slow", "#!/bin/sh\ncat >/dev/null\nexec >&-\nsleep 10\n");
+    api_check_slow_plugin_timeout(paths, &rc);
+    remove_test_plugin(tmp_dir, "slow");
+
+    ASSERT_EQ(rmdir(tmp_dir), 0);
+}
+
+/* exec helper is the only long-living child of test process */
+static pid_t api_find_exec_helper(void)
+{
+    DIR *dir = opendir("/proc");
+    struct dirent *entry = nullptr;
+    pid_t helper = -1;
+
+    if (dir == nullptr) {
+        return -1;
+    }
+    while ((entry = readdir(dir)) != nullptr) {
+        char fname[PATH_MAX] = {0x0};
+        char buf[PATH_MAX] = {0x0};
+        char state = 0;
+        int ppid = 0;
+        char *pos = nullptr;
+        FILE *fp = nullptr;
+
+        if (atoi(entry->d_name) <= 0) {
+            continue;
+        }
+        (void)snprintf(fname, sizeof(fname), "/proc/%s/stat", entry->d_name);
+        fp = fopen(fname, "r");
+        if (fp == nullptr) {
+            continue;
+        }
+        /* pid (comm) state ppid ... */
+        if (fgets(buf, sizeof(buf), fp) != nullptr && (pos = strrchr(buf, ')')) != nullptr &&
+            sscanf(pos + 1, " %c %d", &state, &ppid) == 2 && ppid == getpid() && state != 'Z') {
+            helper = atoi(entry->d_name);
+        }
+        (void)fclose(fp);
+    }
+    (void)closedir(dir);
+    return helper;
+}
+
+static void api_check_add_del(char **paths, struct runtime_conf *rc)
+{
+    struct result *pret = nullptr;
+    struct cni_op *op = nullptr;
+    char *err = nullptr;
+
+    ASSERT_EQ(cni_add_network_list(COMMON_CONF_LIST, rc, paths, &pret, &err), 0);
+    ASSERT_EQ(err, nullptr);
+    ASSERT_NE(pret, nullptr);
+    free_result(pret);
+    pret = nullptr;
+    ASSERT_EQ(cni_del_network_list(COMMON_CONF_LIST, rc, paths, &err), 0);
+    ASSERT_EQ(err, nullptr);
+
+    ASSERT_EQ(cni_add_network_list_async(COMMON_CONF_LIST, rc, nullptr, paths, nullptr, nullptr, &op, &err), 0);
+    ASSERT_EQ(cni_op_wait(op, -1), 0);
+    ASSERT_EQ(cni_op_result(op, &pret, &err), 0);
+    ASSERT_EQ(err, nullptr);
+    ASSERT_NE(pret, nullptr);
+    free_result(pret);
+    cni_op_free(op);
+    op = nullptr;
+    ASSERT_EQ(cni_del_network_list_async(COMMON_CONF_LIST, rc, nullptr, paths, nullptr, nullptr, &op, &err), 0);
+    ASSERT_EQ(cni_op_wait(op, -1), 0);
+    ASSERT_EQ(cni_op_result(op, nullptr, &err), 0);
+    ASSERT_EQ(err, nullptr);
+    cni_op_free(op);
+}
+
+TEST(api_testcases, cni_exec_helper)
+{
+    char pwd_buf[PATH_MAX] = {0X0};
+    char *paths[] = {pwd_buf, nullptr};
+    char netns[PATH_MAX] = {0x0};
+    struct runtime_conf rc = {
+        .container_id = (char *)"abcd",
+        .netns = netns,
+        .ifname = (char *)"eth0",
+    };
+    siginfo_t info;
+    pid_t helper = -1;
+
+    (void)sprintf(netns, "/proc/%d/ns/net", getpid());
+    ASSERT_NE(getcwd(pwd_buf, PATH_MAX), nullptr);
+    (void)strcat(pwd_buf, "/utils");
+
+    ASSERT_EQ(cni_exec_helper_init(), 0);
+    ASSERT_EQ(cni_set_exec_backend(CNI_EXEC_BACKEND_HELPER), 0);
+    helper = api_find_exec_helper();
+    ASSERT_GT(helper, 0);
+
+    std::cout << "add and del by exec helper" << std::endl;
+    api_check_add_del(paths, &rc);
+    EXPECT_EQ(api_find_exec_helper(), helper);
+
+    std::cout << "exec helper is killed, next call restarts it" << std::endl;
+    ASSERT_EQ(kill(helper, SIGKILL), 0);
+    /* wait for it to die, but leave it to be reaped by the library */
+    ASSERT_EQ(waitid(P_PID, helper, &info, WEXITED | WNOWAIT), 0);
+    api_check_add_del(paths, &rc);
+    EXPECT_GT(api_find_exec_helper(), 0);
+    EXPECT_NE(api_find_exec_helper(), helper);
+
+    ASSERT_EQ(cni_set_exec_backend(CNI_EXEC_BACKEND_SPAWN), 0);
+}
+
+#define CACHED_CONF_LIST "{\"cniVersion\":\"0.3.1\",\"name\":\"cached\",\"plugins\":[{\"type\":\"cached\"}]}"
+
+#define DOMAIN_PLUGIN(domain) \
+    "#!/bin/sh\ncat >/dev/null\necho '{\"cniVersion\":\"0.3.1\",\"dns\":{\"domain\":\"" domain "\"}}'\n"
+
+/* add network list, return dns domain of result, empty if add failed */
+static std::string api_add_for_domain(const char *conf_list, char **paths, struct runtime_conf *rc)
+{
+    struct result *pret = nullptr;
+    char *err = nullptr;
+    std::string domain;
 
+    if (cni_add_network_list(conf_list, rc, paths, &pret, &err) == 0 && pret != nullptr &&
+        pret->my_dns != nullptr && pret->my_dns->domain != nullptr) {
+        domain = pret->my_dns->domain;
+    }
+    free_result(pret);
     free(err);
+    return domain;
 }
 
-TEST(api_testcases, cni_conf_from_file)
+TEST(api_testcases, cni_plugin_path_cache)
+{
+    char tmp_dir[] = "/tmp/clibcni-pathcache-XXXXXX";
+    char *paths[] = {tmp_dir, nullptr};
+    char netns[PATH_MAX] = {0x0};
+    char plugin[PATH_MAX] = {0x0};
+    char moved[PATH_MAX] = {0x0};
+    struct runtime_conf rc = {
+        .container_id = (char *)"abcd",
+        .netns = netns,
+        .ifname = (char *)"eth0",
+    };
+
+    (void)sprintf(netns, "/proc/%d/ns/net", getpid());
+    ASSERT_NE(mkdtemp(tmp_dir), nullptr);
+    (void)snprintf(plugin, sizeof(plugin), "%s/cached", tmp_dir);
+    (void)snprintf(moved, sizeof(moved), "%s/moved", tmp_dir);
+
+    std::cout << "cached miss is dropped once plugin shows up" << std::endl;
+    EXPECT_EQ(api_add_for_domain(CACHED_CONF_LIST, paths, &rc), "");
+    write_test_plugin(tmp_dir, "cached", DOMAIN_PLUGIN("first"));
+    EXPECT_EQ(api_add_for_domain(CACHED_CONF_LIST, paths, &rc), "first");
+    EXPECT_EQ(api_add_for_domain(CACHED_CONF_LIST, paths, &rc), "first");
+
+    std::cout << "plugin renamed away and back" << std::endl;
+    ASSERT_EQ(rename(plugin, moved), 0);
+    EXPECT_EQ(api_add_for_domain(CACHED_CONF_LIST, paths, &rc), "");
+    ASSERT_EQ(rename(moved, plugin), 0);
+    EXPECT_EQ(api_add_for_domain(CACHED_CONF_LIST, paths, &rc), "first");
+
+    std::cout << "plugin replaced by rename" << std::endl;
+    write_test_plugin(tmp_dir, "moved", DOMAIN_PLUGIN("second"));
+    ASSERT_EQ(rename(moved, plugin), 0);
+    EXPECT_EQ(api_add_for_domain(CACHED_CONF_LIST, paths, &rc), "second");
+
+    remove_test_plugin(tmp_dir, "cached");
+    ASSERT_EQ(rmdir(tmp_dir), 0);
+}
+
+#define FD_CACHE_CONF_LIST "{\"cniVersion\":\"0.3.1\",\"name\":\"fdcache\", \
+     \"plugins\":[{\"type\":\"fdcache\",\"dns\":{\"domain\":\"echoed\"}}]}"
+
+static void copy_test_plugin(const char *src, const char *dir, const char *name)
+{
+    char fname[PATH_MAX] = {0X0};
+    char buf[BUFSIZ];
+    FILE *in = nullptr;
+    FILE *out = nullptr;
+    size_t n = 0;
+
+    (void)snprintf(fname, sizeof(fname), "%s/%s", dir, name);
+    in = fopen(src, "rb");
+    ASSERT_NE(in, nullptr);
+    out = fopen(fname, "wb");
+    ASSERT_NE(out, nullptr);
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        ASSERT_EQ(fwrite(buf, 1, n, out), n);
+    }
+    (void)fclose(in);
+    ASSERT_EQ(fclose(out), 0);
+    ASSERT_EQ(chmod(fname, 0700), 0);
+}
+
+/* binaries are started from a cached fd, scripts never are, so use real binaries */
+TEST(api_testcases, cni_plugin_exec_fd_cache)
+{
+    char tmp_dir[] = "/tmp/clibcni-fdcache-XXXXXX";
+    char *paths[] = {tmp_dir, nullptr};
+    char netns[PATH_MAX] = {0x0};
+    char plugin[PATH_MAX] = {0x0};
+    char moved[PATH_MAX] = {0x0};
+    struct runtime_conf rc = {
+        .container_id = (char *)"abcd",
+        .netns = netns,
+        .ifname = (char *)"eth0",
+    };
+
+    (void)sprintf(netns, "/proc/%d/ns/net", getpid());
+    ASSERT_NE(mkdtemp(tmp_dir), nullptr);
+    (void)snprintf(plugin, sizeof(plugin), "%s/fdcache", tmp_dir);
+    (void)snprintf(moved, sizeof(moved), "%s/moved", tmp_dir);
+
+    /* cat echoes the config, which is a valid result */
+    copy_test_plugin("/bin/cat", tmp_dir, "fdcache");
+    EXPECT_EQ(api_add_for_domain(FD_CACHE_CONF_LIST, paths, &rc), "echoed");
+    EXPECT_EQ(api_add_for_domain(FD_CACHE_CONF_LIST, paths, &rc), "echoed");
+
+    std::cout << "binary replaced by rename, cached fd must not be used" << std::endl;
+    copy_test_plugin("/bin/false", tmp_dir, "moved");
+    ASSERT_EQ(rename(moved, plugin), 0);
+    EXPECT_EQ(api_add_for_domain(FD_CACHE_CONF_LIST, paths, &rc), "");
+
+    copy_test_plugin("/bin/cat", tmp_dir, "moved");
+    ASSERT_EQ(rename(moved, plugin), 0);
+    EXPECT_EQ(api_add_for_domain(FD_CACHE_CONF_LIST, paths, &rc), "echoed");
+
+    remove_test_plugin(tmp_dir, "fdcache");
+    ASSERT_EQ(rmdir(tmp_dir), 0);
+}
+
+#define ENV_CONF_LIST "{\"cniVersion\":\"0.3.1\",\"name\":\"env\",\"plugins\":[{\"type\":\"envdomain\"}]}"
+
+/* domain of result is built from environs the plugin sees */
+#define ENV_DOMAIN_PLUGIN "#!/bin/sh\ncat >/dev/null\n" \
+    "echo \"{\\\"cniVersion\\\":\\\"0.3.1\\\",\\\"dns\\\":{\\\"domain\\\":" \
+    "\\\"${CLIBCNI_TEST_DOMAIN}-${http_proxy:-noproxy}\\\"}}\"\n"
+
+TEST(api_testcases, cni_refresh_plugin_env)
+{
+    char tmp_dir[] = "/tmp/clibcni-env-XXXXXX";
+    char *paths[] = {tmp_dir, nullptr};
+    char netns[PATH_MAX] = {0x0};
+    struct runtime_conf rc = {
+        .container_id = (char *)"abcd",
+        .netns = netns,
+        .ifname = (char *)"eth0",
+    };
+
+    (void)sprintf(netns, "/proc/%d/ns/net", getpid());
+    ASSERT_NE(mkdtemp(tmp_dir), nullptr);
+    write_test_plugin(tmp_dir, "envdomain", ENV_DOMAIN_PLUGIN);
+
+    ASSERT_EQ(setenv("CLIBCNI_TEST_DOMAIN", "first", 1), 0);
+    cni_refresh_plugin_env();
+    EXPECT_EQ(api_add_for_domain(ENV_CONF_LIST, paths, &rc), "first-noproxy");
+
+    std::cout << "environs changed without refresh, plugins keep the old copy" << std::endl;
+    ASSERT_EQ(setenv("CLIBCNI_TEST_DOMAIN", "second", 1), 0);
+    EXPECT_EQ(api_add_for_domain(ENV_CONF_LIST, paths, &rc), "first-noproxy");
+
+    std::cout << "refreshed environs are passed, without proxy settings" << std::endl;
+    ASSERT_EQ(setenv("http_proxy", "http://127.0.0.1:3128", 1), 0);
+    cni_refresh_plugin_env();
+    EXPECT_EQ(api_add_for_domain(ENV_CONF_LIST, paths, &rc), "second-noproxy");
+
+    ASSERT_EQ(unsetenv("http_proxy"), 0);
+    ASSERT_EQ(unsetenv("CLIBCNI_TEST_DOMAIN"), 0);
+    cni_refresh_plugin_env();
+    remove_test_plugin(tmp_dir, "envdomain");
+    ASSERT_EQ(rmdir(tmp_dir), 0);
+}
+
+#define CHAIN_CONF_LIST "{\"cniVersion\":\"0.3.1\",\"name\":\"chain\", \
+     \"plugins\":[{\"type\":\"first\"},{\"type\":\"last\"}]}"
+
+#define IPS_PLUGIN(ips) \
+    "#!/bin/sh\ncat >/dev/null\necho '{\"cniVersion\":\"0.3.1\",\"ips\":[" ips "]}'\n"
+
+TEST(api_testcases, cni_chain_result_validation)
+{
+    char tmp_dir[] = "/tmp/clibcni-chain-XXXXXX";
+    char *paths[] = {tmp_dir, nullptr};
+    char netns[PATH_MAX] = {0x0};
+    struct runtime_conf rc = {
+        .container_id = (char *)"abcd",
+        .netns = netns,
+        .ifname = (char *)"eth0",
+    };
+
+    (void)sprintf(netns, "/proc/%d/ns/net", getpid());
+    ASSERT_NE(mkdtemp(tmp_dir), nullptr);
+    write_test_plugin(tmp_dir, "last", DOMAIN_PLUGIN("last"));
+
+    write_test_plugin(tmp_dir, "first", IPS_PLUGIN("{\"version\":\"4\",\"address\":\"10.1.1.3/24\"}"));
+    EXPECT_EQ(api_add_for_domain(CHAIN_CONF_LIST, paths, &rc), "last");
+
+    std::cout << "invalid result of plugin in the middle of chain fails the chain" << std::endl;
+    write_test_plugin(tmp_dir, "first", IPS_PLUGIN("{\"version\":\"4\",\"address\":\"10.1.1.300/24\"}"));
+    EXPECT_EQ(api_add_for_domain(CHAIN_CONF_LIST, paths, &rc), "");
+    write_test_plugin(tmp_dir, "first", IPS_PLUGIN("{\"version\":\"4\",\"address\":\"10.1.1.3/33\"}"));
+    EXPECT_EQ(api_add_for_domain(CHAIN_CONF_LIST, paths, &rc), "");
+    write_test_plugin(tmp_dir, "first",
+                      IPS_PLUGIN("{\"version\":\"4\",\"address\":\"10.1.1.3/24\",\"gateway\":\"10.1.1\"}"));
+    EXPECT_EQ(api_add_for_domain(CHAIN_CONF_LIST, paths, &rc), "");
+
+    remove_test_plugin(tmp_dir, "first");
+    remove_test_plugin(tmp_dir, "last");
+    ASSERT_EQ(rmdir(tmp_dir), 0);
+}
+
+TEST(api_testcases, cni_network_list_batch)
 {
     int ret = 0;
     char pwd_buf[PATH_MAX] = {0X0};
     char *pwd = nullptr;
+    char *paths[] = {pwd_buf, nullptr};
+    pid_t cpid = getpid();
+    char netns[PATH_MAX] = {0x0};
     char *err = NULL;
-    struct cni_network_conf *config = nullptr;
+    struct runtime_conf rc1 = {
+        .container_id = (char *)"abcd",
+        .netns = netns,
+        .ifname = (char *)"eth0",
+    };
+    struct runtime_conf rc2 = {
+        .container_id = (char *)"efgh",
+        .netns = netns,
+        .ifname = (char *)"eth0",
+    };
+    struct cni_batch_item items[3] = {};
+    size_t i = 0;
+
+    (void)sprintf(netns, "/proc/%d/ns/net", cpid);
 
     pwd = getcwd(pwd_buf, PATH_MAX);
     ASSERT_NE(pwd, nullptr);
-    pwd = strcat(pwd_buf, "/confs/default-invalid.conf");
+
+    pwd = strcat(pwd_buf, "/utils");
     ASSERT_NE(pwd, nullptr);
-    std::cout << "cni conf path: " << pwd_buf << std::endl;
-    ret = cni_conf_from_file(pwd_buf, &config, &err);
+
+    items[0].rc = &rc1;
+    items[1].rc = &rc2;
+    items[2].rc = &rc1;
+    ret = cni_add_network_list_batch(COMMON_CONF_LIST, paths, items, 3, 2, &err);
     ASSERT_EQ(ret, 0);
-    ASSERT_NE(config, nullptr);
+    ASSERT_EQ(err, nullptr);
+    for (i = 0; i < 3; i++) {
+        ASSERT_EQ(items[i].ret, 0);
+        ASSERT_EQ(items[i].err, nullptr);
+        ASSERT_NE(items[i].result, nullptr);
+        free_result(items[i].result);
+    }
+
+    std::cout << "batch add with empty runtime conf" << std::endl;
+    items[1].rc = nullptr;
+    ret = cni_add_network_list_batch(COMMON_CONF_LIST, paths, items, 3, 0, &err);
+    ASSERT_NE(ret, 0);
+    ASSERT_NE(err, nullptr);
     free(err);
     err = nullptr;
-    free_cni_network_conf(config);
-    config = nullptr;
-    memset(pwd_buf, 0, PATH_MAX);
+    ASSERT_EQ(items[0].ret, 0);
+    ASSERT_NE(items[1].ret, 0);
+    ASSERT_NE(items[1].err, nullptr);
+    ASSERT_EQ(items[1].result, nullptr);
+    ASSERT_EQ(items[2].ret, 0);
+    for (i = 0; i < 3; i++) {
+        free_result(items[i].result);
+        free(items[i].err);
+    }
 
-    pwd = getcwd(pwd_buf, PATH_MAX);
-    ASSERT_NE(pwd, nullptr);
-    pwd = strcat(pwd_buf, "/confs/default.json");
-    ASSERT_NE(pwd, nullptr);
-    std::cout << "cni conf path: " << pwd_buf << std::endl;
-    ret = cni_conf_from_file(pwd_buf, &config, &err);
+    items[1].rc = &rc2;
+    ret = cni_del_network_list_batch(COMMON_CONF_LIST, paths, items, 3, 1, &err);
     ASSERT_EQ(ret, 0);
-    ASSERT_NE(config, nullptr);
-    free(err);
-    err = nullptr;
-    free_cni_network_conf(config);
-    config = nullptr;
-    memset(pwd_buf, 0, PATH_MAX);
+    for (i = 0; i < 3; i++) {
+        ASSERT_EQ(items[i].ret, 0);
+        ASSERT_EQ(items[i].result, nullptr);
+    }
 
-    ret = cni_conf_from_file("/tmp/xxx/xxx.json", &config, &err);
+    std::cout << "batch add with bad config list" << std::endl;
+    ret = cni_add_network_list_batch(BAD_COMMON_CONF_LIST, paths, items, 3, 2, &err);
     ASSERT_NE(ret, 0);
-    ASSERT_EQ(config, nullptr);
+    for (i = 0; i < 3; i++) {
+        ASSERT_NE(items[i].ret, 0);
+        ASSERT_EQ(items[i].result, nullptr);
+        free(items[i].err);
+    }
     free(err);
-    err = nullptr;
 }
 
-
-TEST(api_testcases, cni_conflist_from_file)
+TEST(api_testcases, cni_network_list_handle)
 {
     int ret = 0;
     char pwd_buf[PATH_MAX] = {0X0};
     char *pwd = nullptr;
+    char *paths[] = {pwd_buf, nullptr};
+    pid_t cpid = getpid();
+    char netns[PATH_MAX] = {0x0};
     char *err = NULL;
-    struct cni_network_list_conf *list = nullptr;
+    struct runtime_conf rc = {
+        .container_id = (char *)"abcd",
+        .netns = netns,
+        .ifname = (char *)"eth0",
+    };
+    struct result *pret = nullptr;
+    struct cni_network_list_handle *handle = nullptr;
+    int i = 0;
+
+    (void)sprintf(netns, "/proc/%d/ns/net", cpid);
+
+    pwd = getcwd(pwd_buf, PATH_MAX);
+    ASSERT_NE(pwd, nullptr);
+
+    pwd = strcat(pwd_buf, "/utils");
+    ASSERT_NE(pwd, nullptr);
+
+    ret = cni_network_list_handle_from_bytes(COMMON_CONF_LIST, paths, &handle, &err);
+    ASSERT_EQ(ret, 0);
+    ASSERT_NE(handle, nullptr);
+    for (i = 0; i < 3; i++) {
+        ret = cni_add_network_list_by_handle(handle, &rc, nullptr, &pret, &err);
+        ASSERT_EQ(ret, 0);
+        ASSERT_NE(pret, nullptr);
+        free_result(pret);
+        pret = nullptr;
+        ret = cni_del_network_list_by_handle(handle, &rc, nullptr, &err);
+        ASSERT_EQ(ret, 0);
+    }
+    cni_network_list_handle_free(handle);
+    handle = nullptr;
+
+    std::cout << "handle with plugin not found" << std::endl;
+    ret = cni_network_list_handle_from_bytes(INVALID_COMMON_CONF_LIST, paths, &handle, &err);
+    ASSERT_EQ(ret, 0);
+    ret = cni_add_network_list_by_handle(handle, &rc, nullptr, &pret, &err);
+    ASSERT_NE(ret, 0);
+    ASSERT_EQ(pret, nullptr);
+    free(err);
+    err = nullptr;
+    cni_network_list_handle_free(handle);
+    handle = nullptr;
+
+    ret = cni_network_list_handle_from_bytes("{}", paths, &handle, &err);
+    ASSERT_NE(ret, 0);
+    ASSERT_EQ(handle, nullptr);
+    free(err);
+    err = nullptr;
+
+    ret = cni_add_network_list_by_handle(nullptr, &rc, nullptr, &pret, &err);
+    ASSERT_NE(ret, 0);
+    free(err);
+}
+
+#define STRESS_THREADS 8
+#define STRESS_LOOPS 16
+
+struct stress_arg {
+    struct cni_network_list_handle *handle;
+    const char *netns;
+    int index;
+    int failed;
+};
+
+static void *stress_add_network_list(void *data)
+{
+    struct stress_arg *arg = (struct stress_arg *)data;
+    char container_id[32] = {0x0};
+    struct cni_port_mapping pm = {
+        .host_port = 8080 + arg->index,
+        .container_port = 80,
+        .protocol = (char *)"tcp",
+    };
+    struct cni_port_mapping *pms[] = {&pm};
+    struct runtime_conf rc = {
+        .container_id = container_id,
+        .netns = (char *)arg->netns,
+        .ifname = (char *)"eth0",
+    };
+    struct result *pret = nullptr;
+    char *err = nullptr;
+    int i = 0;
+
+    (void)sprintf(container_id, "stress-%d", arg->index);
+    /* half of threads inject runtime config, the others use plain config */
+    if (arg->index % 2 == 0) {
+        rc.p_mapping = pms;
+        rc.p_mapping_len = 1;
+    }
+    for (i = 0; i < STRESS_LOOPS; i++) {
+        if (cni_add_network_list_by_handle(arg->handle, &rc, nullptr, &pret, &err) != 0 || pret == nullptr) {
+            arg->failed++;
+        }
+        free_result(pret);
+        pret = nullptr;
+        if (cni_del_network_list_by_handle(arg->handle, &rc, nullptr, &err) != 0) {
+            arg->failed++;
+        }
+        free(err);
+        err = nullptr;
+    }
+    return nullptr;
+}
+
+TEST(api_testcases, cni_network_list_concurrent_add)
+{
+    int ret = 0;
+    char pwd_buf[PATH_MAX] = {0X0};
+    char *pwd = nullptr;
+    char *paths[] = {pwd_buf, nullptr};
+    char netns[PATH_MAX] = {0x0};
+    char *err = nullptr;
+    struct cni_network_list_handle *handle = nullptr;
+    pthread_t tids[STRESS_THREADS];
+    struct stress_arg args[STRESS_THREADS];
+    int i = 0;
+
+    (void)sprintf(netns, "/proc/%d/ns/net", getpid());
+
+    pwd = getcwd(pwd_buf, PATH_MAX);
+    ASSERT_NE(pwd, nullptr);
+
+    pwd = strcat(pwd_buf, "/utils");
+    ASSERT_NE(pwd, nullptr);
+
+    ret = cni_network_list_handle_from_bytes(COMMON_CONF_LIST, paths, &handle, &err);
+    ASSERT_EQ(ret, 0);
+    ASSERT_NE(handle, nullptr);
+
+    /* one parsed list shared by all threads */
+    for (i = 0; i < STRESS_THREADS; i++) {
+        args[i].handle = handle;
+        args[i].netns = netns;
+        args[i].index = i;
+        args[i].failed = 0;
+        ASSERT_EQ(pthread_create(&tids[i], nullptr, stress_add_network_list, &args[i]), 0);
+    }
+    for (i = 0; i < STRESS_THREADS; i++) {
+        ASSERT_EQ(pthread_join(tids[i], nullptr), 0);
+        EXPECT_EQ(args[i].failed, 0);
+    }
+
+    cni_network_list_handle_free(handle);
+}
+
+TEST(api_testcases, cni_delete_network)
+{
+    int ret = 0;
+    char pwd_buf[PATH_MAX] = {0X0};
+    char *pwd = nullptr;
+    char *paths[] = {pwd_buf, nullptr};
+    pid_t cpid = getpid();
+    char netns[PATH_MAX] = {0x0};
+    char *err = NULL;
+    struct runtime_conf rc = {
+        .container_id = (char *)"abcd",
+        .netns = netns,
+        .ifname = (char *)"eth0",
+    };
+
+    (void)sprintf(netns, "/proc/%d/ns/net", cpid);
+
+    pwd = getcwd(pwd_buf, PATH_MAX);
+    ASSERT_NE(pwd, nullptr);
+
+    pwd = strcat(pwd_buf, "/utils");
+    ASSERT_NE(pwd, nullptr);
+
+    std::cout << "cni bin path: " << pwd_buf << std::endl;
+
+    ret = cni_del_network(COMMON_CONF, &rc, paths, &err);
+    ASSERT_EQ(ret, 0);
+
+    ret = cni_del_network(INVALID_COMMON_CONF, &rc, paths, &err);
+    ASSERT_NE(ret, 0);
+
+    free(err);
+}
+
+TEST(api_testcases, cni_conf_files)
+{
+    int ret = 0;
+    char pwd_buf[PATH_MAX] = {0X0};
+    char *pwd = nullptr;
+    char *err = NULL;
+    const char *exts[] = {"json", "conf", "conflist"};
+    const char *dot_exts[] = {".json", ".conf", ".conflist"};
+    char **result = nullptr;
+    size_t i = 0;
+
+    pwd = getcwd(pwd_buf, PATH_MAX);
+    ASSERT_NE(pwd, nullptr);
+
+    pwd = strcat(pwd_buf, "/confs");
+    ASSERT_NE(pwd, nullptr);
+
+    std::cout << "cni conf path: " << pwd_buf << std::endl;
+
+    ret = cni_conf_files(pwd_buf, exts, 3, &result, &err);
+    ASSERT_EQ(ret, 0);
+    free(err);
+    err = nullptr;
+
+    ret = cni_conf_files("xxxx", exts, 3, &result, &err);
+    ASSERT_EQ(ret, 0);
+    free(err);
+    err = nullptr;
+
+    ret = cni_conf_files(pwd_buf, exts, 3, &result, nullptr);
+    ASSERT_NE(ret, 0);
+
+    std::cout << "cni conf files with limit" << std::endl;
+    ret = cni_conf_files_with_limit(pwd_buf, dot_exts, 3, 0, &result, &err);
+    ASSERT_EQ(ret, 0);
+    ASSERT_NE(result, nullptr);
+    for (i = 0; result[i] != nullptr; i++) {
+        free(result[i]);
+    }
+    ASSERT_EQ(i, 5U);
+    free(result);
+    result = nullptr;
+
+    ret = cni_conf_files_with_limit(pwd_buf, dot_exts, 3, 5, &result, &err);
+    ASSERT_EQ(ret, 0);
+    for (i = 0; result[i] != nullptr; i++) {
+        free(result[i]);
+    }
+    free(result);
+    result = nullptr;
+
+    ret = cni_conf_files_with_limit(pwd_buf, dot_exts, 3, 4, &result, &err);
+    ASSERT_NE(ret, 0);
+    ASSERT_EQ(result, nullptr);
+    ASSERT_NE(err, nullptr);
+
+    free(err);
+}
+
+TEST(api_testcases, cni_load_conf_dir)
+{
+    int ret = 0;
+    char pwd_buf[PATH_MAX] = {0X0};
+    char *pwd = nullptr;
+    char *err = nullptr;
+    const char *exts[] = {".conflist"};
+    struct cni_conf_dir_item *items = nullptr;
+    size_t items_len = 0;
+    struct cni_network_list_conf *list = nullptr;
+    size_t workers = 0;
+    size_t i = 0;
+
+    pwd = getcwd(pwd_buf, PATH_MAX);
+    ASSERT_NE(pwd, nullptr);
+    pwd = strcat(pwd_buf, "/confs");
+    ASSERT_NE(pwd, nullptr);
+
+    for (workers = 0; workers <= 4; workers++) {
+        ret = cni_load_conf_dir(pwd_buf, exts, 1, workers, &items, &items_len, &err);
+        ASSERT_EQ(ret, 0);
+        ASSERT_EQ(items_len, 3U);
+        for (i = 0; i < items_len; i++) {
+            char *seq_err = nullptr;
+            int seq_ret = cni_conflist_from_file(items[i].file, &list, &seq_err);
+
+            if (i > 0) {
+                EXPECT_LT(strcmp(items[i - 1].file, items[i].file), 0);
+            }
+            EXPECT_EQ(items[i].ret, seq_ret);
+            EXPECT_EQ(items[i].list == nullptr, list == nullptr);
+            EXPECT_EQ(items[i].err == nullptr, seq_err == nullptr);
+            if (items[i].list != nullptr && list != nullptr) {
+                EXPECT_STREQ(items[i].list->name, list->name);
+                EXPECT_STREQ(items[i].list->bytes, list->bytes);
+            }
+            if (items[i].err != nullptr && seq_err != nullptr) {
+                EXPECT_STREQ(items[i].err, seq_err);
+            }
+            free_cni_network_list_conf(list);
+            list = nullptr;
+            free(seq_err);
+        }
+        free_cni_conf_dir_items(items, items_len);
+        items = nullptr;
+    }
+
+    ret = cni_load_conf_dir("xxxx", exts, 1, 0, &items, &items_len, &err);
+    ASSERT_EQ(ret, 0);
+    ASSERT_EQ(items_len, 0U);
+
+    ret = cni_load_conf_dir(pwd_buf, exts, 1, 0, &items, &items_len, nullptr);
+    ASSERT_NE(ret, 0);
+}
+
+TEST(api_testcases, cni_conf_from_file)
+{
+    int ret = 0;
+    char pwd_buf[PATH_MAX] = {0X0};
+    char *pwd = nullptr;
+    char *err = NULL;
+    struct cni_network_conf *config = nullptr;
+
+    pwd = getcwd(pwd_buf, PATH_MAX);
+    ASSERT_NE(pwd, nullptr);
+    pwd = strcat(pwd_buf, "/confs/default-invalid.conf");
+    ASSERT_NE(pwd, nullptr);
+    std::cout << "cni conf path: " << pwd_buf << std::endl;
+    ret = cni_conf_from_file(pwd_buf, &config, &err);
+    ASSERT_EQ(ret, 0);
+    ASSERT_NE(config, nullptr);
+    free(err);
+    err = nullptr;
+    free_cni_network_conf(config);
+    config = nullptr;
+    memset(pwd_buf, 0, PATH_MAX);
+
+    pwd = getcwd(pwd_buf, PATH_MAX);
+    ASSERT_NE(pwd, nullptr);
+    pwd = strcat(pwd_buf, "/confs/default.json");
+    ASSERT_NE(pwd, nullptr);
+    std::cout << "cni conf path: " << pwd_buf << std::endl;
+    ret = cni_conf_from_file(pwd_buf, &config, &err);
+    ASSERT_EQ(ret, 0);
+    ASSERT_NE(config, nullptr);
+    free(err);
+    err = nullptr;
+    free_cni_network_conf(config);
+    config = nullptr;
+    memset(pwd_buf, 0, PATH_MAX);
+
+    ret = cni_conf_from_file("/tmp/xxx/xxx.json", &config, &err);
+    ASSERT_NE(ret, 0);
+    ASSERT_EQ(config, nullptr);
+    free(err);
+    err = nullptr;
+}
+
+
+TEST(api_testcases, cni_conf_from_dir)
+{
+    int ret = 0;
+    char pwd_buf[PATH_MAX] = {0X0};
+    char tmp_dir[] = "/tmp/clibcni-confdir-XXXXXX";
+    char fname[PATH_MAX] = {0X0};
+    char *pwd = nullptr;
+    char *err = nullptr;
+    struct cni_network_conf *config = nullptr;
+
+    pwd = getcwd(pwd_buf, PATH_MAX);
+    ASSERT_NE(pwd, nullptr);
+    pwd = strcat(pwd_buf, "/confs");
+    ASSERT_NE(pwd, nullptr);
+
+    ret = cni_conf_from_dir(pwd_buf, "default", &config, &err);
+    ASSERT_EQ(ret, 0);
+    ASSERT_NE(config, nullptr);
+    EXPECT_STREQ("default", config->name);
+    EXPECT_STREQ("bridge", config->type);
+    free_cni_network_conf(config);
+    config = nullptr;
+
+    ret = cni_conf_from_dir(pwd_buf, "invalid-conf", &config, &err);
+    ASSERT_EQ(ret, 0);
+    EXPECT_STREQ("xxxx", config->type);
+    free_cni_network_conf(config);
+    config = nullptr;
+
+    ret = cni_conf_from_dir(pwd_buf, "not-exist", &config, &err);
+    ASSERT_NE(ret, 0);
+    ASSERT_NE(err, nullptr);
+    free(err);
+    err = nullptr;
+
+    std::cout << "changed files of dir are seen by next lookup" << std::endl;
+    ASSERT_NE(mkdtemp(tmp_dir), nullptr);
+    (void)sprintf(fname, "%s/10-test.conf", tmp_dir);
+    write_test_file(fname, "{\"cniVersion\":\"0.3.1\",\"name\":\"test\",\"type\":\"bridge\"}");
+    ret = cni_conf_from_dir(tmp_dir, "test", &config, &err);
+    ASSERT_EQ(ret, 0);
+    EXPECT_STREQ("bridge", config->type);
+    free_cni_network_conf(config);
+    config = nullptr;
+
+    write_test_file(fname, "{\"cniVersion\":\"0.3.1\",\"name\":\"test\",\"type\":\"macvlan\"}");
+    ret = cni_conf_from_dir(tmp_dir, "test", &config, &err);
+    ASSERT_EQ(ret, 0);
+    EXPECT_STREQ("macvlan", config->type);
+    free_cni_network_conf(config);
+    config = nullptr;
+
+    ASSERT_EQ(unlink(fname), 0);
+    ret = cni_conf_from_dir(tmp_dir, "test", &config, &err);
+    ASSERT_NE(ret, 0);
+    free(err);
+    err = nullptr;
+
+    ASSERT_EQ(rmdir(tmp_dir), 0);
+    cni_flush_conf_dir_cache();
+}
+
+TEST(api_testcases, cni_conflist_from_file)
+{
+    int ret = 0;
+    char pwd_buf[PATH_MAX] = {0X0};
+    char *pwd = nullptr;
+    char *err = NULL;
+    struct cni_network_list_conf *list = nullptr;
 
     pwd = getcwd(pwd_buf, PATH_MAX);
     ASSERT_NE(pwd, nullptr);
@@ -557,4 +1521,521 @@ TEST(api_testcases, free_runtime_conf)
     rc->p_mapping[1] = (struct cni_port_mapping *)calloc(sizeof(struct cni_port_mapping), 1);
 
     free_runtime_conf(rc);
-}
\ No newline at end of file
+}
+
+static bool all_zero(const char *mem, size_t len)
+{
+    size_t i = 0;
+
+    for (i = 0; i < len; i++) {
+        if (mem[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST(api_testcases, util_arena)
+{
+    struct clibcni_util_arena arena = { 0 };
+    const char *parts[] = { "/opt/cni/bin", "/usr/libexec/cni" };
+    std::vector<char *> small;
+    char *large = nullptr;
+    char *first = nullptr;
+    char *str = nullptr;
+    size_t i = 0;
+
+    EXPECT_EQ(clibcni_util_arena_alloc(&arena, 0), nullptr);
+    EXPECT_EQ(clibcni_util_arena_alloc(nullptr, 8), nullptr);
+
+    /* small blocks outgrow the first chunk, and stay aligned and zeroed */
+    for (i = 0; i < 1000; i++) {
+        char *mem = (char *)clibcni_util_arena_alloc(&arena, 1 + i % 40);
+        ASSERT_NE(mem, nullptr);
+        EXPECT_EQ((uintptr_t)mem % 16, 0U);
+        EXPECT_TRUE(all_zero(mem, 1 + i % 40));
+        (void)memset(mem, 0xa5, 1 + i % 40);
+        small.push_back(mem);
+    }
+    for (i = 0; i < small.size(); i++) {
+        EXPECT_EQ((unsigned char)small[i][0], 0xa5);
+    }
+
+    /* block larger than a chunk */
+    large = (char *)clibcni_util_arena_alloc(&arena, 64 * 1024);
+    ASSERT_NE(large, nullptr);
+    EXPECT_EQ((uintptr_t)large % 16, 0U);
+    EXPECT_TRUE(all_zero(large, 64 * 1024));
+    (void)memset(large, 0x5a, 64 * 1024);
+
+    str = clibcni_util_arena_join(&arena, ":", parts, 2);
+    ASSERT_NE(str, nullptr);
+    EXPECT_STREQ(str, "/opt/cni/bin:/usr/libexec/cni");
+    str = clibcni_util_arena_strdup(&arena, "eth0");
+    ASSERT_NE(str, nullptr);
+    EXPECT_STREQ(str, "eth0");
+
+    /* reset keeps the largest chunk, its memory is handed out again zeroed */
+    clibcni_util_arena_reset(&arena);
+    first = (char *)clibcni_util_arena_alloc(&arena, 64 * 1024);
+    ASSERT_NE(first, nullptr);
+    EXPECT_EQ(first, large);
+    EXPECT_TRUE(all_zero(first, 64 * 1024));
+
+    clibcni_util_arena_reset(&arena);
+    first = (char *)clibcni_util_arena_alloc(&arena, 100);
+    ASSERT_NE(first, nullptr);
+    EXPECT_EQ(first, large);
+    EXPECT_TRUE(all_zero(first, 100));
+
+    clibcni_util_arena_free(&arena);
+    clibcni_util_arena_reset(&arena);
+    clibcni_util_arena_reset(nullptr);
+    EXPECT_NE(clibcni_util_arena_alloc(&arena, 8), nullptr);
+    clibcni_util_arena_free(&arena);
+}
+
+#define OLD_PATH_REGEX "^(/[^/ ]*)+/?$"
+#define OLD_NAME_REGEX "^([a-z0-9][-a-z0-9.]*)?[a-z0-9]$"
+
+/* the validators used to compile one of these per call */
+static int old_regex_validate(const char *pattern, const char *str)
+{
+    regex_t preg;
+    int status = 0;
+
+    if (regcomp(&preg, pattern, REG_NOSUB | REG_EXTENDED) != 0) {
+        return -1;
+    }
+    status = regexec(&preg, str, 0, nullptr, 0);
+    regfree(&preg);
+    return status == 0 ? 0 : -1;
+}
+
+TEST(api_testcases, validate_path_and_name)
+{
+    const char *inputs[] = {
+        "/opt/cni/bin/bridge", "/usr/libexec/cni/host-local", "/opt/cni/bin/", "/", "//", "/opt//cni",
+        "/opt/cni bin/bridge", "opt/cni/bin", "", " /opt", "/opt/\tbin", "mynet", "cni0", "default-network.v1",
+        "a", "-a", "a-", "a.b", "Mynet", "my_net", "my net", "1.2.3", "a..b", ".", "-", "0"
+    };
+    size_t i = 0;
+
+    for (i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+        EXPECT_EQ(clibcni_util_validate_absolute_path(inputs[i]), old_regex_validate(OLD_PATH_REGEX, inputs[i]))
+                << inputs[i];
+        EXPECT_EQ(clibcni_util_validate_name(inputs[i]), old_regex_validate(OLD_NAME_REGEX, inputs[i])) << inputs[i];
+    }
+    EXPECT_NE(clibcni_util_validate_absolute_path(nullptr), 0);
+    EXPECT_NE(clibcni_util_validate_name(nullptr), 0);
+    EXPECT_NE(clibcni_util_validate_name(std::string(201, 'a').c_str()), 0);
+}
+
+static int inet_pton_ip(const char *addr, uint8_t *ip, size_t *len)
+{
+    struct in_addr ipv4;
+    struct in6_addr ipv6;
+
+    if (inet_pton(AF_INET, addr, &ipv4) == 1) {
+        (void)memcpy(ip, &ipv4, IPV4LEN);
+        *len = IPV4LEN;
+        return 0;
+    }
+    if (inet_pton(AF_INET6, addr, &ipv6) == 1) {
+        (void)memcpy(ip, &ipv6, IPV6LEN);
+        *len = IPV6LEN;
+        return 0;
+    }
+    return -1;
+}
+
+TEST(api_testcases, parse_ip_and_cidr)
+{
+    const char *ips[] = {
+        "10.88.0.5", "0.0.0.0", "255.255.255.255", "256.1.1.1", "01.2.3.4", "1.2.3", "1.2.3.4.5", "::", "::1",
+        "fe80::1:2", "::ffff:1.2.3.4", "1:2:3:4:5:6:7:8", "1:2:3:4:5:6:7::", "1:2:3:4:5:6:7:8:9", "1::2::3", "1:",
+        "12345::", "::a.2.3.4", "2001:db8::ff00:42:8329", "", "x"
+    };
+    struct compact_ipnet net;
+    uint8_t expect[IPV6LEN] = { 0 };
+    uint8_t got[IPV6LEN] = { 0 };
+    size_t expect_len = 0;
+    size_t got_len = 0;
+    char *err = nullptr;
+    size_t i = 0;
+
+    for (i = 0; i < sizeof(ips) / sizeof(ips[0]); i++) {
+        int ret = parse_ip_into(ips[i], got, &got_len, &err);
+
+        ASSERT_EQ(ret, inet_pton_ip(ips[i], expect, &expect_len)) << ips[i];
+        if (ret == 0) {
+            ASSERT_EQ(got_len, expect_len);
+            ASSERT_EQ(memcmp(got, expect, got_len), 0) << ips[i];
+        }
+        free(err);
+        err = nullptr;
+    }
+
+    ASSERT_EQ(parse_cidr_into("10.1.2.3/20", &net, &err), 0);
+    ASSERT_EQ(net.ip_mask_len, 4U);
+    ASSERT_EQ(net.ip_mask[1], 0xff);
+    ASSERT_EQ(net.ip_mask[2], 0xf0);
+    ASSERT_EQ(net.ip_mask[3], 0);
+    ASSERT_NE(parse_cidr_into("10.1.2.3/33", &net, &err), 0);
+    free(err);
+    err = nullptr;
+    ASSERT_NE(parse_cidr_into("fd00::1/129", &net, &err), 0);
+    free(err);
+    err = nullptr;
+    ASSERT_NE(parse_cidr_into("fd00::1", &net, &err), 0);
+    free(err);
+    err = nullptr;
+}
+
+TEST(api_testcases, format_ip_and_ipnet)
+{
+    struct compact_ipnet net;
+    struct ipnet *addr = nullptr;
+    struct ipnet *dst = nullptr;
+    uint8_t *gw = nullptr;
+    size_t gw_len = 0;
+    struct ipconfig ipc = { 0 };
+    struct route rt = { 0 };
+    struct ipconfig *ips[] = { &ipc };
+    struct route *routes[] = { &rt };
+    struct result res = { 0 };
+    struct result_ip_strings *strs = nullptr;
+    char buf[IPNET_STRING_BUF_LEN] = { 0 };
+    char *str = nullptr;
+    char *err = nullptr;
+
+    ASSERT_EQ(parse_cidr_into("fd00:1234::a/64", &net, &err), 0);
+    ASSERT_EQ(compact_ipnet_to_buffer(&net, buf, sizeof(buf), &err), 0);
+    ASSERT_STREQ(buf, "fd00:1234::a/64");
+    net.ip_mask[3] = 0x12;
+    ASSERT_EQ(compact_ipnet_to_buffer(&net, buf, sizeof(buf), &err), 0);
+    ASSERT_STREQ(buf, "fd00:1234::a/ffffff12ffffffff0000000000000000");
+    ASSERT_NE(compact_ipnet_to_buffer(&net, buf, IP_STRING_BUF_LEN, &err), 0);
+
+    ASSERT_EQ(parse_cidr("10.88.0.5/16", &addr, &err), 0);
+    str = ipnet_to_string(addr, &err);
+    ASSERT_STREQ(str, "10.88.0.5/16");
+    free(str);
+    ASSERT_EQ(ip_to_buffer(addr->ip, 0, buf, sizeof(buf)), 0);
+    ASSERT_STREQ(buf, "<nil>");
+    ASSERT_NE(ip_to_buffer(addr->ip, 3, buf, sizeof(buf)), 0);
+
+    ASSERT_EQ(parse_cidr("::/0", &dst, &err), 0);
+    ASSERT_EQ(parse_ip_from_str("10.88.0.1", &gw, &gw_len, &err), 0);
+    ipc.address = addr;
+    ipc.gateway = gw;
+    ipc.gateway_len = gw_len;
+    rt.dst = dst;
+    res.ips = ips;
+    res.ips_len = 1;
+    res.routes = routes;
+    res.routes_len = 1;
+
+    strs = result_ip_strings(&res, &err);
+    ASSERT_NE(strs, nullptr);
+    ASSERT_STREQ(strs->ip_addresses[0], "10.88.0.5/16");
+    ASSERT_STREQ(strs->ip_gateways[0], "10.88.0.1");
+    ASSERT_STREQ(strs->route_dsts[0], "::/0");
+    ASSERT_EQ(strs->route_gws[0], nullptr);
+
+    free_result_ip_strings(strs);
+    free_ipnet_type(addr);
+    free_ipnet_type(dst);
+    free(gw);
+}
+
+/* json of result through the cni_result_curr tree, what cni_result_to_json has to match */
+static char *tree_result_to_json(const struct result *res)
+{
+    struct parser_context ctx = { OPT_PARSE_FULLKEY | OPT_GEN_SIMPLIFY, 0 };
+    parser_error jerr = nullptr;
+    cni_result_curr *tree = nullptr;
+    char *err = nullptr;
+    char *json = nullptr;
+
+    tree = cni_result_curr_to_json_result(res, &err);
+    if (tree == nullptr) {
+        free(err);
+        return nullptr;
+    }
+    json = cni_result_curr_generate_json(tree, &ctx, &jerr);
+    free(jerr);
+    free_cni_result_curr(tree);
+    return json;
+}
+
+TEST(api_testcases, cni_result_to_json)
+{
+    const char *goldens[] = {
+        "{\"cniVersion\":\"0.3.1\",\"interfaces\":[{\"name\":\"eth0\",\"mac\":\"aa:bb:cc:dd:ee:ff\","
+        "\"sandbox\":\"/var/run/netns/cni-1\"}],\"ips\":[{\"version\":\"4\",\"interface\":0,"
+        "\"address\":\"10.1.0.5/24\",\"gateway\":\"10.1.0.1\"},{\"version\":\"6\",\"interface\":0,"
+        "\"address\":\"fd00::5/64\",\"gateway\":\"fd00::1\"}],\"routes\":[{\"dst\":\"0.0.0.0/0\"},"
+        "{\"dst\":\"::/0\",\"gw\":\"fd00::1\"}],\"dns\":{\"nameservers\":[\"8.8.8.8\",\"1.1.1.1\"],"
+        "\"domain\":\"example.com\",\"search\":[\"a.example.com\"],\"options\":[\"ndots:5\"]}}",
+        "{\"cniVersion\":\"0.3.1\",\"ips\":[{\"version\":\"4\",\"address\":\"10.1.0.5/24\"}],\"dns\":{}}",
+        "{\"cniVersion\":\"0.3.1\",\"interfaces\":[{\"name\":\"e\\\"th\\\\0\\t\"}],\"dns\":{}}",
+        "{\"dns\":{}}",
+    };
+    struct result *res = nullptr;
+    char *err = nullptr;
+    char *json = nullptr;
+    char *tree_json = nullptr;
+    size_t i = 0;
+
+    for (i = 0; i < sizeof(goldens) / sizeof(goldens[0]); i++) {
+        res = new_result("0.3.1", goldens[i], &err);
+        ASSERT_NE(res, nullptr) << goldens[i];
+        json = cni_result_to_json(res, &err);
+        ASSERT_NE(json, nullptr);
+        EXPECT_STREQ(json, goldens[i]);
+        tree_json = tree_result_to_json(res);
+        EXPECT_STREQ(json, tree_json);
+        free(tree_json);
+        free(json);
+        free_result(res);
+    }
+
+    ASSERT_EQ(cni_result_to_json(nullptr, &err), nullptr);
+}
+
+/* stdout of a test plugin under utils, the plugins there only print a fixed result */
+static std::string read_plugin_output(const char *name)
+{
+    char cmd[PATH_MAX] = {0X0};
+    char buf[BUFSIZ];
+    std::string out;
+    FILE *fp = nullptr;
+    size_t n = 0;
+
+    (void)snprintf(cmd, sizeof(cmd), "./utils/%s </dev/null", name);
+    fp = popen(cmd, "r");
+    if (fp == nullptr) {
+        return out;
+    }
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        out.append(buf, n);
+    }
+    (void)pclose(fp);
+    return out;
+}
+
+static void expect_same_result_json(const struct result *res, const char *expect)
+{
+    char *err = nullptr;
+    char *json = nullptr;
+    char *tree_json = nullptr;
+
+    json = cni_result_to_json(res, &err);
+    tree_json = tree_result_to_json(res);
+    ASSERT_NE(json, nullptr) << (err != nullptr ? err : "");
+    ASSERT_NE(tree_json, nullptr);
+    EXPECT_STREQ(json, tree_json);
+    if (expect != nullptr) {
+        EXPECT_STREQ(json, expect);
+    }
+    free(tree_json);
+    free(json);
+    free(err);
+}
+
+/* put an empty entry before and after the items of array, and put them back */
+#define WRAP_WITH_NULL(type, arr, len, saved, saved_len) \
+    do { \
+        size_t k_ = 0; \
+        saved = arr; \
+        saved_len = len; \
+        arr = (type **)calloc(saved_len + 2, sizeof(type *)); \
+        ASSERT_NE(arr, nullptr); \
+        for (k_ = 0; k_ < saved_len; k_++) { \
+            arr[k_ + 1] = saved[k_]; \
+        } \
+        len = saved_len + 2; \
+    } while (0)
+
+#define UNWRAP(arr, len, saved, saved_len) \
+    do { \
+        free(arr); \
+        arr = saved; \
+        len = saved_len; \
+    } while (0)
+
+TEST(api_testcases, cni_result_to_json_fixtures)
+{
+    const char *plugins[] = { "bridge", "loopback", "host-local", "portmap" };
+    struct interface **saved_ifs = nullptr;
+    struct ipconfig **saved_ips = nullptr;
+    struct route **saved_routes = nullptr;
+    struct ipconfig *no_ip[] = { nullptr };
+    size_t saved_ifs_len = 0;
+    size_t saved_ips_len = 0;
+    size_t saved_routes_len = 0;
+    struct result *res = nullptr;
+    std::string out;
+    char *err = nullptr;
+    char *plain = nullptr;
+    size_t i = 0;
+
+    for (i = 0; i < sizeof(plugins) / sizeof(plugins[0]); i++) {
+        out = read_plugin_output(plugins[i]);
+        res = new_result("0.3.1", out.c_str(), &err);
+        ASSERT_NE(res, nullptr) << plugins[i] << ": " << (err != nullptr ? err : "");
+        expect_same_result_json(res, nullptr);
+        free_result(res);
+    }
+
+    std::cout << "empty entries of interfaces, ips and routes are skipped by both generators" << std::endl;
+    out = read_plugin_output("bridge");
+    res = new_result("0.3.1", out.c_str(), &err);
+    ASSERT_NE(res, nullptr);
+    ASSERT_GT(res->interfaces_len, 0U);
+    ASSERT_GT(res->ips_len, 0U);
+    ASSERT_GT(res->routes_len, 0U);
+    plain = cni_result_to_json(res, &err);
+    ASSERT_NE(plain, nullptr);
+    WRAP_WITH_NULL(struct interface, res->interfaces, res->interfaces_len, saved_ifs, saved_ifs_len);
+    WRAP_WITH_NULL(struct ipconfig, res->ips, res->ips_len, saved_ips, saved_ips_len);
+    WRAP_WITH_NULL(struct route, res->routes, res->routes_len, saved_routes, saved_routes_len);
+    expect_same_result_json(res, plain);
+    UNWRAP(res->interfaces, res->interfaces_len, saved_ifs, saved_ifs_len);
+    UNWRAP(res->routes, res->routes_len, saved_routes, saved_routes_len);
+
+    /* array with only empty entries */
+    free(res->ips);
+    res->ips = no_ip;
+    res->ips_len = 1;
+    expect_same_result_json(res, nullptr);
+    res->ips = saved_ips;
+    res->ips_len = saved_ips_len;
+
+    free(plain);
+    free_result(res);
+}
+
+TEST(api_testcases, new_result_decode)
+{
+    const char *json = "{\"cniVersion\":\"0.3.1\",\"interfaces\":[{\"name\":\"eth0\",\"mtu\":1500,"
+                       "\"extra\":{\"a\":[1,{\"b\":null}]}}],\"ips\":[{\"version\":\"4\",\"interface\":0,"
+                       "\"address\":\"10.1.0.5/24\",\"gateway\":\"10.1.0.1\"}],\"routes\":[{\"dst\":\"0.0.0.0/0\"}],"
+                       "\"unknown\":[[true],{\"z\":1.5}],\"dns\":{\"nameservers\":[\"8.8.8.8\",\"1.1.1.1\"],"
+                       "\"domain\":\"example.com\",\"sortlist\":[\"x\"]}}";
+    struct result *res = nullptr;
+    char *err = nullptr;
+
+    res = new_result("0.3.1", json, &err);
+    ASSERT_NE(res, nullptr);
+    ASSERT_EQ(err, nullptr);
+    EXPECT_STREQ(res->cniversion, "0.3.1");
+    ASSERT_EQ(res->interfaces_len, 1U);
+    EXPECT_STREQ(res->interfaces[0]->name, "eth0");
+    EXPECT_EQ(res->interfaces[0]->mac, nullptr);
+    ASSERT_EQ(res->ips_len, 1U);
+    ASSERT_NE(res->ips[0]->interface, nullptr);
+    EXPECT_EQ(*(res->ips[0]->interface), 0);
+    ASSERT_EQ(res->ips[0]->address->ip_len, 4U);
+    EXPECT_EQ(res->ips[0]->gateway_len, 4U);
+    ASSERT_EQ(res->routes_len, 1U);
+    EXPECT_EQ(res->routes[0]->gw, nullptr);
+    ASSERT_NE(res->my_dns, nullptr);
+    ASSERT_EQ(res->my_dns->name_servers_len, 2U);
+    EXPECT_STREQ(res->my_dns->name_servers[1], "1.1.1.1");
+    EXPECT_STREQ(res->my_dns->domain, "example.com");
+    free_result(res);
+
+    /* dns is required, ips need an address, interface is int32 */
+    const char *bad[] = {
+        "{\"cniVersion\":\"0.3.1\"}",
+        "{\"ips\":[{\"version\":\"4\"}],\"dns\":{}}",
+        "{\"ips\":[{\"address\":\"10.1.0.5/24\",\"interface\":1.5}],\"dns\":{}}",
+        "{\"ips\":[1],\"dns\":{}}",
+        "[]",
+        "{\"dns\":{}",
+    };
+    size_t i = 0;
+    for (i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        res = new_result("0.3.1", bad[i], &err);
+        EXPECT_EQ(res, nullptr) << bad[i];
+        EXPECT_NE(err, nullptr) << bad[i];
+        free(err);
+        err = nullptr;
+    }
+}
+
+/* what new_result accepts of a tree parsed by the generated parser: dns, and address of every ip and route */
+static bool generated_result_valid(const cni_result_curr *tree)
+{
+    size_t i = 0;
+
+    if (tree == nullptr || tree->dns == nullptr) {
+        return false;
+    }
+    for (i = 0; i < tree->ips_len; i++) {
+        if (tree->ips[i] == nullptr || tree->ips[i]->address == nullptr) {
+            return false;
+        }
+    }
+    for (i = 0; i < tree->routes_len; i++) {
+        if (tree->routes[i] == nullptr || tree->routes[i]->dst == nullptr) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* addresses are canonical, so json of both sides is the same when they decode the same */
+TEST(api_testcases, new_result_matches_generated_parser)
+{
+    const char *fixtures[] = {
+        "{\"cniVersion\":\"0.3.1\",\"cniVersion\":\"0.4.0\",\"dns\":{\"domain\":\"a\",\"domain\":\"b\"}}",
+        "{\"cniVersion\":1,\"cniVersion\":\"0.3.1\",\"dns\":{}}",
+        "{\"dns\":\"x\",\"dns\":{}}",
+        "{\"ips\":[{\"address\":\"10.1.0.5/24\"}],\"ips\":[{\"address\":\"10.1.0.6/24\"}],\"dns\":{}}",
+        "{\"interfaces\":{\"name\":\"eth0\"},\"routes\":\"x\",\"dns\":{\"nameservers\":\"8.8.8.8\",\"domain\":1}}",
+        "{\"dns\":{\"nameservers\":[\"8.8.8.8\",1,null,true,{\"a\":1},[\"b\"]],\"search\":[]}}",
+        "{\"interfaces\":[1,null,\"eth0\",[1],{\"name\":\"eth1\"}],\"dns\":{}}",
+        "{\"ips\":[null],\"dns\":{}}",
+        "{\"interfaces\":[],\"ips\":[],\"routes\":[],\"dns\":{\"nameservers\":[],\"options\":[]}}",
+        "{\"ips\":[{\"address\":\"10.1.0.5/24\",\"address\":\"bad\",\"interface\":0,\"interface\":\"x\"}],\"dns\":{}}",
+        "{\"routes\":[{\"dst\":1,\"dst\":\"0.0.0.0/0\"}],\"dns\":{}}",
+        "{\"routes\":[{\"dst\":\"0.0.0.0/0\",\"gw\":\"10.1.0.1\",\"gw\":2}],\"dns\":{\"options\":[\"ndots:5\"]}}",
+    };
+    struct parser_context ctx = { OPT_PARSE_FULLKEY | OPT_GEN_SIMPLIFY, 0 };
+    cni_result_curr *tree = nullptr;
+    struct result *res = nullptr;
+    parser_error jerr = nullptr;
+    char *tree_json = nullptr;
+    char *json = nullptr;
+    char *err = nullptr;
+    size_t i = 0;
+
+    for (i = 0; i < sizeof(fixtures) / sizeof(fixtures[0]); i++) {
+        tree = cni_result_curr_parse_data(fixtures[i], nullptr, &jerr);
+        free(jerr);
+        jerr = nullptr;
+        res = new_result("0.3.1", fixtures[i], &err);
+        ASSERT_EQ(res != nullptr, generated_result_valid(tree)) << fixtures[i];
+        if (res != nullptr) {
+            json = cni_result_to_json(res, &err);
+            tree_json = cni_result_curr_generate_json(tree, &ctx, &jerr);
+            ASSERT_NE(json, nullptr);
+            ASSERT_NE(tree_json, nullptr);
+            EXPECT_STREQ(json, tree_json) << fixtures[i];
+            free(json);
+            free(tree_json);
+            free(jerr);
+            jerr = nullptr;
+        }
+        free(err);
+        err = nullptr;
+        EXPECT_EQ(check_result("0.3.1", fixtures[i], &err) == 0, res != nullptr) << fixtures[i];
+        free_result(res);
+        free_cni_result_curr(tree);
+        free(err);
+        err = nullptr;
+    }
+}